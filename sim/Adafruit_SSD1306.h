@@ -0,0 +1,84 @@
+/**
+ * @file Adafruit_SSD1306.h
+ * @brief Adafruit SSD1306 library interface of the host simulator, talks to the simulated panel over Wire.
+ */
+#ifndef SIM_ADAFRUIT_SSD1306_H
+#define SIM_ADAFRUIT_SSD1306_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define BLACK 0
+#define WHITE 1
+#define INVERSE 2
+#define SSD1306_BLACK BLACK
+#define SSD1306_WHITE WHITE
+#define SSD1306_INVERSE INVERSE
+
+#define SSD1306_EXTERNALVCC 0x01
+#define SSD1306_SWITCHCAPVCC 0x02
+
+#define SSD1306_MEMORYMODE 0x20
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+
+/**
+ * @brief Subset of Adafruit_GFX and Adafruit_SSD1306 used by the firmware.
+ *
+ * Text is drawn with the classic 5x7 font, transparent and scaled like the GFX default font. The splash screen of
+ * begin() isn't drawn.
+ */
+class Adafruit_SSD1306 : public Print
+{
+public:
+    Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *twi = &Wire, int8_t rst_pin = -1, uint32_t clkDuring = 400000UL, uint32_t clkAfter = 100000UL);
+    ~Adafruit_SSD1306();
+
+    bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0, bool reset = true, bool periphBegin = true);
+    void display();
+    void clearDisplay();
+    uint8_t *getBuffer();
+    void ssd1306_command(uint8_t c);
+
+    int16_t width() const { return WIDTH; }
+    int16_t height() const { return HEIGHT; }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+    void setTextSize(uint8_t s) { textsize = s > 0 ? s : 1; }
+    void setTextColor(uint16_t c) { textcolor = c; }
+    void setTextColor(uint16_t c, uint16_t bg) { textcolor = c; }
+    void setCursor(int16_t x, int16_t y)
+    {
+        cursor_x = x;
+        cursor_y = y;
+    }
+    void setTextWrap(bool w) { wrap = w; }
+
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+private:
+    const int16_t WIDTH;
+    const int16_t HEIGHT;
+    TwoWire *wire;
+    uint32_t wireClk;
+    uint32_t restoreClk;
+    uint8_t i2caddr = 0x3C;
+    uint8_t *buffer = nullptr;
+    int16_t cursor_x = 0;
+    int16_t cursor_y = 0;
+    uint8_t textsize = 1;
+    uint16_t textcolor = WHITE;
+    bool wrap = true;
+
+    void commandList(const uint8_t *c, uint8_t n);
+    void drawChar(int16_t x, int16_t y, unsigned char c);
+};
+
+#endif
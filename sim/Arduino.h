@@ -0,0 +1,213 @@
+/**
+ * @file Arduino.h
+ * @brief Arduino core of the host simulator.
+ *
+ * Only provides what the firmware uses. Time is virtual (see sim.h), the pins are routed to the simulated devices and
+ * Serial writes to stdout.
+ */
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define F(string_literal) (string_literal)
+#define PROGMEM
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+#endif
+
+class Print;
+
+/**
+ * @brief Interface of objects that can print themselves.
+ */
+class Printable
+{
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print &p) const = 0;
+};
+
+/**
+ * @brief Dynamic string, backed by std::string.
+ */
+class String
+{
+public:
+    String(const char *value = "") : value(value != nullptr ? value : "") {}
+    String(const std::string &value) : value(value) {}
+    explicit String(char c) : value(1, c) {}
+    explicit String(int number, unsigned char base = DEC);
+    explicit String(unsigned int number, unsigned char base = DEC);
+    explicit String(long number, unsigned char base = DEC);
+    explicit String(unsigned long number, unsigned char base = DEC);
+    explicit String(double number, unsigned char decimals = 2);
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.length(); }
+    bool isEmpty() const { return value.empty(); }
+    bool reserve(unsigned int size)
+    {
+        value.reserve(size);
+        return true;
+    }
+    char operator[](unsigned int index) const { return index < value.length() ? value[index] : 0; }
+    char &operator[](unsigned int index) { return value[index]; }
+    String substring(unsigned int from) const { return substring(from, length()); }
+    String substring(unsigned int from, unsigned int to) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    void replace(const String &find, const String &replacement);
+    bool concat(const char *s)
+    {
+        value += s;
+        return true;
+    }
+    bool concat(const char *s, unsigned int length)
+    {
+        value.append(s, length);
+        return true;
+    }
+    bool concat(char c)
+    {
+        value += c;
+        return true;
+    }
+    String &operator+=(const String &s)
+    {
+        value += s.value;
+        return *this;
+    }
+    String &operator+=(const char *s)
+    {
+        value += s;
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        value += c;
+        return *this;
+    }
+    bool operator==(const String &s) const { return value == s.value; }
+    bool operator==(const char *s) const { return value == s; }
+    bool operator!=(const String &s) const { return value != s.value; }
+    bool operator!=(const char *s) const { return value != s; }
+    bool equals(const String &s) const { return value == s.value; }
+    long toInt() const { return atol(value.c_str()); }
+
+private:
+    std::string value;
+};
+
+String operator+(const String &a, const String &b);
+
+/**
+ * @brief Base class of the byte sinks, formats values like the Arduino core.
+ */
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *s) { return s != nullptr ? write((const uint8_t *)s, strlen(s)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+    size_t print(const Printable &p) { return p.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value)
+    {
+        size_t n = print(value);
+        return n + println();
+    }
+    template <typename T>
+    size_t println(const T &value, int format)
+    {
+        size_t n = print(value, format);
+        return n + println();
+    }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**
+ * @brief Serial port, writes to stdout.
+ */
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long baud) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+void configTime(long gmtOffset, int daylightOffset, const char *server1, const char *server2 = nullptr, const char *server3 = nullptr);
+
+#endif
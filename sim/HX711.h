@@ -0,0 +1,37 @@
+/**
+ * @file HX711.h
+ * @brief HX711 library interface of the host simulator, backed by the simulated load cell of sim.h.
+ */
+#ifndef SIM_HX711_H
+#define SIM_HX711_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Subset of the bogde/HX711 library used by the firmware, same semantics.
+ */
+class HX711
+{
+public:
+    void begin(byte dout, byte pd_sck, byte gain = 128);
+    bool is_ready();
+    void wait_ready(unsigned long delay_ms = 0);
+    bool wait_ready_timeout(unsigned long timeout = 1000, unsigned long delay_ms = 0);
+    long read();
+    long read_average(byte times = 10);
+    double get_value(byte times = 1);
+    float get_units(byte times = 1);
+    void tare(byte times = 10);
+    void set_scale(float scale = 1.f);
+    float get_scale();
+    void set_offset(long offset = 0);
+    long get_offset();
+    void power_down() {}
+    void power_up() {}
+
+private:
+    long OFFSET = 0;
+    float SCALE = 1;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file MFRC522.h
+ * @brief MFRC522 library interface of the host simulator, backed by the simulated tag of sim.h.
+ */
+#ifndef SIM_MFRC522_H
+#define SIM_MFRC522_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Subset of the miguelbalboa/MFRC522 library used by the firmware, same semantics for MIFARE Classic tags.
+ */
+class MFRC522
+{
+public:
+    enum StatusCode : byte
+    {
+        STATUS_OK,
+        STATUS_ERROR,
+        STATUS_COLLISION,
+        STATUS_TIMEOUT,
+        STATUS_NO_ROOM,
+        STATUS_INTERNAL_ERROR,
+        STATUS_INVALID,
+        STATUS_CRC_WRONG,
+        STATUS_MIFARE_NACK = 0xff
+    };
+
+    enum PICC_Command : byte
+    {
+        PICC_CMD_MF_AUTH_KEY_A = 0x60,
+        PICC_CMD_MF_AUTH_KEY_B = 0x61
+    };
+
+    enum PICC_Type : byte
+    {
+        PICC_TYPE_UNKNOWN,
+        PICC_TYPE_ISO_14443_4,
+        PICC_TYPE_ISO_18092,
+        PICC_TYPE_MIFARE_MINI,
+        PICC_TYPE_MIFARE_1K,
+        PICC_TYPE_MIFARE_4K,
+        PICC_TYPE_MIFARE_UL,
+        PICC_TYPE_MIFARE_PLUS,
+        PICC_TYPE_MIFARE_DESFIRE,
+        PICC_TYPE_TNP3XXX,
+        PICC_TYPE_NOT_COMPLETE = 0xff
+    };
+
+    static const byte MF_KEY_SIZE = 6;
+
+    typedef struct
+    {
+        byte keyByte[MF_KEY_SIZE];
+    } MIFARE_Key;
+
+    typedef struct
+    {
+        byte size;
+        byte uidByte[10];
+        byte sak;
+    } Uid;
+
+    Uid uid;
+
+    MFRC522(byte chipSelectPin, byte resetPowerDownPin) {}
+
+    void PCD_Init() {}
+    bool PICC_IsNewCardPresent();
+    bool PICC_ReadCardSerial();
+    StatusCode PICC_WakeupA(byte *bufferATQA, byte *bufferSize);
+    StatusCode PICC_HaltA();
+    static PICC_Type PICC_GetType(byte sak);
+    StatusCode PCD_Authenticate(byte command, byte blockAddr, MIFARE_Key *key, Uid *uid);
+    void PCD_StopCrypto1();
+    StatusCode MIFARE_Read(byte blockAddr, byte *buffer, byte *bufferSize);
+    StatusCode MIFARE_Write(byte blockAddr, byte *buffer, byte bufferSize);
+};
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file Preferences.h
+ * @brief Preferences library interface of the host simulator, the namespaces are kept in memory.
+ */
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include <Arduino.h>
+#include <string>
+
+/**
+ * @brief Subset of the ESP32 Preferences library used by the firmware, values keep their type like in NVS.
+ */
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false);
+    void end();
+    bool clear();
+    bool remove(const char *key);
+
+    size_t putUChar(const char *key, uint8_t value) { return put(key, &value, sizeof(value)); }
+    size_t putInt(const char *key, int32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putLong(const char *key, int32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putULong(const char *key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putFloat(const char *key, float value) { return put(key, &value, sizeof(value)); }
+    size_t putBool(const char *key, bool value) { return putUChar(key, value ? 1 : 0); }
+
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+    int32_t getInt(const char *key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+    int32_t getLong(const char *key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+    uint32_t getULong(const char *key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    float getFloat(const char *key, float defaultValue = NAN) { return get(key, defaultValue); }
+    bool getBool(const char *key, bool defaultValue = false) { return getUChar(key, defaultValue ? 1 : 0) != 0; }
+
+private:
+    std::string name;
+    bool readOnly = true;
+    bool started = false;
+
+    size_t put(const char *key, const void *value, size_t size);
+    bool read(const char *key, void *value, size_t size);
+
+    template <typename T>
+    T get(const char *key, T defaultValue)
+    {
+        T value;
+        return read(key, &value, sizeof(value)) ? value : defaultValue;
+    }
+};
+
+#endif
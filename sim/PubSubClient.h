@@ -0,0 +1,72 @@
+/**
+ * @file PubSubClient.h
+ * @brief PubSubClient library interface of the host simulator, connected to the in-process broker of sim.h.
+ */
+#ifndef SIM_PUBSUBCLIENT_H
+#define SIM_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+/**
+ * @brief Subset of the knolleary/PubSubClient library used by the firmware, same semantics.
+ */
+class PubSubClient : public Print
+{
+public:
+    PubSubClient(Client &client) {}
+
+    PubSubClient &setServer(const char *domain, uint16_t port) { return *this; }
+    PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE);
+    PubSubClient &setKeepAlive(uint16_t keepAlive) { return *this; }
+    PubSubClient &setSocketTimeout(uint16_t timeout) { return *this; }
+    bool setBufferSize(uint16_t size);
+    uint16_t getBufferSize() { return bufferSize; }
+
+    bool connect(const char *id, const char *user = nullptr, const char *pass = nullptr);
+    void disconnect();
+    bool connected();
+    int state();
+    bool loop();
+
+    bool subscribe(const char *topic, uint8_t qos = 0);
+    bool publish(const char *topic, const char *payload, bool retained = false);
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained = false);
+    bool beginPublish(const char *topic, unsigned int length, bool retained);
+    int endPublish();
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+private:
+    std::function<void(char *, uint8_t *, unsigned int)> callback;
+    uint16_t bufferSize = 256;
+    bool isConnected = false;
+    int connectionState = MQTT_DISCONNECTED;
+    std::vector<std::string> subscriptions;
+    std::string topic;      // topic of the message between beginPublish() and endPublish()
+    std::string payload;    // payload written since beginPublish()
+    unsigned int length = 0; // length announced by beginPublish()
+    uint8_t *delivered = nullptr;   // payload of the message passed to the callback, nullptr outside of it
+    unsigned int deliveredLength = 0; // length of the delivered payload
+
+    /**
+     * @brief Overwrites the delivered payload like the library, which assembles the header of an outgoing message in
+     *        the buffer that holds the delivered one.
+     * @param topic Topic of the outgoing message.
+     */
+    void overwriteDelivered(const char *topic);
+};
+
+#endif
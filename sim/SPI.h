@@ -0,0 +1,19 @@
+/**
+ * @file SPI.h
+ * @brief SPI library interface of the host simulator, the simulated MFRC522 doesn't need the bus.
+ */
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+#include <Arduino.h>
+
+class SPIClass
+{
+public:
+    void begin() {}
+    void end() {}
+};
+
+extern SPIClass SPI;
+
+#endif
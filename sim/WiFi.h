@@ -0,0 +1,75 @@
+/**
+ * @file WiFi.h
+ * @brief WiFi library interface of the host simulator, the network is up while the simulated broker is online.
+ */
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include <Arduino.h>
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+    WIFI_OFF = 0,
+    WIFI_STA = 1
+} wifi_mode_t;
+
+/**
+ * @brief IPv4 address.
+ */
+class IPAddress : public Printable
+{
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : bytes{a, b, c, d} {}
+    size_t printTo(Print &p) const override;
+
+private:
+    uint8_t bytes[4];
+};
+
+/**
+ * @brief Station interface, associates about a second after begin() while the network is up.
+ */
+class WiFiClass
+{
+public:
+    bool mode(wifi_mode_t mode) { return true; }
+    wl_status_t begin(const char *ssid, const char *passphrase = nullptr);
+    bool disconnect(bool wifioff = false);
+    wl_status_t status();
+    IPAddress localIP();
+    int8_t RSSI();
+
+private:
+    bool started = false;
+    unsigned long startTime = 0;
+};
+
+extern WiFiClass WiFi;
+
+/**
+ * @brief Base class of the network clients.
+ */
+class Client : public Print
+{
+};
+
+/**
+ * @brief TCP client, only used as the transport handle of PubSubClient.
+ */
+class WiFiClient : public Client
+{
+public:
+    size_t write(uint8_t c) override { return 1; }
+    using Print::write;
+};
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * @file Wire.h
+ * @brief I2C library interface of the host simulator, transmissions go to the devices attached with Sim::attachI2c().
+ */
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Size of the transmit buffer, as in the ESP32 core.
+ */
+#define I2C_BUFFER_LENGTH 128
+
+/**
+ * @brief I2C master, each transmission advances the virtual clock by its time on the bus.
+ */
+class TwoWire : public Print
+{
+public:
+    void begin() {}
+    void begin(int sda, int scl) {}
+    void setClock(uint32_t frequency);
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(bool sendStop = true);
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t *data, size_t size) override;
+    using Print::write;
+
+private:
+    uint32_t frequency = 100000;
+    uint8_t address = 0;
+    uint8_t buffer[I2C_BUFFER_LENGTH];
+    size_t length = 0;
+    bool transmitting = false;
+};
+
+extern TwoWire Wire;
+
+#endif
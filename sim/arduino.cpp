@@ -0,0 +1,395 @@
+/**
+ * @file arduino.cpp
+ * @brief Arduino core of the host simulator: virtual clock, pins, Serial, String and Print.
+ */
+#include "Arduino.h"
+#include "sim.h"
+
+#include <random>
+
+HardwareSerial Serial;
+
+namespace
+{
+    /**
+     * @brief Device registered with Sim::Clock::onAdvance().
+     */
+    struct Timer
+    {
+        std::function<uint64_t(uint64_t)> update;
+        uint64_t next;
+    };
+
+    /**
+     * @brief Interrupt attached to a pin.
+     */
+    struct Interrupt
+    {
+        void (*handler)(void);
+        int mode;
+        bool pending;
+    };
+
+    uint64_t clockMicros = 0;
+    bool advancing = false; // ISRs that wait advance the time without running the devices again
+    std::map<uint8_t, uint8_t> levels;
+    std::map<uint8_t, Interrupt> interruptsByPin;
+    bool interruptsEnabled = true;
+    std::mt19937 generator(1);
+
+    // devices register from the constructors of global objects, e.g. Scale calls HX711::begin(), so their
+    // containers are created on first use instead of relying on the initialization order of the translation units
+    std::vector<Timer> &timers()
+    {
+        static std::vector<Timer> registered;
+        return registered;
+    }
+
+    std::map<uint8_t, Sim::Pin> &pins()
+    {
+        static std::map<uint8_t, Sim::Pin> attached;
+        return attached;
+    }
+
+    void runInterrupt(Interrupt &interrupt)
+    {
+        interrupt.pending = false;
+        if (interrupt.handler != nullptr)
+            interrupt.handler();
+    }
+}
+
+uint64_t Sim::Clock::now()
+{
+    return clockMicros;
+}
+
+void Sim::Clock::advance(uint64_t us)
+{
+    uint64_t target = clockMicros + us;
+    if (advancing)
+    {
+        clockMicros = target;
+        return;
+    }
+
+    // stop at every state change of a device, so interrupts are raised at their time
+    advancing = true;
+    for (;;)
+    {
+        uint64_t next = target;
+        for (const Timer &timer : timers())
+            next = timer.next < next ? timer.next : next;
+        clockMicros = next > clockMicros ? next : clockMicros;
+        for (Timer &timer : timers())
+        {
+            if (timer.next <= clockMicros)
+                timer.next = timer.update(clockMicros);
+        }
+        if (clockMicros >= target)
+            break;
+    }
+    advancing = false;
+}
+
+void Sim::Clock::onAdvance(const std::function<uint64_t(uint64_t)> &update)
+{
+    timers().push_back({update, update(clockMicros)});
+}
+
+void Sim::attachPin(uint8_t pin, const Sim::Pin &handler)
+{
+    pins()[pin] = handler;
+}
+
+void Sim::raisePin(uint8_t pin, bool falling)
+{
+    auto found = interruptsByPin.find(pin);
+    if (found == interruptsByPin.end())
+        return;
+    Interrupt &interrupt = found->second;
+    if (interrupt.mode != CHANGE && interrupt.mode != (falling ? FALLING : RISING))
+        return;
+    if (interruptsEnabled)
+        runInterrupt(interrupt);
+    else
+        interrupt.pending = true;
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(clockMicros / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)clockMicros;
+}
+
+void delay(unsigned long ms)
+{
+    Sim::Clock::advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    Sim::Clock::advance(us);
+}
+
+void yield()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+    auto found = pins().find(pin);
+    if (found != pins().end() && found->second.read)
+        return found->second.read();
+    return levels[pin];
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    levels[pin] = value;
+    auto found = pins().find(pin);
+    if (found != pins().end() && found->second.write)
+        found->second.write(value);
+}
+
+int digitalPinToInterrupt(uint8_t pin)
+{
+    return pin;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode)
+{
+    interruptsByPin[interrupt] = {handler, mode, false};
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+    interruptsByPin.erase(interrupt);
+}
+
+void noInterrupts()
+{
+    interruptsEnabled = false;
+}
+
+void interrupts()
+{
+    interruptsEnabled = true;
+    for (auto &entry : interruptsByPin)
+    {
+        if (entry.second.pending)
+            runInterrupt(entry.second);
+    }
+}
+
+long random(long max)
+{
+    return max > 0 ? random(0, max) : 0;
+}
+
+long random(long min, long max)
+{
+    if (max <= min)
+        return min;
+    return std::uniform_int_distribution<long>(min, max - 1)(generator);
+}
+
+void randomSeed(unsigned long seed)
+{
+    generator.seed(seed);
+}
+
+void configTime(long gmtOffset, int daylightOffset, const char *server1, const char *server2, const char *server3)
+{
+}
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t length = strlen(src);
+    if (size > 0)
+    {
+        size_t copied = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, copied);
+        dst[copied] = '\0';
+    }
+    return length;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size)
+{
+    size_t length = strnlen(dst, size);
+    if (length == size)
+        return size + strlen(src);
+    return length + strlcpy(dst + length, src, size - length);
+}
+#endif
+
+namespace
+{
+    const size_t NUMBER_SIZE = 8 * sizeof(unsigned long) + 2; // base 2 digits, sign and null character
+
+    // numbers are formatted on the stack like by the Arduino core, the host tests count the heap allocations
+    const char *formatNumber(unsigned long number, int base, char *buffer)
+    {
+        if (base < 2)
+            base = DEC;
+        char *end = buffer + NUMBER_SIZE - 1;
+        *end = '\0';
+        do
+        {
+            unsigned long digit = number % base;
+            *--end = digit < 10 ? '0' + digit : 'A' + digit - 10;
+            number /= base;
+        } while (number > 0);
+        return end;
+    }
+
+    const char *formatNumber(long number, int base, char *buffer)
+    {
+        if (number >= 0 || base != DEC)
+            return formatNumber((unsigned long)number, base, buffer);
+        char *start = (char *)formatNumber(0UL - (unsigned long)number, base, buffer);
+        *--start = '-';
+        return start;
+    }
+
+    const char *formatNumber(double number, int digits, char *buffer)
+    {
+        snprintf(buffer, NUMBER_SIZE, "%.*f", digits, number);
+        return buffer;
+    }
+}
+
+String::String(int number, unsigned char base)
+{
+    char buffer[NUMBER_SIZE];
+    value = formatNumber((long)number, base, buffer);
+}
+
+String::String(unsigned int number, unsigned char base)
+{
+    char buffer[NUMBER_SIZE];
+    value = formatNumber((unsigned long)number, base, buffer);
+}
+
+String::String(long number, unsigned char base)
+{
+    char buffer[NUMBER_SIZE];
+    value = formatNumber(number, base, buffer);
+}
+
+String::String(unsigned long number, unsigned char base)
+{
+    char buffer[NUMBER_SIZE];
+    value = formatNumber(number, base, buffer);
+}
+
+String::String(double number, unsigned char decimals)
+{
+    char buffer[NUMBER_SIZE];
+    value = formatNumber(number, decimals, buffer);
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to)
+        std::swap(from, to);
+    if (from >= value.length())
+        return String();
+    return String(value.substr(from, to - from));
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    size_t found = value.find(c, from);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+void String::replace(const String &find, const String &replacement)
+{
+    if (find.isEmpty())
+        return;
+    size_t position = 0;
+    while ((position = value.find(find.value, position)) != std::string::npos)
+    {
+        value.replace(position, find.length(), replacement.value);
+        position += replacement.length();
+    }
+}
+
+String operator+(const String &a, const String &b)
+{
+    String result = a;
+    result += b;
+    return result;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+    while (size-- > 0)
+        written += write(*buffer++);
+    return written;
+}
+
+size_t Print::print(long n, int base)
+{
+    char buffer[NUMBER_SIZE];
+    return write(formatNumber(n, base, buffer));
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    char buffer[NUMBER_SIZE];
+    return write(formatNumber(n, base, buffer));
+}
+
+size_t Print::print(double n, int digits)
+{
+    char buffer[NUMBER_SIZE];
+    return write(formatNumber(n, digits, buffer));
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    // like the ESP32 core, only output that doesn't fit into the stack buffer allocates
+    char local[64];
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(local, sizeof(local), format, arguments);
+    va_end(arguments);
+    if (length <= 0)
+        return 0;
+    if ((size_t)length < sizeof(local))
+        return write((const uint8_t *)local, length);
+
+    std::string buffer(length + 1, '\0');
+    va_start(arguments, format);
+    vsnprintf(&buffer[0], buffer.size(), format, arguments);
+    va_end(arguments);
+    return write((const uint8_t *)buffer.data(), length);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush()
+{
+    fflush(stdout);
+}
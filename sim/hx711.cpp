@@ -0,0 +1,190 @@
+/**
+ * @file hx711.cpp
+ * @brief Simulated HX711 and load cell.
+ *
+ * The HX711 converts at 10 samples per second. A finished conversion pulls DOUT low, which raises the interrupt of
+ * the firmware, and is shifted out MSB first with 24 pulses on SCK, a 25th pulse selects channel A with gain 128
+ * again. A conversion that wasn't read when the next one finishes is overwritten and counted as missed.
+ */
+#include "HX711.h"
+#include "sim.h"
+
+#include <random>
+
+namespace
+{
+    const uint64_t CONVERSION_US = 100000; // 10 samples per second, RATE pin low
+
+    bool attached = false;
+    uint8_t doutPin = 0;
+    double weight = 0;
+    double noise = 0;
+    double rawPerGram = 987; // LOADCELL_CALIBRATION of the configuration template
+    long rawOffset = 0;
+    long conversion = 0;     // latest conversion, 24 bit two's complement
+    bool ready = false;      // DOUT low, the conversion wasn't read yet
+    uint8_t pulses = 0;      // SCK pulses of the current read
+    unsigned long missedConversions = 0;
+    std::mt19937 generator(42);
+
+    uint64_t convert(uint64_t now)
+    {
+        double grams = weight;
+        if (noise > 0)
+            grams += std::normal_distribution<double>(0, noise)(generator);
+        double raw = rawOffset + grams * rawPerGram;
+        raw = raw > 0x7FFFFF ? 0x7FFFFF : raw < -0x800000 ? -0x800000 : raw;
+        conversion = (long)raw;
+
+        if (ready)
+        {
+            missedConversions++;
+        }
+        else if (pulses == 0)
+        {
+            ready = true;
+            Sim::raisePin(doutPin, true);
+        }
+        return now + CONVERSION_US;
+    }
+
+    int readDout()
+    {
+        if (pulses == 0)
+            return ready ? LOW : HIGH;
+        if (pulses > 24)
+            return HIGH;
+        return (conversion >> (24 - pulses)) & 1;
+    }
+
+    void writeSck(int level)
+    {
+        if (level != HIGH || (!ready && pulses == 0))
+            return;
+        // 24 data bits, the 25th pulse ends the read
+        if (++pulses == 25)
+        {
+            pulses = 0;
+            ready = false;
+        }
+    }
+}
+
+void Sim::LoadCell::setWeight(double grams)
+{
+    weight = grams;
+}
+
+void Sim::LoadCell::setNoise(double grams)
+{
+    noise = grams;
+}
+
+void Sim::LoadCell::setCalibration(double perGram, long offset)
+{
+    rawPerGram = perGram;
+    rawOffset = offset;
+}
+
+unsigned long Sim::LoadCell::missed()
+{
+    return missedConversions;
+}
+
+void HX711::begin(byte dout, byte pd_sck, byte gain)
+{
+    doutPin = dout;
+    Sim::attachPin(dout, {readDout, nullptr});
+    Sim::attachPin(pd_sck, {nullptr, writeSck});
+    if (!attached)
+    {
+        attached = true;
+        Sim::Clock::onAdvance([](uint64_t now) {
+            // the first conversion finishes one period after power up
+            static bool started = false;
+            if (!started)
+            {
+                started = true;
+                return now + CONVERSION_US;
+            }
+            return convert(now);
+        });
+    }
+}
+
+bool HX711::is_ready()
+{
+    return readDout() == LOW;
+}
+
+void HX711::wait_ready(unsigned long delay_ms)
+{
+    while (!is_ready())
+        delay(delay_ms > 0 ? delay_ms : 1);
+}
+
+bool HX711::wait_ready_timeout(unsigned long timeout, unsigned long delay_ms)
+{
+    unsigned long start = millis();
+    while (millis() - start < timeout)
+    {
+        if (is_ready())
+            return true;
+        delay(delay_ms > 0 ? delay_ms : 1);
+    }
+    return false;
+}
+
+long HX711::read()
+{
+    wait_ready();
+    // shifting out takes about 25 * 2 us
+    long value = conversion;
+    ready = false;
+    pulses = 0;
+    delayMicroseconds(50);
+    return value;
+}
+
+long HX711::read_average(byte times)
+{
+    long sum = 0;
+    for (byte i = 0; i < times; i++)
+        sum += read();
+    return times > 0 ? sum / times : 0;
+}
+
+double HX711::get_value(byte times)
+{
+    return read_average(times) - OFFSET;
+}
+
+float HX711::get_units(byte times)
+{
+    return get_value(times) / SCALE;
+}
+
+void HX711::tare(byte times)
+{
+    set_offset(read_average(times));
+}
+
+void HX711::set_scale(float scale)
+{
+    SCALE = scale;
+}
+
+float HX711::get_scale()
+{
+    return SCALE;
+}
+
+void HX711::set_offset(long offset)
+{
+    OFFSET = offset;
+}
+
+long HX711::get_offset()
+{
+    return OFFSET;
+}
@@ -0,0 +1,234 @@
+/**
+ * @file mfrc522.cpp
+ * @brief Simulated MFRC522 reader with a MIFARE Classic 1K tag.
+ *
+ * The tag follows the ISO 14443-3 states: a REQA only wakes an idle tag, a WUPA also a halted one. Reads and writes
+ * need an authentication of the sector with the key stored in its trailer. Every command advances the virtual clock
+ * by about the time the reader takes, a REQA without a tag waits for the 25 ms timeout of the library.
+ */
+#include "MFRC522.h"
+#include "sim.h"
+
+namespace
+{
+    const unsigned long REQUEST_US = 1000;   // REQA or WUPA answered by a tag
+    const unsigned long TIMEOUT_US = 25000;  // command without an answer
+    const unsigned long SELECT_US = 2000;    // anticollision and select
+    const unsigned long TRANSFER_US = 3000;  // authentication, read or write of a block
+
+    /**
+     * @brief ISO 14443-3 state of the tag.
+     */
+    enum class State
+    {
+        Absent,
+        Idle,
+        Ready,
+        Active,
+        Halted
+    };
+
+    State state = State::Absent;
+    std::vector<uint8_t> tagUid;
+    std::vector<uint8_t> tagMemory(Sim::Tag::BLOCKS * Sim::Tag::BLOCK_SIZE, 0);
+    int authenticatedSector = -1;
+
+    uint8_t *block(byte blockAddr)
+    {
+        return &tagMemory[blockAddr * Sim::Tag::BLOCK_SIZE];
+    }
+
+    bool answer(unsigned long us)
+    {
+        if (state == State::Absent)
+        {
+            delayMicroseconds(TIMEOUT_US);
+            return false;
+        }
+        delayMicroseconds(us);
+        return true;
+    }
+}
+
+void Sim::Tag::place(const std::vector<uint8_t> &uid, const uint8_t *memory)
+{
+    tagUid = uid;
+    if (memory != nullptr)
+    {
+        tagMemory.assign(memory, memory + BLOCKS * BLOCK_SIZE);
+    }
+    else
+    {
+        // transport configuration: default keys, all blocks readable and writable with key A
+        std::fill(tagMemory.begin(), tagMemory.end(), 0);
+        for (size_t sector = 0; sector < BLOCKS / 4; sector++)
+        {
+            uint8_t *trailer = block(sector * 4 + 3);
+            memset(trailer, 0xFF, 6);
+            const uint8_t access[] = {0xFF, 0x07, 0x80, 0x69};
+            memcpy(trailer + 6, access, sizeof(access));
+            memset(trailer + 10, 0xFF, 6);
+        }
+        uint8_t bcc = 0;
+        for (size_t i = 0; i < uid.size() && i < 4; i++)
+        {
+            block(0)[i] = uid[i];
+            bcc ^= uid[i];
+        }
+        block(0)[4] = bcc;
+        block(0)[5] = 0x08;
+    }
+    state = State::Idle;
+    authenticatedSector = -1;
+}
+
+void Sim::Tag::remove()
+{
+    state = State::Absent;
+    authenticatedSector = -1;
+}
+
+const std::vector<uint8_t> &Sim::Tag::memory()
+{
+    return tagMemory;
+}
+
+TagData Sim::Tag::spool(const char *spoolId)
+{
+    TagData data;
+    memset(&data, 0, sizeof(data));
+    Conversion::parseUuid(spoolId, data.spoolId);
+    data.spoolWeight = 1000;
+    strcpy(data.material, "PETG");
+    strcpy(data.color, "#ff8000");
+    strcpy(data.manufacturer, "Prusament");
+    strcpy(data.spoolName, "Galaxy Black");
+    data.timestamp = 1700000000;
+    return data;
+}
+
+std::vector<uint8_t> Sim::Tag::write(const std::vector<uint8_t> &uid, RFID &reader, TagData &data)
+{
+    place(uid, nullptr);
+    std::vector<uint8_t> memory;
+    if (reader.write(data))
+        memory = tagMemory;
+    remove();
+    return memory;
+}
+
+bool MFRC522::PICC_IsNewCardPresent()
+{
+    if (state != State::Idle)
+    {
+        delayMicroseconds(TIMEOUT_US);
+        return false;
+    }
+    delayMicroseconds(REQUEST_US);
+    state = State::Ready;
+    return true;
+}
+
+MFRC522::StatusCode MFRC522::PICC_WakeupA(byte *bufferATQA, byte *bufferSize)
+{
+    if (!answer(REQUEST_US))
+        return STATUS_TIMEOUT;
+    if (bufferATQA != nullptr && bufferSize != nullptr && *bufferSize >= 2)
+    {
+        bufferATQA[0] = 0x04;
+        bufferATQA[1] = 0x00;
+        *bufferSize = 2;
+    }
+    state = State::Ready;
+    authenticatedSector = -1;
+    return STATUS_OK;
+}
+
+bool MFRC522::PICC_ReadCardSerial()
+{
+    if (state != State::Ready || !answer(SELECT_US))
+        return false;
+    uid.size = tagUid.size();
+    memcpy(uid.uidByte, tagUid.data(), tagUid.size());
+    uid.sak = 0x08;
+    state = State::Active;
+    return true;
+}
+
+MFRC522::StatusCode MFRC522::PICC_HaltA()
+{
+    // the library reports success when the tag doesn't answer, as a halted tag never answers
+    delayMicroseconds(REQUEST_US);
+    if (state != State::Absent)
+        state = State::Halted;
+    authenticatedSector = -1;
+    return STATUS_OK;
+}
+
+MFRC522::PICC_Type MFRC522::PICC_GetType(byte sak)
+{
+    switch (sak & 0x7F)
+    {
+    case 0x09:
+        return PICC_TYPE_MIFARE_MINI;
+    case 0x08:
+        return PICC_TYPE_MIFARE_1K;
+    case 0x18:
+        return PICC_TYPE_MIFARE_4K;
+    default:
+        return PICC_TYPE_UNKNOWN;
+    }
+}
+
+MFRC522::StatusCode MFRC522::PCD_Authenticate(byte command, byte blockAddr, MIFARE_Key *key, Uid *uid)
+{
+    if (state != State::Active || blockAddr >= Sim::Tag::BLOCKS || !answer(TRANSFER_US))
+        return STATUS_TIMEOUT;
+
+    const uint8_t *trailer = block(blockAddr / 4 * 4 + 3);
+    const uint8_t *expected = command == PICC_CMD_MF_AUTH_KEY_B ? trailer + 10 : trailer;
+    if (memcmp(expected, key->keyByte, MF_KEY_SIZE) != 0)
+    {
+        // a failed authentication leaves the tag idle until it is selected again
+        state = State::Idle;
+        authenticatedSector = -1;
+        return STATUS_TIMEOUT;
+    }
+    authenticatedSector = blockAddr / 4;
+    return STATUS_OK;
+}
+
+void MFRC522::PCD_StopCrypto1()
+{
+    authenticatedSector = -1;
+}
+
+MFRC522::StatusCode MFRC522::MIFARE_Read(byte blockAddr, byte *buffer, byte *bufferSize)
+{
+    if (buffer == nullptr || *bufferSize < 18)
+        return STATUS_NO_ROOM;
+    if (state != State::Active || !answer(TRANSFER_US))
+        return STATUS_TIMEOUT;
+    if (blockAddr >= Sim::Tag::BLOCKS || authenticatedSector != blockAddr / 4)
+        return STATUS_MIFARE_NACK;
+
+    memcpy(buffer, block(blockAddr), Sim::Tag::BLOCK_SIZE);
+    buffer[16] = 0;
+    buffer[17] = 0;
+    *bufferSize = 18;
+    return STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522::MIFARE_Write(byte blockAddr, byte *buffer, byte bufferSize)
+{
+    if (buffer == nullptr || bufferSize < 16)
+        return STATUS_INVALID;
+    if (state != State::Active || !answer(TRANSFER_US))
+        return STATUS_TIMEOUT;
+    // the manufacturer block is read only
+    if (blockAddr == 0 || blockAddr >= Sim::Tag::BLOCKS || authenticatedSector != blockAddr / 4)
+        return STATUS_MIFARE_NACK;
+
+    memcpy(block(blockAddr), buffer, Sim::Tag::BLOCK_SIZE);
+    return STATUS_OK;
+}
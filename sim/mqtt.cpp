@@ -0,0 +1,282 @@
+/**
+ * @file mqtt.cpp
+ * @brief Simulated network and MQTT broker.
+ *
+ * The broker keeps every message the firmware publishes and delivers injected messages to the subscriptions of the
+ * client like a QoS 0 broker, one per PubSubClient::loop() call like the library. Connecting and publishing advance
+ * the virtual clock by a typical round trip.
+ */
+#include "PubSubClient.h"
+#include "WiFi.h"
+#include "sim.h"
+
+WiFiClass WiFi;
+
+namespace
+{
+    const unsigned long ASSOCIATE_MS = 1000; // WiFi association after begin()
+    const unsigned long CONNECT_US = 20000;  // TCP and MQTT handshake
+    const unsigned long PUBLISH_US = 1000;   // handing a message to the network stack
+
+    bool networkOnline = true;
+    std::vector<Sim::Broker::Message> publishedMessages;
+    bool keepMessages = true;
+    unsigned long publishCount = 0;
+    std::vector<std::pair<std::string, std::string>> pending;
+
+    /**
+     * @brief Matches a topic against a subscription filter with + and # wildcards.
+     */
+    bool matches(const std::string &filter, const std::string &topic)
+    {
+        size_t f = 0, t = 0;
+        while (f < filter.size())
+        {
+            if (filter[f] == '#')
+                return true;
+            if (filter[f] == '+')
+            {
+                while (t < topic.size() && topic[t] != '/')
+                    t++;
+                f++;
+                continue;
+            }
+            if (t >= topic.size() || filter[f] != topic[t])
+                return false;
+            f++;
+            t++;
+        }
+        return t == topic.size();
+    }
+
+    void record(const std::string &topic, const std::string &payload)
+    {
+        Sim::Clock::advance(PUBLISH_US);
+        publishCount++;
+        if (keepMessages)
+            publishedMessages.push_back({Sim::Clock::now(), topic, payload});
+        if (!Sim::verbose)
+            return;
+        bool printable = true;
+        for (char c : payload)
+            printable &= isprint((unsigned char)c) || c == '\n';
+        fprintf(stderr, "[mqtt %lu] %s (%zu bytes)", millis(), topic.c_str(), payload.size());
+        if (printable)
+            fprintf(stderr, " %s", payload.c_str());
+        fputc('\n', stderr);
+    }
+}
+
+void Sim::Broker::setOnline(bool up)
+{
+    networkOnline = up;
+}
+
+bool Sim::Broker::online()
+{
+    return networkOnline;
+}
+
+void Sim::Broker::inject(const std::string &topic, const std::string &payload)
+{
+    pending.push_back(std::make_pair(topic, payload));
+}
+
+const std::vector<Sim::Broker::Message> &Sim::Broker::published()
+{
+    return publishedMessages;
+}
+
+void Sim::Broker::keep(bool messages)
+{
+    keepMessages = messages;
+}
+
+unsigned long Sim::Broker::count()
+{
+    return publishCount;
+}
+
+size_t IPAddress::printTo(Print &p) const
+{
+    return p.printf("%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase)
+{
+    started = true;
+    startTime = millis();
+    return status();
+}
+
+bool WiFiClass::disconnect(bool wifioff)
+{
+    started = false;
+    return true;
+}
+
+wl_status_t WiFiClass::status()
+{
+    if (!started)
+        return WL_IDLE_STATUS;
+    if (!networkOnline)
+        return WL_DISCONNECTED;
+    return millis() - startTime >= ASSOCIATE_MS ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress WiFiClass::localIP()
+{
+    return status() == WL_CONNECTED ? IPAddress(192, 168, 4, 2) : IPAddress();
+}
+
+int8_t WiFiClass::RSSI()
+{
+    return status() == WL_CONNECTED ? -55 : 0;
+}
+
+PubSubClient &PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE)
+{
+    this->callback = callback;
+    return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size)
+{
+    if (size == 0)
+        return false;
+    bufferSize = size;
+    return true;
+}
+
+bool PubSubClient::connect(const char *id, const char *user, const char *pass)
+{
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        connectionState = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    Sim::Clock::advance(CONNECT_US);
+    isConnected = true;
+    connectionState = MQTT_CONNECTED;
+    subscriptions.clear();
+    return true;
+}
+
+void PubSubClient::disconnect()
+{
+    isConnected = false;
+    connectionState = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected()
+{
+    if (isConnected && !networkOnline)
+    {
+        isConnected = false;
+        connectionState = MQTT_CONNECTION_LOST;
+    }
+    return isConnected;
+}
+
+int PubSubClient::state()
+{
+    return connectionState;
+}
+
+bool PubSubClient::loop()
+{
+    if (!connected())
+        return false;
+
+    // like the library, a call reads one message; it is copied into the buffer of the client, a larger one is dropped
+    while (!pending.empty())
+    {
+        std::pair<std::string, std::string> message = pending.front();
+        pending.erase(pending.begin());
+        bool subscribed = false;
+        for (const std::string &filter : subscriptions)
+            subscribed |= matches(filter, message.first);
+        // the broker doesn't send messages of other topics
+        if (!subscribed || !callback)
+            continue;
+        if (message.first.size() + message.second.size() + 7 > bufferSize)
+            break;
+
+        std::vector<char> topic(message.first.begin(), message.first.end());
+        topic.push_back('\0');
+        std::vector<uint8_t> payload(message.second.begin(), message.second.end());
+        payload.push_back(0);
+        delivered = payload.data();
+        deliveredLength = message.second.size();
+        callback(topic.data(), payload.data(), message.second.size());
+        delivered = nullptr;
+        break;
+    }
+    return true;
+}
+
+bool PubSubClient::subscribe(const char *topic, uint8_t qos)
+{
+    if (!connected())
+        return false;
+    subscriptions.push_back(topic);
+    return true;
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload, bool retained)
+{
+    return publish(topic, (const uint8_t *)payload, strlen(payload), retained);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained)
+{
+    // like the library, payloads that don't fit into the buffer are refused
+    if (!connected() || strlen(topic) + length + 7 > bufferSize)
+        return false;
+    overwriteDelivered(topic);
+    record(topic, std::string((const char *)payload, length));
+    return true;
+}
+
+bool PubSubClient::beginPublish(const char *topic, unsigned int length, bool retained)
+{
+    if (!connected())
+        return false;
+    overwriteDelivered(topic);
+    this->topic = topic;
+    this->length = length;
+    payload.clear();
+    return true;
+}
+
+int PubSubClient::endPublish()
+{
+    if (!connected() || payload.size() != length)
+        return 0;
+    record(topic, payload);
+    return 1;
+}
+
+size_t PubSubClient::write(uint8_t c)
+{
+    if (!connected())
+        return 0;
+    payload += (char)c;
+    return 1;
+}
+
+size_t PubSubClient::write(const uint8_t *buffer, size_t size)
+{
+    if (!connected())
+        return 0;
+    payload.append((const char *)buffer, size);
+    return size;
+}
+
+void PubSubClient::overwriteDelivered(const char *topic)
+{
+    if (delivered == nullptr)
+        return;
+    size_t size = strlen(topic);
+    memcpy(delivered, topic, size < deliveredLength ? size : deliveredLength);
+}
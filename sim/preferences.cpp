@@ -0,0 +1,64 @@
+/**
+ * @file preferences.cpp
+ * @brief Simulated non-volatile storage, lost when the simulator exits.
+ */
+#include "Preferences.h"
+#include "SPI.h"
+
+#include <map>
+
+SPIClass SPI;
+
+namespace
+{
+    std::map<std::string, std::map<std::string, std::string>> storage;
+}
+
+bool Preferences::begin(const char *name, bool readOnly)
+{
+    // keys are limited to 15 characters like in NVS
+    this->name = name;
+    this->readOnly = readOnly;
+    started = strlen(name) <= 15;
+    return started;
+}
+
+void Preferences::end()
+{
+    started = false;
+}
+
+bool Preferences::clear()
+{
+    if (!started || readOnly)
+        return false;
+    storage[name].clear();
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    if (!started || readOnly)
+        return false;
+    return storage[name].erase(key) > 0;
+}
+
+size_t Preferences::put(const char *key, const void *value, size_t size)
+{
+    if (!started || readOnly || strlen(key) > 15)
+        return 0;
+    storage[name][key] = std::string((const char *)value, size);
+    return size;
+}
+
+bool Preferences::read(const char *key, void *value, size_t size)
+{
+    if (!started)
+        return false;
+    auto found = storage[name].find(key);
+    // NVS fails on a type mismatch, the size stands in for the type
+    if (found == storage[name].end() || found->second.size() != size)
+        return false;
+    memcpy(value, found->second.data(), size);
+    return true;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file runner.cpp
+ * @brief Entry point of the host simulator, runs setup() and loop() of the firmware in virtual time.
+ *
+ * A scenario file drives the simulated devices, one event per line: the virtual time in milliseconds, a command and
+ * its arguments, see sim/README.md. After the run the simulator reports the loop stall times of Sim::runLoop(), the
+ * virtual time the firmware spent inside one pass of loop() waiting for delays, bus transfers and timeouts.
+ */
+#include <Arduino.h>
+#include "sim.h"
+
+#include <chrono>
+#include <stdlib.h>
+
+void setup();
+
+bool Sim::verbose = false;
+
+// pio test links the sources with the main() of the test runner
+#ifndef PIO_UNIT_TESTING
+
+namespace
+{
+    /**
+     * @brief Options of the run.
+     */
+    struct Options
+    {
+        const char *scenario = nullptr;
+        unsigned long duration = 60000;  // virtual milliseconds
+        unsigned long passTime = 100;    // virtual microseconds a pass of loop() takes besides waits
+        double maxStall = 0;             // milliseconds, 0 disables the check
+    };
+
+    void usage(const char *program)
+    {
+        fprintf(stderr,
+                "usage: %s [-s scenario] [-t duration_ms] [-p pass_us] [-m max_stall_ms] [-v]\n"
+                "  -s  scenario file, see sim/README.md\n"
+                "  -t  virtual run time in milliseconds (60000)\n"
+                "  -p  virtual time of a pass of loop() besides waits in microseconds (100)\n"
+                "  -m  exit with 2 if a pass of loop() stalls longer than this many milliseconds\n"
+                "  -v  print the published MQTT messages\n",
+                program);
+    }
+
+    bool parseOptions(int argc, char **argv, Options &options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string option = argv[i];
+            if (option == "-v")
+            {
+                Sim::verbose = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+                return false;
+            const char *value = argv[++i];
+            if (option == "-s")
+                options.scenario = value;
+            else if (option == "-t")
+                options.duration = strtoul(value, nullptr, 10);
+            else if (option == "-p")
+                options.passTime = strtoul(value, nullptr, 10);
+            else if (option == "-m")
+                options.maxStall = atof(value);
+            else
+                return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    Sim::Scenario scenario;
+    if (options.scenario != nullptr && !scenario.load(options.scenario))
+        return 1;
+
+    auto wallStart = std::chrono::steady_clock::now();
+    setup();
+    uint64_t setupTime = Sim::Clock::now();
+
+    uint64_t runTime = (uint64_t)options.duration * 1000 > setupTime ? (uint64_t)options.duration * 1000 - setupTime : 0;
+    Sim::Stall stall = Sim::runLoop((unsigned long)((runTime + 999) / 1000), options.passTime, &scenario);
+    if (!stall.complete)
+        return 1;
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    fflush(stdout);
+
+    fprintf(stderr, "[sim] %lu ms virtual in %.2f s, setup %.1f ms, %lu loop passes\n", options.duration, wallSeconds, setupTime / 1000.0, stall.passes);
+    fprintf(stderr, "[sim] loop stall: max %.3f ms at %.1f ms, mean %.3f ms\n", stall.max / 1000.0, stall.maxAt / 1000.0, stall.mean() / 1000.0);
+    fprintf(stderr, "[sim] host time per loop pass: mean %.2f us, max %.2f us\n", stall.passes > 0 ? wallSeconds * 1e6 / stall.passes : 0, stall.maxWall);
+    fprintf(stderr, "[sim] display %lu bytes, mqtt %lu messages, %lu missed HX711 conversions\n", Sim::Panel::bytes(), Sim::Broker::count(), Sim::LoadCell::missed());
+
+    if (options.maxStall > 0 && stall.max / 1000.0 > options.maxStall)
+    {
+        fprintf(stderr, "[sim] loop stall of %.3f ms exceeds %.3f ms\n", stall.max / 1000.0, options.maxStall);
+        return 2;
+    }
+    return 0;
+}
+
+#endif
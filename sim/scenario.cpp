@@ -0,0 +1,207 @@
+/**
+ * @file scenario.cpp
+ * @brief Scenario events and the loop driver of the host simulator.
+ *
+ * runLoop() runs passes of the firmware's loop() in virtual time and measures how long each pass stalls. The runner
+ * and the host tests share it, so the stall the simulator reports is the one the tests assert on.
+ */
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+void loop();
+
+namespace
+{
+    bool parseHex(const std::string &hex, std::vector<uint8_t> &bytes)
+    {
+        if (hex.empty() || hex.size() % 2 != 0)
+            return false;
+        for (size_t i = 0; i < hex.size(); i += 2)
+        {
+            char *end;
+            std::string pair = hex.substr(i, 2);
+            bytes.push_back((uint8_t)strtoul(pair.c_str(), &end, 16));
+            if (*end != '\0')
+                return false;
+        }
+        return true;
+    }
+}
+
+bool Sim::Scenario::load(const char *path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "[sim] can't open scenario %s\n", path);
+        return false;
+    }
+    return parse(file, path);
+}
+
+bool Sim::Scenario::parse(std::istream &input, const char *name)
+{
+    this->name = name;
+    std::string text;
+    int line = 0;
+    while (std::getline(input, text))
+    {
+        line++;
+        size_t start = text.find_first_not_of(" \t\r");
+        if (start == std::string::npos || text[start] == '#')
+            continue;
+        std::istringstream stream(text);
+        Event event;
+        if (!(stream >> event.time >> event.command))
+        {
+            fprintf(stderr, "[sim] %s:%d: expected <time_ms> <command>\n", name, line);
+            return false;
+        }
+        std::getline(stream >> std::ws, event.arguments);
+        while (!event.arguments.empty() && (event.arguments.back() == '\r' || event.arguments.back() == ' '))
+            event.arguments.pop_back();
+        event.line = line;
+        events.push_back(event);
+    }
+    std::stable_sort(events.begin() + next, events.end(), [](const Event &a, const Event &b) { return a.time < b.time; });
+    return true;
+}
+
+bool Sim::Scenario::run(uint64_t now)
+{
+    while (next < events.size() && (uint64_t)events[next].time * 1000 <= now)
+    {
+        const Event &event = events[next++];
+        if (!runEvent(event))
+        {
+            fprintf(stderr, "[sim] %s:%d: invalid event '%s %s'\n", name.c_str(), event.line, event.command.c_str(), event.arguments.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Sim::Scenario::runEvent(const Event &event)
+{
+    std::istringstream arguments(event.arguments);
+    if (event.command == "weight")
+    {
+        double grams;
+        if (!(arguments >> grams))
+            return false;
+        Sim::LoadCell::setWeight(grams);
+    }
+    else if (event.command == "noise")
+    {
+        double grams;
+        if (!(arguments >> grams))
+            return false;
+        Sim::LoadCell::setNoise(grams);
+    }
+    else if (event.command == "calibration")
+    {
+        double rawPerGram;
+        long offset = 0;
+        if (!(arguments >> rawPerGram))
+            return false;
+        arguments >> offset;
+        Sim::LoadCell::setCalibration(rawPerGram, offset);
+    }
+    else if (event.command == "tag")
+    {
+        std::string uidHex, path;
+        std::vector<uint8_t> uid;
+        if (!(arguments >> uidHex) || !parseHex(uidHex, uid) || (uid.size() != 4 && uid.size() != 7))
+            return false;
+        if (!(arguments >> path))
+        {
+            Sim::Tag::place(uid, nullptr);
+            return true;
+        }
+        std::vector<uint8_t> memory(Sim::Tag::BLOCKS * Sim::Tag::BLOCK_SIZE);
+        std::ifstream file(path, std::ios::binary);
+        if (!file.read((char *)memory.data(), memory.size()))
+        {
+            fprintf(stderr, "[sim] can't read a 1K tag dump from %s\n", path.c_str());
+            return false;
+        }
+        Sim::Tag::place(uid, memory.data());
+    }
+    else if (event.command == "untag")
+    {
+        Sim::Tag::remove();
+    }
+    else if (event.command == "save-tag")
+    {
+        std::string path;
+        if (!(arguments >> path))
+            return false;
+        std::ofstream file(path, std::ios::binary);
+        const std::vector<uint8_t> &memory = Sim::Tag::memory();
+        file.write((const char *)memory.data(), memory.size());
+    }
+    else if (event.command == "mqtt")
+    {
+        std::string topic, payload;
+        if (!(arguments >> topic))
+            return false;
+        std::getline(arguments >> std::ws, payload);
+        Sim::Broker::inject(topic, payload);
+    }
+    else if (event.command == "online")
+    {
+        Sim::Broker::setOnline(true);
+    }
+    else if (event.command == "offline")
+    {
+        Sim::Broker::setOnline(false);
+    }
+    else if (event.command == "dump")
+    {
+        std::string path;
+        if (!(arguments >> path) || !Sim::Panel::dump(path.c_str()))
+            return false;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+Sim::Stall Sim::runLoop(unsigned long ms, unsigned long passTime, Scenario *scenario)
+{
+    Stall stall;
+    uint64_t end = Sim::Clock::now() + ms * 1000ULL;
+    while (Sim::Clock::now() < end)
+    {
+        if (scenario != nullptr && !scenario->run(Sim::Clock::now()))
+        {
+            stall.complete = false;
+            break;
+        }
+
+        uint64_t start = Sim::Clock::now();
+        auto wall = std::chrono::steady_clock::now();
+        loop();
+        double wallUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - wall).count();
+        uint64_t pass = Sim::Clock::now() - start;
+
+        stall.passes++;
+        stall.total += pass;
+        stall.maxWall = std::max(stall.maxWall, wallUs);
+        if (pass > stall.max)
+        {
+            stall.max = pass;
+            stall.maxAt = start;
+        }
+        Sim::Clock::advance(passTime);
+    }
+    return stall;
+}
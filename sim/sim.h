@@ -0,0 +1,307 @@
+/**
+ * @file sim.h
+ * @brief Control interface of the host simulator.
+ *
+ * The headers in this directory replace the Arduino core and the libraries the firmware uses (HX711, MFRC522,
+ * Adafruit_SSD1306, PubSubClient, WiFi, Preferences, Wire, SPI) when it is built with the native environment. They
+ * keep the library interfaces, so the sources in src/ build unchanged, but talk to the simulated devices declared
+ * here. All of them run on a virtual clock: delay() and bus transfers advance it instead of waiting.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <rfid.h>
+
+namespace Sim
+{
+    /**
+     * @brief Virtual clock behind millis(), micros() and delay().
+     */
+    namespace Clock
+    {
+        /**
+         * @brief Returns the virtual time in microseconds.
+         */
+        uint64_t now();
+
+        /**
+         * @brief Advances the virtual time and raises the interrupts of the devices that became due.
+         * @param us The time in microseconds.
+         */
+        void advance(uint64_t us);
+
+        /**
+         * @brief Registers a device that changes state over time.
+         * @param update Called with the virtual time in microseconds whenever its last returned time is reached,
+         *               returns the time of the next state change of the device.
+         */
+        void onAdvance(const std::function<uint64_t(uint64_t)> &update);
+    }
+
+    /**
+     * @brief Handler of a simulated GPIO pin, devices register one for the pins they drive or sample.
+     */
+    struct Pin
+    {
+        std::function<int()> read;       // Level of the pin, nullptr if the device doesn't drive it.
+        std::function<void(int)> write;  // Called when the firmware sets the pin, nullptr if ignored.
+    };
+
+    /**
+     * @brief Connects a pin to a device.
+     * @param pin The pin number.
+     * @param handler The handler of the pin.
+     */
+    void attachPin(uint8_t pin, const Pin &handler);
+
+    /**
+     * @brief Raises the interrupt attached to a pin, if any, for a level change of the device.
+     * @param pin The pin number.
+     * @param falling True for a falling edge, false for a rising edge.
+     */
+    void raisePin(uint8_t pin, bool falling);
+
+    /**
+     * @brief Connects a device to the I2C bus.
+     * @param address The 7 bit address of the device.
+     * @param receive Called with the bytes of each transmission to the device, without the address byte.
+     */
+    void attachI2c(uint8_t address, const std::function<void(const uint8_t *, size_t)> &receive);
+
+    /**
+     * @brief Simulated HX711 with a load cell, the weight is converted at 10 samples per second.
+     */
+    namespace LoadCell
+    {
+        /**
+         * @brief Sets the weight on the load cell.
+         * @param grams The weight in grams.
+         */
+        void setWeight(double grams);
+
+        /**
+         * @brief Sets the standard deviation of the gaussian noise added to each conversion.
+         * @param grams The noise in grams.
+         */
+        void setNoise(double grams);
+
+        /**
+         * @brief Sets the conversion of grams into raw readings.
+         * @param rawPerGram Raw units per gram, the calibration factor of the firmware.
+         * @param offset Raw reading of the empty load cell.
+         */
+        void setCalibration(double rawPerGram, long offset);
+
+        /**
+         * @brief Returns the number of conversions the firmware never read.
+         */
+        unsigned long missed();
+    }
+
+    /**
+     * @brief Simulated MIFARE Classic 1K tag in the field of the MFRC522.
+     */
+    namespace Tag
+    {
+        static const size_t BLOCKS = 64;     // Blocks of a 1K tag.
+        static const size_t BLOCK_SIZE = 16; // Bytes of a block.
+
+        /**
+         * @brief Places a tag in the field.
+         * @param uid The UID, 4 or 7 bytes.
+         * @param memory The tag memory, BLOCKS * BLOCK_SIZE bytes, nullptr for a blank tag with default keys.
+         */
+        void place(const std::vector<uint8_t> &uid, const uint8_t *memory);
+
+        /**
+         * @brief Removes the tag from the field.
+         */
+        void remove();
+
+        /**
+         * @brief Returns the memory of the tag in the field, or of the last one removed.
+         */
+        const std::vector<uint8_t> &memory();
+
+        /**
+         * @brief Returns the spool the host tests put on the scale: 1000 g of PETG, #ff8000, Prusament Galaxy Black.
+         * @param spoolId The spool UUID.
+         */
+        TagData spool(const char *spoolId);
+
+        /**
+         * @brief Writes a blank tag with a reader of the firmware and removes it from the field again.
+         * @param uid The UID, 4 or 7 bytes.
+         * @param reader The reader writing the tag.
+         * @param data The data to write.
+         * @return The memory of the written tag, empty if the reader failed to write it.
+         */
+        std::vector<uint8_t> write(const std::vector<uint8_t> &uid, RFID &reader, TagData &data);
+    }
+
+    /**
+     * @brief Simulated SSD1306 panel on the I2C bus, decodes the command and data streams into its display RAM.
+     */
+    namespace Panel
+    {
+        /**
+         * @brief Writes the panel content as plain PBM image.
+         * @param path The file path.
+         * @return True if the file was written.
+         */
+        bool dump(const char *path);
+
+        /**
+         * @brief Returns the number of bytes sent to the panel, including the address bytes.
+         */
+        unsigned long bytes();
+
+        /**
+         * @brief Returns the display RAM, 8 pages of 128 columns in the layout of the framebuffer.
+         */
+        const uint8_t *ram();
+    }
+
+    /**
+     * @brief In-process MQTT broker the PubSubClient connects to.
+     */
+    namespace Broker
+    {
+        /**
+         * @brief Message published by the firmware.
+         */
+        struct Message
+        {
+            uint64_t time;        // Virtual time of the publish in microseconds.
+            std::string topic;    // Topic of the message.
+            std::string payload;  // Payload, may be binary.
+        };
+
+        /**
+         * @brief Makes the broker and WiFi reachable or unreachable.
+         * @param up True if reachable.
+         */
+        void setOnline(bool up);
+
+        /**
+         * @brief Returns whether the broker is reachable.
+         */
+        bool online();
+
+        /**
+         * @brief Queues a message for the subscribed client, it is delivered in PubSubClient::loop().
+         * @param topic The topic.
+         * @param payload The payload.
+         */
+        void inject(const std::string &topic, const std::string &payload);
+
+        /**
+         * @brief Returns the messages published by the firmware.
+         */
+        const std::vector<Message> &published();
+
+        /**
+         * @brief Keeps the published messages for published(), on by default. Keeping a message allocates, tests
+         *        that count the heap allocations of the firmware turn it off.
+         * @param messages True to keep the messages.
+         */
+        void keep(bool messages);
+
+        /**
+         * @brief Returns the number of messages published by the firmware, kept or not.
+         */
+        unsigned long count();
+    }
+
+    /**
+     * @brief Events driving the simulated devices, one per line: the virtual time in milliseconds, a command and its
+     *        arguments, see sim/README.md.
+     */
+    class Scenario
+    {
+    public:
+        /**
+         * @brief Reads the events of a scenario file.
+         * @param path The file path.
+         * @return True if the file was read and every line is an event.
+         */
+        bool load(const char *path);
+
+        /**
+         * @brief Reads the events of a scenario.
+         * @param input The scenario text.
+         * @param name The name of the scenario in error messages.
+         * @return True if every line is an event.
+         */
+        bool parse(std::istream &input, const char *name);
+
+        /**
+         * @brief Runs the events that became due.
+         * @param now The virtual time in microseconds.
+         * @return False if an event is invalid, the events after it don't run.
+         */
+        bool run(uint64_t now);
+
+    private:
+        /**
+         * @brief Event of the scenario.
+         */
+        struct Event
+        {
+            unsigned long time;    // Virtual time in milliseconds.
+            std::string command;   // Command name.
+            std::string arguments; // Rest of the line.
+            int line;              // Line in the scenario.
+        };
+
+        bool runEvent(const Event &event);
+
+        std::string name;          // Name of the scenario in error messages.
+        std::vector<Event> events; // Events ordered by time.
+        size_t next = 0;           // Index of the next event to run.
+    };
+
+    /**
+     * @brief Loop stall statistics of a run: the virtual time the firmware spent inside one pass of loop() waiting for
+     *        delays, bus transfers and timeouts.
+     */
+    struct Stall
+    {
+        unsigned long passes = 0; // Passes of loop().
+        uint64_t total = 0;       // Sum of the pass times in virtual microseconds.
+        uint64_t max = 0;         // Longest pass in virtual microseconds.
+        uint64_t maxAt = 0;       // Virtual time the longest pass started at in microseconds.
+        double maxWall = 0;       // Longest pass in host microseconds.
+        bool complete = true;     // False if an invalid event of the scenario stopped the run.
+
+        /**
+         * @brief Returns the mean pass time in virtual microseconds.
+         */
+        double mean() const { return passes > 0 ? (double)total / passes : 0; }
+    };
+
+    /**
+     * @brief Runs passes of the firmware's loop() like the device does, each followed by the time of the pass besides
+     *        waits.
+     * @param ms The virtual time to run in milliseconds.
+     * @param passTime The virtual time of a pass besides waits in microseconds.
+     * @param scenario The events to run before each pass as they become due, nullptr for none.
+     * @return The stall statistics of the passes.
+     */
+    Stall runLoop(unsigned long ms, unsigned long passTime = 100, Scenario *scenario = nullptr);
+
+    /**
+     * @brief Flag printing every published message, set by the runner.
+     */
+    extern bool verbose;
+}
+
+#endif
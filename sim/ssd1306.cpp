@@ -0,0 +1,339 @@
+/**
+ * @file ssd1306.cpp
+ * @brief Simulated SSD1306 panel and the Adafruit library that drives it.
+ *
+ * The panel decodes the I2C command and data streams into its display RAM, so a dump shows what the panel would
+ * show, including the effect of the partial updates of the firmware.
+ */
+#include "Adafruit_SSD1306.h"
+#include "sim.h"
+
+namespace
+{
+    const uint8_t PANEL_ADDRESS = 0x3C;
+    const uint8_t PANEL_COLUMNS = 128;
+    const uint8_t PANEL_PAGES = 8;
+
+    /**
+     * @brief Classic 5x7 font for the characters 0x20 to 0x7E, one byte per column, LSB on top.
+     */
+    const uint8_t FONT[][5] = {
+        {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14},
+        {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},
+        {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x08, 0x2A, 0x1C, 0x2A, 0x08}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+        {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},
+        {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31},
+        {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+        {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},
+        {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14}, {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06},
+        {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+        {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x01, 0x01}, {0x3E, 0x41, 0x41, 0x51, 0x32},
+        {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41},
+        {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x04, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+        {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},
+        {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x7F, 0x20, 0x18, 0x20, 0x7F},
+        {0x63, 0x14, 0x08, 0x14, 0x63}, {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+        {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},
+        {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78}, {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20},
+        {0x38, 0x44, 0x44, 0x48, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x08, 0x14, 0x54, 0x54, 0x3C},
+        {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x44, 0x3D, 0x00}, {0x00, 0x7F, 0x10, 0x28, 0x44},
+        {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78}, {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38},
+        {0x7C, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7C}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+        {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C},
+        {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C}, {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00},
+        {0x00, 0x00, 0x7F, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00}, {0x08, 0x04, 0x08, 0x10, 0x08},
+    };
+
+    /**
+     * @brief Display RAM and address pointer of the panel.
+     */
+    struct Panel
+    {
+        uint8_t ram[PANEL_PAGES][PANEL_COLUMNS];
+        uint8_t mode = 2; // page addressing after reset
+        uint8_t columnStart = 0, columnEnd = PANEL_COLUMNS - 1, column = 0;
+        uint8_t pageStart = 0, pageEnd = PANEL_PAGES - 1, page = 0;
+        uint8_t command[7];
+        uint8_t commandLength = 0;
+        unsigned long bytes = 0;
+    } panel;
+
+    /**
+     * @brief Returns the number of bytes of a command including its arguments.
+     */
+    uint8_t commandSize(uint8_t command)
+    {
+        switch (command)
+        {
+        case 0x26:
+        case 0x27:
+            return 7;
+        case 0x29:
+        case 0x2A:
+            return 6;
+        case SSD1306_COLUMNADDR:
+        case SSD1306_PAGEADDR:
+        case 0xA3:
+            return 3;
+        case SSD1306_MEMORYMODE:
+        case 0x81:
+        case 0x8D:
+        case 0xA8:
+        case 0xD3:
+        case 0xD5:
+        case 0xD9:
+        case 0xDA:
+        case 0xDB:
+            return 2;
+        default:
+            return 1;
+        }
+    }
+
+    void execute(const uint8_t *c)
+    {
+        switch (c[0])
+        {
+        case SSD1306_MEMORYMODE:
+            panel.mode = c[1] & 0x03;
+            break;
+        case SSD1306_COLUMNADDR:
+            panel.columnStart = panel.column = c[1] & 0x7F;
+            panel.columnEnd = c[2] & 0x7F;
+            break;
+        case SSD1306_PAGEADDR:
+            panel.pageStart = panel.page = c[1] & 0x07;
+            panel.pageEnd = c[2] & 0x07;
+            break;
+        default:
+            if (panel.mode == 2 && c[0] >= 0xB0 && c[0] <= 0xB7)
+                panel.page = c[0] & 0x07;
+            else if (panel.mode == 2 && c[0] <= 0x0F)
+                panel.column = (panel.column & 0xF0) | c[0];
+            else if (panel.mode == 2 && c[0] >= 0x10 && c[0] <= 0x17)
+                panel.column = (panel.column & 0x0F) | ((c[0] & 0x07) << 4);
+            break;
+        }
+    }
+
+    void writeData(uint8_t data)
+    {
+        panel.ram[panel.page][panel.column] = data;
+        if (panel.mode == 2)
+        {
+            panel.column = (panel.column + 1) % PANEL_COLUMNS;
+            return;
+        }
+        if (panel.column++ < panel.columnEnd)
+            return;
+        panel.column = panel.columnStart;
+        panel.page = panel.page < panel.pageEnd ? panel.page + 1 : panel.pageStart;
+    }
+
+    void receive(const uint8_t *data, size_t length)
+    {
+        panel.bytes += length + 1;
+        if (length == 0)
+            return;
+        // control byte: bit 6 selects data, bit 7 (continuation) is only used for single commands
+        if (data[0] & 0x40)
+        {
+            for (size_t i = 1; i < length; i++)
+                writeData(data[i]);
+            return;
+        }
+        for (size_t i = 1; i < length; i++)
+        {
+            panel.command[panel.commandLength++] = data[i];
+            if (panel.commandLength >= commandSize(panel.command[0]))
+            {
+                execute(panel.command);
+                panel.commandLength = 0;
+            }
+        }
+    }
+}
+
+bool Sim::Panel::dump(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+    fprintf(file, "P1\n%u %u\n", PANEL_COLUMNS, PANEL_PAGES * 8);
+    for (uint8_t y = 0; y < PANEL_PAGES * 8; y++)
+    {
+        for (uint8_t x = 0; x < PANEL_COLUMNS; x++)
+            fputs((panel.ram[y / 8][x] >> (y % 8)) & 1 ? "1 " : "0 ", file);
+        fputc('\n', file);
+    }
+    return fclose(file) == 0;
+}
+
+unsigned long Sim::Panel::bytes()
+{
+    return panel.bytes;
+}
+
+const uint8_t *Sim::Panel::ram()
+{
+    return &panel.ram[0][0];
+}
+
+Adafruit_SSD1306::Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *twi, int8_t rst_pin, uint32_t clkDuring, uint32_t clkAfter)
+    : WIDTH(w), HEIGHT(h), wire(twi), wireClk(clkDuring), restoreClk(clkAfter)
+{
+}
+
+Adafruit_SSD1306::~Adafruit_SSD1306()
+{
+    delete[] buffer;
+}
+
+bool Adafruit_SSD1306::begin(uint8_t switchvcc, uint8_t addr, bool reset, bool periphBegin)
+{
+    if (buffer == nullptr)
+        buffer = new uint8_t[WIDTH * ((HEIGHT + 7) / 8)];
+    clearDisplay();
+    i2caddr = addr != 0 ? addr : (HEIGHT == 32 ? 0x3C : 0x3D);
+    Sim::attachI2c(PANEL_ADDRESS, receive);
+    memset(panel.ram, 0, sizeof(panel.ram));
+
+    const uint8_t init[] = {SSD1306_DISPLAYOFF, 0xD5, 0x80, 0xA8, (uint8_t)(HEIGHT - 1), 0xD3, 0x00, 0x40,
+                            0x8D, (uint8_t)(switchvcc == SSD1306_EXTERNALVCC ? 0x10 : 0x14), SSD1306_MEMORYMODE, 0x00,
+                            0xA1, 0xC8, 0xDA, (uint8_t)(HEIGHT == 64 ? 0x12 : 0x02), 0x81, 0xCF, 0xD9, 0xF1, 0xDB, 0x40,
+                            0xA4, 0xA6, 0x2E, SSD1306_DISPLAYON};
+    wire->setClock(wireClk);
+    commandList(init, sizeof(init));
+    wire->setClock(restoreClk);
+    return true;
+}
+
+void Adafruit_SSD1306::commandList(const uint8_t *c, uint8_t n)
+{
+    wire->beginTransmission(i2caddr);
+    wire->write((uint8_t)0x00);
+    uint16_t bytesOut = 1;
+    while (n--)
+    {
+        if (bytesOut >= I2C_BUFFER_LENGTH)
+        {
+            wire->endTransmission();
+            wire->beginTransmission(i2caddr);
+            wire->write((uint8_t)0x00);
+            bytesOut = 1;
+        }
+        wire->write(*c++);
+        bytesOut++;
+    }
+    wire->endTransmission();
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t c)
+{
+    commandList(&c, 1);
+}
+
+void Adafruit_SSD1306::display()
+{
+    const uint8_t addressing[] = {SSD1306_PAGEADDR, 0, 0xFF, SSD1306_COLUMNADDR, 0, (uint8_t)(WIDTH - 1)};
+    wire->setClock(wireClk);
+    commandList(addressing, sizeof(addressing));
+
+    uint16_t count = WIDTH * ((HEIGHT + 7) / 8);
+    uint8_t *ptr = buffer;
+    wire->beginTransmission(i2caddr);
+    wire->write((uint8_t)0x40);
+    uint16_t bytesOut = 1;
+    while (count--)
+    {
+        if (bytesOut >= I2C_BUFFER_LENGTH)
+        {
+            wire->endTransmission();
+            wire->beginTransmission(i2caddr);
+            wire->write((uint8_t)0x40);
+            bytesOut = 1;
+        }
+        wire->write(*ptr++);
+        bytesOut++;
+    }
+    wire->endTransmission();
+    wire->setClock(restoreClk);
+}
+
+void Adafruit_SSD1306::clearDisplay()
+{
+    if (buffer != nullptr)
+        memset(buffer, 0, WIDTH * ((HEIGHT + 7) / 8));
+}
+
+uint8_t *Adafruit_SSD1306::getBuffer()
+{
+    return buffer;
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+    if (buffer == nullptr || x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+        return;
+    uint8_t &b = buffer[x + (y / 8) * WIDTH];
+    uint8_t bit = 1 << (y & 7);
+    if (color == WHITE)
+        b |= bit;
+    else if (color == BLACK)
+        b &= ~bit;
+    else
+        b ^= bit;
+}
+
+void Adafruit_SSD1306::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+    for (int16_t i = 0; i < w; i++)
+        drawPixel(x + i, y, color);
+}
+
+void Adafruit_SSD1306::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+    for (int16_t i = 0; i < h; i++)
+        drawPixel(x, y + i, color);
+}
+
+void Adafruit_SSD1306::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    for (int16_t i = 0; i < w; i++)
+        drawFastVLine(x + i, y, h, color);
+}
+
+void Adafruit_SSD1306::drawChar(int16_t x, int16_t y, unsigned char c)
+{
+    if (c < 0x20 || c > 0x7E)
+        c = '?';
+    const uint8_t *glyph = FONT[c - 0x20];
+    for (int8_t i = 0; i < 5; i++)
+    {
+        for (int8_t j = 0; j < 8; j++)
+        {
+            if ((glyph[i] >> j) & 1)
+                fillRect(x + i * textsize, y + j * textsize, textsize, textsize, textcolor);
+        }
+    }
+}
+
+size_t Adafruit_SSD1306::write(uint8_t c)
+{
+    if (c == '\n')
+    {
+        cursor_x = 0;
+        cursor_y += textsize * 8;
+    }
+    else if (c != '\r')
+    {
+        if (wrap && cursor_x + textsize * 6 > WIDTH)
+        {
+            cursor_x = 0;
+            cursor_y += textsize * 8;
+        }
+        drawChar(cursor_x, cursor_y, c);
+        cursor_x += textsize * 6;
+    }
+    return 1;
+}
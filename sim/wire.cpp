@@ -0,0 +1,61 @@
+/**
+ * @file wire.cpp
+ * @brief Simulated I2C bus.
+ */
+#include "Wire.h"
+#include "sim.h"
+
+TwoWire Wire;
+
+namespace
+{
+    std::map<uint8_t, std::function<void(const uint8_t *, size_t)>> devices;
+}
+
+void Sim::attachI2c(uint8_t address, const std::function<void(const uint8_t *, size_t)> &receive)
+{
+    devices[address] = receive;
+}
+
+void TwoWire::setClock(uint32_t frequency)
+{
+    this->frequency = frequency;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    this->address = address;
+    length = 0;
+    transmitting = true;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+    if (!transmitting)
+        return 4;
+    transmitting = false;
+
+    // 9 clocks per byte including the address byte, plus start and stop
+    Sim::Clock::advance(((length + 1) * 9 + 2) * 1000000ULL / frequency);
+    auto found = devices.find(address);
+    if (found == devices.end())
+        return 2; // address not acknowledged
+    found->second(buffer, length);
+    return 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+    if (!transmitting || length >= sizeof(buffer))
+        return 0;
+    buffer[length++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t size)
+{
+    size_t written = 0;
+    while (written < size && write(data[written]))
+        written++;
+    return written;
+}
@@ -0,0 +1,129 @@
+#include "blockdevice.h"
+
+#ifdef ESP32
+
+PartitionBlockDevice::PartitionBlockDevice(const char *partitionLabel)
+{
+    label = partitionLabel;
+}
+
+bool PartitionBlockDevice::begin()
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == nullptr)
+    {
+        Serial.printf("Partition %s not found.", label);
+        Serial.println();
+        return false;
+    }
+    return true;
+}
+
+size_t PartitionBlockDevice::size()
+{
+    return partition != nullptr ? partition->size : 0;
+}
+
+size_t PartitionBlockDevice::sectorSize()
+{
+    return SPI_FLASH_SEC_SIZE;
+}
+
+bool PartitionBlockDevice::read(size_t offset, void *buffer, size_t length)
+{
+    return partition != nullptr && esp_partition_read(partition, offset, buffer, length) == ESP_OK;
+}
+
+bool PartitionBlockDevice::program(size_t offset, const void *buffer, size_t length)
+{
+    return partition != nullptr && esp_partition_write(partition, offset, buffer, length) == ESP_OK;
+}
+
+bool PartitionBlockDevice::erase(size_t offset)
+{
+    return partition != nullptr && esp_partition_erase_range(partition, offset, SPI_FLASH_SEC_SIZE) == ESP_OK;
+}
+
+#endif
+
+#ifdef ESP8266
+
+bool FlashBlockDevice::contains(size_t offset, size_t length)
+{
+    return offset <= size() && length <= size() - offset;
+}
+
+bool FlashBlockDevice::begin()
+{
+    if (size() < 2 * SPI_FLASH_SEC_SIZE)
+    {
+        Serial.printf("Flash layout without file system region (%u bytes).", (unsigned)size());
+        Serial.println();
+        return false;
+    }
+    return true;
+}
+
+size_t FlashBlockDevice::size()
+{
+    return FS_PHYS_SIZE;
+}
+
+size_t FlashBlockDevice::sectorSize()
+{
+    return SPI_FLASH_SEC_SIZE;
+}
+
+bool FlashBlockDevice::read(size_t offset, void *buffer, size_t length)
+{
+    if (!contains(offset, length))
+        return false;
+    uint32_t words[BUFFER_WORDS];
+    uint8_t *bytes = (uint8_t *)buffer;
+    while (length > 0)
+    {
+        uint32_t address = FS_PHYS_ADDR + offset;
+        size_t skip = address % 4;
+        size_t chunk = length < sizeof(words) - skip ? length : sizeof(words) - skip;
+        size_t aligned = (skip + chunk + 3) & ~3u;
+        if (spi_flash_read(address - skip, words, aligned) != SPI_FLASH_RESULT_OK)
+            return false;
+        memcpy(bytes, (uint8_t *)words + skip, chunk);
+        bytes += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool FlashBlockDevice::program(size_t offset, const void *buffer, size_t length)
+{
+    if (!contains(offset, length))
+        return false;
+    uint32_t words[BUFFER_WORDS];
+    const uint8_t *bytes = (const uint8_t *)buffer;
+    while (length > 0)
+    {
+        uint32_t address = FS_PHYS_ADDR + offset;
+        size_t skip = address % 4;
+        size_t chunk = length < sizeof(words) - skip ? length : sizeof(words) - skip;
+        size_t aligned = (skip + chunk + 3) & ~3u;
+        memset(words, 0xFF, aligned);
+        memcpy((uint8_t *)words + skip, bytes, chunk);
+        if (spi_flash_write(address - skip, words, aligned) != SPI_FLASH_RESULT_OK)
+            return false;
+        bytes += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool FlashBlockDevice::erase(size_t offset)
+{
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || !contains(offset, SPI_FLASH_SEC_SIZE))
+        return false;
+    return spi_flash_erase_sector((FS_PHYS_ADDR + offset) / SPI_FLASH_SEC_SIZE) == SPI_FLASH_RESULT_OK;
+}
+
+#endif
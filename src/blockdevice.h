@@ -0,0 +1,130 @@
+/**
+ * @file blockdevice.h
+ * @brief Abstraction of a NOR flash region for the journal.
+ *
+ * The interface follows the NOR flash rules: erase() sets a whole sector to 0xFF, program() can only clear bits.
+ * On the ESP32 it is backed by a data partition, on the ESP8266 by the flash region reserved for the file system, so the
+ * journal doesn't need a file system.
+ */
+#ifndef BLOCKDEVICE_H
+#define BLOCKDEVICE_H
+
+#include <Arduino.h>
+
+#ifdef ESP32
+#include <esp_partition.h>
+#endif
+#ifdef ESP8266
+#include <flash_hal.h>
+extern "C"
+{
+#include <spi_flash.h>
+}
+#endif
+
+/**
+ * @brief Interface of a flash region with sector erase and bitwise programming.
+ */
+class BlockDevice
+{
+public:
+    virtual ~BlockDevice() {}
+
+    /**
+     * @brief Opens the device.
+     * @return True if the device is usable, false otherwise.
+     */
+    virtual bool begin() = 0;
+
+    /**
+     * @brief Returns the size of the device in bytes, a multiple of the sector size.
+     */
+    virtual size_t size() = 0;
+
+    /**
+     * @brief Returns the size of an erasable sector in bytes.
+     */
+    virtual size_t sectorSize() = 0;
+
+    /**
+     * @brief Reads bytes from the device.
+     * @param offset Offset in bytes.
+     * @param buffer Buffer to read into.
+     * @param length Number of bytes.
+     * @return True if successful, false otherwise.
+     */
+    virtual bool read(size_t offset, void *buffer, size_t length) = 0;
+
+    /**
+     * @brief Programs bytes, only bits that are 1 can be cleared.
+     * @param offset Offset in bytes.
+     * @param buffer Bytes to program.
+     * @param length Number of bytes.
+     * @return True if successful, false otherwise.
+     */
+    virtual bool program(size_t offset, const void *buffer, size_t length) = 0;
+
+    /**
+     * @brief Erases a sector, all its bytes read 0xFF afterwards.
+     * @param offset Offset of the sector in bytes, aligned to the sector size.
+     * @return True if successful, false otherwise.
+     */
+    virtual bool erase(size_t offset) = 0;
+};
+
+#ifdef ESP32
+/**
+ * @brief BlockDevice on an ESP32 data partition, e.g. the otherwise unused "spiffs" partition.
+ */
+class PartitionBlockDevice : public BlockDevice
+{
+private:
+    const char *label;                        // Label of the partition.
+    const esp_partition_t *partition = nullptr; // The partition, set by begin().
+
+public:
+    /**
+     * @brief Constructor for the PartitionBlockDevice class.
+     * @param label Label of the data partition in the partition table.
+     */
+    PartitionBlockDevice(const char *label);
+
+    bool begin() override;
+    size_t size() override;
+    size_t sectorSize() override;
+    bool read(size_t offset, void *buffer, size_t length) override;
+    bool program(size_t offset, const void *buffer, size_t length) override;
+    bool erase(size_t offset) override;
+};
+#endif
+
+#ifdef ESP8266
+/**
+ * @brief BlockDevice on the ESP8266 flash between FS_PHYS_ADDR and FS_PHYS_ADDR + FS_PHYS_SIZE, the region the linker
+ *        script reserves for LittleFS or SPIFFS. The board needs a flash layout with a file system region, e.g.
+ *        board_build.ldscript = eagle.flash.4m1m.ld.
+ *
+ * The SDK reads and writes whole aligned words, unaligned transfers go through a word buffer. Bytes of a word that
+ * aren't programmed are written as 0xFF, which leaves them unchanged on NOR flash.
+ */
+class FlashBlockDevice : public BlockDevice
+{
+private:
+    static const size_t BUFFER_WORDS = 16; // Words of the transfer buffer on the stack.
+
+    /**
+     * @brief Checks that a transfer lies inside the region.
+     */
+    bool contains(size_t offset, size_t length);
+
+public:
+    bool begin() override;
+    size_t size() override;
+    size_t sectorSize() override;
+    bool read(size_t offset, void *buffer, size_t length) override;
+    bool program(size_t offset, const void *buffer, size_t length) override;
+    bool erase(size_t offset) override;
+};
+#endif
+
+#endif
@@ -0,0 +1,128 @@
+#include "command.h"
+
+CommandDecoder::CommandDecoder(const char *key)
+{
+    actionKey = key;
+    filter[actionKey] = true;
+    memset(table, -1, sizeof(table));
+}
+
+bool CommandDecoder::on(const char *action, commandHandler handler)
+{
+    Action *existing = find(action);
+    if (existing != nullptr)
+    {
+        existing->handler = handler;
+        return true;
+    }
+    if (actionCount >= COMMAND_MAX_ACTIONS)
+    {
+        Serial.println("Too many command actions.");
+        return false;
+    }
+
+    actions[actionCount].name = action;
+    actions[actionCount].handler = handler;
+    actionCount++;
+    if (!buildTable())
+    {
+        // the previous table is still collision free
+        actionCount--;
+        buildTable();
+        Serial.printf("No perfect hash for action %s.", action);
+        Serial.println();
+        return false;
+    }
+    return true;
+}
+
+bool CommandDecoder::keep(const char *key)
+{
+    if (keyCount >= COMMAND_MAX_KEYS)
+    {
+        Serial.println("Too many command keys.");
+        return false;
+    }
+    filter[key] = true;
+    keyCount++;
+    return true;
+}
+
+CommandDecoder::Result CommandDecoder::dispatch(byte *payload, unsigned int length)
+{
+    // payloads that can't be a command object are rejected before the parser runs
+    unsigned int start = 0;
+    while (start < length && isspace(payload[start]))
+        start++;
+    if (length > COMMAND_MAX_SIZE || start == length || payload[start] != '{')
+    {
+        Serial.printf("Command of %u bytes rejected.", length);
+        Serial.println();
+        return Result::Rejected;
+    }
+
+    // a char pointer makes ArduinoJson parse in place, the strings of the document point into the payload
+    StaticJsonDocument<COMMAND_DOCUMENT_SIZE> doc;
+    DeserializationError error = deserializeJson(doc, (char *)payload, length, DeserializationOption::Filter(filter), DeserializationOption::NestingLimit(COMMAND_MAX_NESTING));
+    if (error)
+    {
+        Serial.printf("Command rejected: %s", error.c_str());
+        Serial.println();
+        return Result::Rejected;
+    }
+
+    const char *action = doc[actionKey];
+    const Action *match = action != nullptr ? find(action) : nullptr;
+    if (match == nullptr)
+    {
+        Serial.printf("Unknown command action %s.", action != nullptr ? action : "");
+        Serial.println();
+        return Result::Unknown;
+    }
+
+    match->handler(doc.as<JsonObject>());
+    return Result::Dispatched;
+}
+
+bool CommandDecoder::buildTable()
+{
+    for (uint16_t candidate = 0; candidate <= 0xFF; candidate++)
+    {
+        memset(table, -1, sizeof(table));
+        uint8_t placed = 0;
+        for (; placed < actionCount; placed++)
+        {
+            uint8_t slot = hash(actions[placed].name, candidate);
+            if (table[slot] != -1)
+                break;
+            table[slot] = placed;
+        }
+        if (placed == actionCount)
+        {
+            seed = candidate;
+            return true;
+        }
+    }
+    memset(table, -1, sizeof(table));
+    return false;
+}
+
+CommandDecoder::Action *CommandDecoder::find(const char *action)
+{
+    int8_t index = table[hash(action, seed)];
+    if (index < 0 || strcmp(actions[index].name, action) != 0)
+        return nullptr;
+    return &actions[index];
+}
+
+uint8_t CommandDecoder::hash(const char *action, uint8_t seed)
+{
+    // FNV-1a, the seed is folded into the offset basis
+    uint32_t value = 2166136261UL ^ seed;
+    for (const char *c = action; *c != '\0'; c++)
+    {
+        value ^= (uint8_t)*c;
+        value *= 16777619UL;
+    }
+    return value & (COMMAND_TABLE_SIZE - 1);
+}
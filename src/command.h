@@ -0,0 +1,203 @@
+/**
+ * @file command.h
+ * @brief Decoder and dispatcher for the JSON commands received via MQTT.
+ *
+ * The payload is parsed in place, so strings of the document point into the payload and are only valid during the
+ * handler call. A filter built from the registered keys drops everything else before it takes space in the document.
+ * Actions are looked up in a perfect hash table: its seed is searched whenever a handler is registered, so a lookup is
+ * one hash and one strcmp.
+ */
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * @brief Maximum size of a command payload in bytes, larger payloads are rejected unparsed.
+ */
+#define COMMAND_MAX_SIZE 512
+
+/**
+ * @brief Capacity of the command document in bytes, only the values take space as strings aren't copied.
+ */
+#define COMMAND_DOCUMENT_SIZE 768
+
+/**
+ * @brief Maximum nesting depth of a command.
+ */
+#define COMMAND_MAX_NESTING 4
+
+/**
+ * @brief Maximum number of registered actions.
+ */
+#define COMMAND_MAX_ACTIONS 8
+
+/**
+ * @brief Size of the action hash table, a power of two of at least twice COMMAND_MAX_ACTIONS.
+ */
+#define COMMAND_TABLE_SIZE 16
+
+/**
+ * @brief Maximum number of top level keys kept by the filter, besides the action key.
+ */
+#define COMMAND_MAX_KEYS 12
+
+/**
+ * @brief Size of a correlation id including the terminator, longer ids are truncated.
+ */
+#define COMMAND_ID_SIZE 37
+
+/**
+ * @brief Callback function type for handling a command.
+ *
+ * @param command The command, its strings point into the MQTT payload.
+ */
+typedef void (*commandHandler)(JsonObject command);
+
+/**
+ * @brief Class for decoding commands and dispatching them to the handler of their action.
+ */
+class CommandDecoder
+{
+public:
+    /**
+     * @brief Result of decoding a command.
+     */
+    enum Result
+    {
+        Dispatched, // the handler of the action was called
+        Rejected,   // oversize or malformed payload
+        Unknown     // no handler for the action
+    };
+
+    /**
+     * @brief Constructor for the CommandDecoder class.
+     * @param actionKey Key of the action in the command object.
+     */
+    CommandDecoder(const char *actionKey);
+
+    /**
+     * @brief Registers the handler of an action.
+     * @param action Name of the action, must outlive the decoder.
+     * @param handler Callback function for the action.
+     * @return True if registered, false if the table is full.
+     */
+    bool on(const char *action, commandHandler handler);
+
+    /**
+     * @brief Keeps a top level key and everything below it in the parsed command, all other keys are dropped.
+     * @param key The key, must outlive the decoder.
+     * @return True if added, false if too many keys are kept.
+     */
+    bool keep(const char *key);
+
+    /**
+     * @brief Parses a payload in place and calls the handler of its action.
+     * @param payload The payload, it is modified by the parser.
+     * @param length The length of the payload.
+     * @return The result of decoding.
+     */
+    Result dispatch(byte *payload, unsigned int length);
+
+private:
+    /**
+     * @brief Registered action.
+     */
+    struct Action
+    {
+        const char *name;
+        commandHandler handler;
+    };
+
+    const char *actionKey;                  // Key of the action in the command object.
+    Action actions[COMMAND_MAX_ACTIONS];    // Registered actions.
+    uint8_t actionCount = 0;                // Number of registered actions.
+    int8_t table[COMMAND_TABLE_SIZE];       // Index into actions per hash, -1 if empty.
+    uint8_t seed = 0;                       // Seed of the perfect hash.
+    uint8_t keyCount = 0;                   // Number of kept keys.
+    StaticJsonDocument<JSON_OBJECT_SIZE(COMMAND_MAX_KEYS + 1)> filter; // Filter of the kept keys.
+
+    /**
+     * @brief Searches a seed that maps all registered actions to different slots and fills the table.
+     * @return True if a seed was found, false otherwise.
+     */
+    bool buildTable();
+
+    /**
+     * @brief Returns the first registered action that is named like the given one, nullptr if there is none.
+     */
+    Action *find(const char *action);
+
+    /**
+     * @brief Hashes an action name into a table slot.
+     * @param action The name.
+     * @param seed The seed of the hash.
+     */
+    static uint8_t hash(const char *action, uint8_t seed);
+};
+
+/**
+ * @brief Fixed-size FIFO of decoded commands between the MQTT callback and the main loop.
+ *
+ * Both sides run on the loop task, so unlike SpscQueue the newest item may be changed in place to coalesce a
+ * duplicate command with it. Older items are never touched, which keeps the order of the commands.
+ * @tparam T The item type, copied in and out of the queue.
+ * @tparam N The number of items.
+ */
+template <typename T, size_t N>
+class CommandQueue
+{
+public:
+    /**
+     * @brief Adds an item.
+     * @param item The item to add.
+     * @return True if the item was added, false if the queue is full.
+     */
+    bool push(const T &item)
+    {
+        if (count == N)
+            return false;
+        items[(first + count) % N] = item;
+        count++;
+        return true;
+    }
+
+    /**
+     * @brief Takes the oldest item.
+     * @param item The variable to store the item in.
+     * @return True if an item was taken, false if the queue is empty.
+     */
+    bool pop(T &item)
+    {
+        if (count == 0)
+            return false;
+        item = items[first];
+        first = (first + 1) % N;
+        count--;
+        return true;
+    }
+
+    /**
+     * @brief Returns the newest item, nullptr if the queue is empty. Valid until the next push() or pop().
+     */
+    T *back()
+    {
+        return count > 0 ? &items[(first + count - 1) % N] : nullptr;
+    }
+
+    /**
+     * @brief Returns the number of queued items.
+     */
+    size_t size() const
+    {
+        return count;
+    }
+
+private:
+    T items[N];       // Item slots.
+    size_t first = 0; // Slot of the oldest item.
+    size_t count = 0; // Number of queued items.
+};
+
+#endif
@@ -46,6 +46,23 @@ static const char *ACTION_CONFIGURE = "configure";
 static const char *ACTION_TEST = "test";
 static const char *ACTION_WRITETAG = "write-tag";
 
+// status publish modes
+static const char *STATUS_MODE_CHANGE = "change";
+static const char *STATUS_MODE_SETTLED = "settled";
+static const char *STATUS_MODE_BATCH = "batch";
+static const unsigned int STATUS_BATCH_MAX = 20; // samples per batch message, bounds the RAM of the pending batch
+
+// commands
+static const unsigned int COMMAND_QUEUE_SIZE = 8; // commands waiting for the running flow to finish
+static const char *RESULT_COALESCED = "coalesced";               // merged into the next command of the same action
+static const char *RESULT_QUEUE_FULL = "queue-full";             // dropped, the command queue was full
+static const char *RESULT_TAG_MISSING = "tag-missing";           // write-tag without a tag object
+static const char *RESULT_INVALID_SPOOL_ID = "invalid-spool-id"; // write-tag without a valid spool id
+
+// payload formats
+static const char *PAYLOAD_FORMAT_JSON = "json";
+static const char *PAYLOAD_FORMAT_MSGPACK = "msgpack"; // also the topic suffix of MessagePack payloads
+
 
 
 #endif
\ No newline at end of file
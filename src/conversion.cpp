@@ -1,47 +1,96 @@
 #include "conversion.h"
 
-void Conversion::dumpByteArray(byte *buffer, byte bufferSize)
+namespace
 {
-    for (byte i = 0; i < bufferSize; i++)
+    /**
+     * @brief Value of a hexadecimal digit, -1 for any other character.
+     */
+    constexpr int8_t hexNibble(unsigned char c)
     {
-        Serial.print(buffer[i] < 0x10 ? " 0" : " ");
-        Serial.print(buffer[i], HEX);
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
     }
+
+#define HEX_ROW(n) hexNibble(n), hexNibble(n + 1), hexNibble(n + 2), hexNibble(n + 3), hexNibble(n + 4), hexNibble(n + 5), hexNibble(n + 6), hexNibble(n + 7), \
+                   hexNibble(n + 8), hexNibble(n + 9), hexNibble(n + 10), hexNibble(n + 11), hexNibble(n + 12), hexNibble(n + 13), hexNibble(n + 14), hexNibble(n + 15)
+
+    // decoding table indexed by the character, built at compile time
+    constexpr int8_t HEX_DECODE[256] = {
+        HEX_ROW(0x00), HEX_ROW(0x10), HEX_ROW(0x20), HEX_ROW(0x30), HEX_ROW(0x40), HEX_ROW(0x50), HEX_ROW(0x60), HEX_ROW(0x70),
+        HEX_ROW(0x80), HEX_ROW(0x90), HEX_ROW(0xA0), HEX_ROW(0xB0), HEX_ROW(0xC0), HEX_ROW(0xD0), HEX_ROW(0xE0), HEX_ROW(0xF0)};
+
+#undef HEX_ROW
+
+    static_assert(HEX_DECODE['0'] == 0 && HEX_DECODE['9'] == 9 && HEX_DECODE['a'] == 10 && HEX_DECODE['F'] == 15, "broken hex table");
+    static_assert(HEX_DECODE['g'] == -1 && HEX_DECODE['-'] == -1 && HEX_DECODE[0] == -1, "broken hex table");
+
+    constexpr char HEX_ENCODE[] = "0123456789abcdef";
 }
 
-void Conversion::uuidToByte(String &uuid, byte *block) {
-    // Remove the hyphens
-    uuid.replace("-", "");
-    
-    // Ensure the UUID is the correct length
-    if (uuid.length() != 32) {
-        Serial.println("Invalid UUID length");
-        return;
+bool Conversion::hexToBytes(const char *hex, size_t length, byte *bytes)
+{
+    if (length % 2 != 0)
+        return false;
+
+    // validate first, so the output stays untouched on failure
+    for (size_t i = 0; i < length; i++)
+    {
+        if (HEX_DECODE[(unsigned char)hex[i]] < 0)
+            return false;
     }
-    
-    // Convert each pair of hexadecimal digits to a byte
-    for (int i = 0; i < 16; i++) {
-        String hexPair = uuid.substring(i * 2, (i * 2) + 2);
-        block[i] = (byte) strtol(hexPair.c_str(), NULL, 16);
+    for (size_t i = 0; i < length; i += 2)
+        bytes[i / 2] = (HEX_DECODE[(unsigned char)hex[i]] << 4) | HEX_DECODE[(unsigned char)hex[i + 1]];
+    return true;
+}
+
+void Conversion::bytesToHex(const byte *bytes, size_t size, char *hex)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        *hex++ = HEX_ENCODE[bytes[i] >> 4];
+        *hex++ = HEX_ENCODE[bytes[i] & 0x0F];
     }
 }
 
+void Conversion::dumpByteArray(byte *buffer, byte bufferSize)
+{
+    for (byte i = 0; i < bufferSize; i++)
+    {
+        Serial.print(buffer[i] < 0x10 ? " 0" : " ");
+        Serial.print(buffer[i], HEX);
+    }
+}
 
+void Conversion::uuidToByte(const String &uuid, byte *block) {
+    uuidToByte(uuid.c_str(), block);
+}
 
-void Conversion::uuidToByte(char *uuid, byte *block) {
-    // Remove the hyphens
-    for (int i = 0, j = 0; i < 36; ++i) {
-        if (uuid[i] != '-') {
-            uuid[j++] = uuid[i];
-        }
+void Conversion::uuidToByte(const char *uuid, byte *block) {
+    if (!parseUuid(uuid, block)) {
+        Serial.println("Invalid UUID");
     }
-    uuid[32] = '\0'; // Null-terminate the string after removing hyphens
-    
-    // Convert each pair of hexadecimal digits to a byte
-    for (int i = 0; i < 16; i++) {
-        char hexPair[3] = {uuid[i * 2], uuid[(i * 2) + 1], '\0'};
-        block[i] = (byte) strtol(hexPair, NULL, 16);
+}
+
+bool Conversion::parseUuid(const char *uuid, byte *block) {
+    byte value[16];
+    size_t length = strlen(uuid);
+    if (length == 32) {
+        if (!hexToBytes(uuid, 32, value))
+            return false;
+    } else if (length == 36) {
+        // groups of 4-2-2-2-6 bytes, separated by hyphens
+        if (uuid[8] != '-' || uuid[13] != '-' || uuid[18] != '-' || uuid[23] != '-')
+            return false;
+        if (!hexToBytes(uuid, 8, value) ||
+            !hexToBytes(uuid + 9, 4, value + 4) ||
+            !hexToBytes(uuid + 14, 4, value + 6) ||
+            !hexToBytes(uuid + 19, 4, value + 8) ||
+            !hexToBytes(uuid + 24, 12, value + 10))
+            return false;
+    } else {
+        return false;
     }
+    memcpy(block, value, sizeof(value));
+    return true;
 }
 
 void Conversion::splitToByteArrays(String &input, byte *block1, byte *block2, byte *block3) {
@@ -73,33 +122,19 @@ void Conversion::splitToByteArrays(String &input, byte *block1, byte *block2, by
     }
 }
 
-void Conversion::splitToByteArrays(char *input, byte *block1, byte *block2, byte *block3) {
+void Conversion::splitToByteArrays(const char *input, byte *block1, byte *block2, byte *block3) {
     // Ensure the input is not longer than 48 characters
-    if (strlen(input) > 48) {
+    size_t length = strlen(input);
+    if (length > 48) {
         Serial.println("Input length exceeds maximum limit and will be cut off at 48 characters");
     }
 
-    // Convert each pair of hexadecimal digits to a byte
-    for (int i = 0; i < 16; i++) {
-        if (i * 2 < strlen(input)) {
-            char hexPair[3] = {input[i * 2], input[(i * 2) + 1], '\0'};
-            block1[i] = (byte) strtol(hexPair, NULL, 16);
-        } else {
-            block1[i] = 0;
-        }
-
-        if ((i + 16) * 2 < strlen(input)) {
-            char hexPair[3] = {input[(i + 16) * 2], input[((i + 16) * 2) + 1], '\0'};
-            block2[i] = (byte) strtol(hexPair, NULL, 16);
-        } else {
-            block2[i] = 0;
-        }
-
-        if ((i + 32) * 2 < strlen(input)) {
-            char hexPair[3] = {input[(i + 32) * 2], input[((i + 32) * 2) + 1], '\0'};
-            block3[i] = (byte) strtol(hexPair, NULL, 16);
-        } else {
-            block3[i] = 0;
+    // Convert each pair of hexadecimal digits to a byte, invalid pairs and the remainder become zero
+    byte *blocks[3] = {block1, block2, block3};
+    for (int i = 0; i < 48; i++) {
+        byte *target = blocks[i / 16] + (i % 16);
+        if ((size_t)i * 2 + 1 >= length || !hexToBytes(input + i * 2, 2, target)) {
+            *target = 0;
         }
     }
 }
@@ -135,27 +170,22 @@ void Conversion::ulongToByte(unsigned long &longVal, byte *block)
 }
 
 String Conversion::byteToUuid(byte *block) {
-    String uuid = "";
-    for (int i = 0; i < 16; i++) {
-        if (i == 4 || i == 6 || i == 8 || i == 10) {
-            uuid += "-";
-        }
-        char hexPair[3];
-        sprintf(hexPair, "%02x", block[i]);
-        uuid += hexPair;
-    }
+    char uuid[UUID_STRING_SIZE];
+    byteToUuid(block, uuid);
     return uuid;
 }
 
 void Conversion::byteToUuid(byte *block, char *uuid) {
-    for (int i = 0; i < 16; i++) {
-        if (i == 4 || i == 6 || i == 8 || i == 10) {
-            strcat(uuid, "-");
-        }
-        char hexPair[3];
-        sprintf(hexPair, "%02x", block[i]);
-        strcat(uuid, hexPair);
-    }
+    bytesToHex(block, 4, uuid);
+    uuid[8] = '-';
+    bytesToHex(block + 4, 2, uuid + 9);
+    uuid[13] = '-';
+    bytesToHex(block + 6, 2, uuid + 14);
+    uuid[18] = '-';
+    bytesToHex(block + 8, 2, uuid + 19);
+    uuid[23] = '-';
+    bytesToHex(block + 10, 6, uuid + 24);
+    uuid[36] = '\0';
 }
 
 long Conversion::byteToLong(byte *byteVal)
@@ -191,23 +221,23 @@ String Conversion::byteArraysToString(byte *block1, byte *block2, byte *block3)
 }
 
 void Conversion::byteArraysToString(byte *block1, byte *block2, byte *block3, char *output) {
+    // appends to the output like strcat, but seeks the end only once
+    output += strlen(output);
     for (int i = 0; i < 16; i++) {
         if (block1[i] != 0) {
-            char hexPair[3];
-            sprintf(hexPair, "%02x", block1[i]);
-            strcat(output, hexPair);
+            bytesToHex(&block1[i], 1, output);
+            output += 2;
         }
         if (block2[i] != 0) {
-            char hexPair[3];
-            sprintf(hexPair, "%02x", block2[i]);
-            strcat(output, hexPair);
+            bytesToHex(&block2[i], 1, output);
+            output += 2;
         }
         if (block3[i] != 0) {
-            char hexPair[3];
-            sprintf(hexPair, "%02x", block3[i]);
-            strcat(output, hexPair);
+            bytesToHex(&block3[i], 1, output);
+            output += 2;
         }
     }
+    *output = '\0';
 }
 
 void Conversion::stringToByteArray(String input, byte *block) {
@@ -251,4 +281,66 @@ void Conversion::byteArrayToCharArray(byte *block, char *output) {
             break;
         }
     }
-}
\ No newline at end of file
+}
+
+void Conversion::packULong(uint32_t value, byte *bytes)
+{
+    bytes[0] = (value >> 24) & 0xFF;
+    bytes[1] = (value >> 16) & 0xFF;
+    bytes[2] = (value >> 8) & 0xFF;
+    bytes[3] = value & 0xFF;
+}
+
+uint32_t Conversion::unpackULong(const byte *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+uint32_t Conversion::crc32(const byte *data, size_t size, uint32_t crc)
+{
+    // bitwise variant, the tag records are too short to justify a 1 KB table
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+void Conversion::bytesToCharArray(const byte *bytes, size_t size, char *output, size_t outputSize)
+{
+    size_t i = 0;
+    for (; i < size && i + 1 < outputSize && bytes[i] != 0; i++)
+        output[i] = (char)bytes[i];
+    output[i] = '\0';
+}
+
+bool Conversion::isEmptyUuid(const byte *block)
+{
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        if (block[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+bool Conversion::colorToBytes(const char *color, byte *rgb)
+{
+    const char *hex = color;
+    if (hex[0] == '#')
+        hex++;
+    if (strlen(hex) != 6)
+        return false;
+
+    return hexToBytes(hex, 6, rgb);
+}
+
+void Conversion::bytesToColor(const byte *rgb, char *color)
+{
+    color[0] = '#';
+    bytesToHex(rgb, 3, color + 1);
+    color[7] = '\0';
+}
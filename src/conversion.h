@@ -8,6 +8,16 @@
 
 #include <Arduino.h>
 
+/**
+ * @brief Size of a formatted UUID including the terminating null character.
+ */
+#define UUID_STRING_SIZE 37
+
+/**
+ * @brief Size of a formatted "#rrggbb" color including the terminating null character.
+ */
+#define COLOR_STRING_SIZE 8
+
 /**
  * @brief A class containing static methods for converting between different data types.
  */
@@ -32,18 +42,46 @@ public:
     /**
      * @brief Converts a UUID string to a byte array.
      * 
-     * @param uuid The UUID string to convert.
-     * @param block The byte array to store the converted value in.
+     * @param uuid The UUID string to convert, it isn't modified.
+     * @param block The byte array to store the converted value in, left untouched if the UUID is invalid.
      */
-    static void uuidToByte(String &uuid, byte *block);
+    static void uuidToByte(const String &uuid, byte *block);
 
     /**
      * @brief Converts a UUID character array to a byte array.
      * 
-     * @param uuid The UUID character array to convert.
-     * @param block The byte array to store the converted value in.
+     * @param uuid The UUID character array to convert, it isn't modified.
+     * @param block The byte array to store the converted value in, left untouched if the UUID is invalid.
+     */
+    static void uuidToByte(const char *uuid, byte *block);
+
+    /**
+     * @brief Parses and validates a UUID, with ("xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx") or without hyphens.
+     * 
+     * @param uuid The UUID character array to parse, it isn't modified.
+     * @param block The byte array to store the 16 bytes in, left untouched if the UUID is invalid.
+     * @return True if the UUID was valid, false otherwise.
      */
-    static void uuidToByte(char *uuid, byte *block);
+    static bool parseUuid(const char *uuid, byte *block);
+
+    /**
+     * @brief Decodes a span of hexadecimal digits (upper or lower case) to bytes.
+     * 
+     * @param hex The hexadecimal digits, it isn't modified.
+     * @param length The number of digits, must be even.
+     * @param bytes The byte array to store length / 2 bytes in, left untouched if the digits are invalid.
+     * @return True if all digits were valid, false otherwise.
+     */
+    static bool hexToBytes(const char *hex, size_t length, byte *bytes);
+
+    /**
+     * @brief Encodes a span of bytes as lower case hexadecimal digits.
+     * 
+     * @param bytes The bytes to encode.
+     * @param size The number of bytes.
+     * @param hex The character array to store 2 * size digits in, not null terminated.
+     */
+    static void bytesToHex(const byte *bytes, size_t size, char *hex);
 
     /**
      * @brief Splits a string into three byte arrays.
@@ -63,7 +101,7 @@ public:
      * @param block2 The second byte array to store the split value in.
      * @param block3 The third byte array to store the split value in.
      */
-    static void splitToByteArrays(char *input, byte *block1, byte *block2, byte *block3);
+    static void splitToByteArrays(const char *input, byte *block1, byte *block2, byte *block3);
 
     /**
      * @brief Converts a byte array to a long value.
@@ -93,7 +131,7 @@ public:
      * @brief Converts a byte array to a UUID character array.
      * 
      * @param block The byte array to convert.
-     * @param uuid The character array to store the converted value in.
+     * @param uuid The character array to store the converted value in, at least UUID_STRING_SIZE characters.
      */
     static void byteToUuid(byte *block, char *uuid);
 
@@ -156,6 +194,69 @@ public:
      * @param output The character array to store the converted value in.
      */
     static void byteArrayToCharArray(byte *block, char *output);
+
+    /**
+     * @brief Stores an unsigned 32 bit value as 4 big endian bytes, without touching any other byte.
+     * 
+     * @param value The value to store.
+     * @param bytes The byte array to store the value in, at least 4 bytes.
+     */
+    static void packULong(uint32_t value, byte *bytes);
+
+    /**
+     * @brief Reads an unsigned 32 bit value from 4 big endian bytes.
+     * 
+     * @param bytes The byte array to read, at least 4 bytes.
+     * @return The unpacked value.
+     */
+    static uint32_t unpackULong(const byte *bytes);
+
+    /**
+     * @brief Calculates the CRC32 (IEEE 802.3, reflected polynomial 0xEDB88320) of a byte array.
+     * 
+     * Pass the result of a previous call as crc to continue the checksum over several arrays.
+     * 
+     * @param data The byte array to checksum.
+     * @param size The number of bytes.
+     * @param crc The CRC of the preceding data, 0 to start a new checksum.
+     * @return The CRC32 of all data so far.
+     */
+    static uint32_t crc32(const byte *data, size_t size, uint32_t crc = 0);
+
+    /**
+     * @brief Copies a null padded byte array to a character array, at most outputSize - 1 characters.
+     * 
+     * @param bytes The byte array to copy.
+     * @param size The size of the byte array.
+     * @param output The character array to store the string in, always null terminated.
+     * @param outputSize The size of the character array.
+     */
+    static void bytesToCharArray(const byte *bytes, size_t size, char *output, size_t outputSize);
+
+    /**
+     * @brief Checks if a binary UUID is unset (all zero).
+     * 
+     * @param block The 16 byte UUID.
+     * @return True if all bytes are zero, false otherwise.
+     */
+    static bool isEmptyUuid(const byte *block);
+
+    /**
+     * @brief Converts a "#rrggbb" color string to 3 raw bytes.
+     * 
+     * @param color The color string, the leading '#' is optional.
+     * @param rgb The byte array to store the red, green and blue bytes in.
+     * @return True if the string was a valid color, false otherwise. rgb is left untouched on failure.
+     */
+    static bool colorToBytes(const char *color, byte *rgb);
+
+    /**
+     * @brief Converts 3 raw bytes to a "#rrggbb" color string.
+     * 
+     * @param rgb The red, green and blue bytes.
+     * @param color The character array to store the color in, at least COLOR_STRING_SIZE characters.
+     */
+    static void bytesToColor(const byte *rgb, char *color);
 };
 
 #endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 
 #include "display.h"
+#include "glyphs.h"
 
 Display::Display(uint16_t displayWidth, uint16_t displayHeight, int8_t resetPin, unsigned long screenTimeOut)
 {
@@ -9,13 +10,135 @@ Display::Display(uint16_t displayWidth, uint16_t displayHeight, int8_t resetPin,
 
 void Display::clearDisplay()
 {
+    screen = Screen::Other;
     pDevice->clearDisplay();
-    pDevice->display();
+    present();
+}
+
+void Display::present()
+{
+    if (pendingFrame == nullptr)
+        return;
+
+    lock();
+    if (frameReady)
+        statistics.dropped++;
+    memcpy(pendingFrame, pDevice->getBuffer(), frameSize);
+    frameReady = true;
+    unlock();
+}
+
+bool Display::flushFrame()
+{
+    // only the pointers are swapped under the lock, the transfer runs without it
+    lock();
+    bool ready = frameReady;
+    if (ready)
+    {
+        uint8_t *frame = sendingFrame;
+        sendingFrame = pendingFrame;
+        pendingFrame = frame;
+        frameReady = false;
+    }
+    unlock();
+    if (!ready)
+        return false;
+
+    uint16_t width = pDevice->width();
+    uint8_t pages = frameSize / width;
+    Wire.setClock(DISPLAY_I2C_CLOCK);
+    for (uint8_t page = 0; page < pages; page++)
+    {
+        const uint8_t *row = sendingFrame + page * width;
+        uint8_t *shadowRow = shadow + page * width;
+
+        // changed columns close to each other are sent as one span, a new span costs more than the gap
+        int16_t first = -1;
+        int16_t last = -1;
+        for (uint16_t column = 0; column < width; column++)
+        {
+            if (row[column] == shadowRow[column])
+                continue;
+            if (first >= 0 && column - last > DISPLAY_SPAN_GAP)
+            {
+                sendSpan(row, page, first, last);
+                first = -1;
+            }
+            if (first < 0)
+                first = column;
+            last = column;
+        }
+        if (first >= 0)
+            sendSpan(row, page, first, last);
+        memcpy(shadowRow, row, width);
+    }
+    Wire.setClock(DISPLAY_I2C_RESTORE_CLOCK);
+    statistics.flushes++;
+    return true;
+}
+
+void Display::sendSpan(const uint8_t *row, uint8_t page, uint16_t first, uint16_t last)
+{
+    Wire.beginTransmission(DISPLAY_I2C_ADDRESS);
+    Wire.write((uint8_t)0x00); // control byte: command stream
+    Wire.write((uint8_t)SSD1306_COLUMNADDR);
+    Wire.write((uint8_t)first);
+    Wire.write((uint8_t)last);
+    Wire.write((uint8_t)SSD1306_PAGEADDR);
+    Wire.write(page);
+    Wire.write(page);
+    Wire.endTransmission();
+    statistics.bytes += 7;
+
+    for (uint16_t column = first; column <= last; column += DISPLAY_I2C_CHUNK)
+    {
+        uint16_t length = last + 1 - column < DISPLAY_I2C_CHUNK ? last + 1 - column : DISPLAY_I2C_CHUNK;
+        Wire.beginTransmission(DISPLAY_I2C_ADDRESS);
+        Wire.write((uint8_t)0x40); // control byte: data stream
+        Wire.write(row + column, length);
+        Wire.endTransmission();
+        statistics.bytes += length + 1;
+    }
+    statistics.spans++;
+}
+
+#ifdef DISPLAY_FLUSH_TASK
+void Display::flushTask(void *param)
+{
+    Display *self = (Display *)param;
+    for (;;)
+    {
+        self->flushFrame();
+        vTaskDelay(pdMS_TO_TICKS(self->flushInterval));
+    }
+}
+#endif
+
+void Display::lock()
+{
+#ifdef DISPLAY_FLUSH_TASK
+    if (frameMutex != nullptr)
+        xSemaphoreTake(frameMutex, portMAX_DELAY);
+#endif
+}
+
+void Display::unlock()
+{
+#ifdef DISPLAY_FLUSH_TASK
+    if (frameMutex != nullptr)
+        xSemaphoreGive(frameMutex);
+#endif
+}
+
+Display::Statistics Display::getStatistics()
+{
+    return statistics;
 }
 
 void Display::showInitMessage()
 {
     displayStandby = false;
+    screen = Screen::Other;
 
     pDevice->clearDisplay();
     pDevice->setTextColor(WHITE);
@@ -25,7 +148,7 @@ void Display::showInitMessage()
     pDevice->setTextSize(1);
     pDevice->setCursor(10, 30);
     pDevice->println(MESSAGE_INITIALIZE);
-    pDevice->display();
+    present();
 
     lastUpdate = millis();
 }
@@ -33,6 +156,7 @@ void Display::showInitMessage()
 void Display::showErrorMessage(Display::Error &error)
 {
     displayStandby = false;
+    screen = Screen::Other;
 
     pDevice->clearDisplay();
     pDevice->setTextColor(WHITE);
@@ -45,7 +169,7 @@ void Display::showErrorMessage(Display::Error &error)
     pDevice->print(error.module);    
     pDevice->setCursor(0, 35);    
     pDevice->println(error.msg);
-    pDevice->display();
+    present();
 
     lastUpdate = millis();
 }
@@ -53,13 +177,14 @@ void Display::showErrorMessage(Display::Error &error)
 void Display::showTitle(const char *title)
 {
     displayStandby = false;
+    screen = Screen::Other;
 
     pDevice->clearDisplay();
     pDevice->setTextColor(WHITE);
     pDevice->setTextSize(2);
     pDevice->setCursor(2, 28);
     pDevice->println(title);
-    pDevice->display();
+    present();
 
     lastUpdate = millis();
 }
@@ -67,18 +192,20 @@ void Display::showTitle(const char *title)
 void Display::showMessage(const char *msg)
 {
     displayStandby = false;
+    screen = Screen::Other;
     pDevice->clearDisplay();
     pDevice->setTextSize(1);
     pDevice->setTextColor(WHITE);
     pDevice->setCursor(0, 15);
     pDevice->println(msg);
-    pDevice->display();
+    present();
     lastUpdate = millis();
 }
 
 void Display::showCalibrationMessage(long calibration)
 {
     displayStandby = false;
+    screen = Screen::Other;
     
     pDevice->clearDisplay();
     // text
@@ -91,40 +218,237 @@ void Display::showCalibrationMessage(long calibration)
     pDevice->setTextSize(2);
     pDevice->setCursor(15, 38);
     pDevice->print(calibration);
-    pDevice->display();
+    present();
     lastUpdate = millis();
 }
 
 void Display::showMeasurement(Display::Data &data)
 {
-    displayStandby = false;
+    // title, unit and history stay on screen, a new value only redraws the value
+    if (screen != Screen::Measurement || displayStandby)
+    {
+        displayStandby = false;
+        screen = Screen::Measurement;
 
-    pDevice->clearDisplay();
-    // title
-    pDevice->setTextSize(1);
-    pDevice->setTextColor(WHITE);
-    pDevice->setCursor(10, 27);
-    pDevice->println(data.title);
-    // result & unit
-    pDevice->setTextSize(2);
-    pDevice->setCursor(10, 38);
-    pDevice->print(data.result);
-    pDevice->setCursor(100, 38);
-    pDevice->print(data.unit);
-    pDevice->display();
+        pDevice->clearDisplay();
+        // title
+        pDevice->setTextSize(1);
+        pDevice->setTextColor(WHITE);
+        pDevice->setCursor(10, 18);
+        pDevice->println(data.title);
+        // unit, from the atlas if it has all characters
+        if (!drawGlyphs(DISPLAY_UNIT_X, DISPLAY_VALUE_PAGE, data.unit, pDevice->width() - DISPLAY_UNIT_X))
+        {
+            pDevice->setTextSize(2);
+            pDevice->setCursor(DISPLAY_UNIT_X, DISPLAY_VALUE_PAGE * 8 + 4);
+            pDevice->print(data.unit);
+        }
+        drawHistory();
+    }
+    // result
+    drawValue(data.result);
+    present();
 
     lastUpdate = millis();
 }
 
+bool Display::drawGlyphs(int16_t x, uint8_t page, const char *text, int16_t width)
+{
+    uint8_t *buffer = pDevice->getBuffer();
+    uint16_t columns = pDevice->width();
+    if (buffer == nullptr || page + GLYPH_PAGES > (pDevice->height() + 7) / 8)
+        return false;
+
+    const uint8_t *glyphs[DISPLAY_VALUE_WIDTH / GLYPH_WIDTH + 1];
+    uint8_t count = 0;
+    for (const char *c = text; *c != '\0'; c++)
+    {
+        const char *found = strchr(GLYPH_CHARS, *c);
+        if (found == nullptr)
+            return false;
+        if (count < sizeof(glyphs) / sizeof(glyphs[0]))
+            glyphs[count++] = GLYPH_ATLAS[found - GLYPH_CHARS];
+    }
+
+    int16_t end = x + width < columns ? x + width : columns;
+    for (uint8_t i = 0; i < count && x < end; i++)
+    {
+        uint8_t length = end - x < GLYPH_WIDTH ? end - x : GLYPH_WIDTH;
+        for (uint8_t p = 0; p < GLYPH_PAGES; p++)
+            memcpy(buffer + (page + p) * columns + x, glyphs[i] + p * GLYPH_WIDTH, length);
+        x += GLYPH_WIDTH + GLYPH_SPACING;
+    }
+    return true;
+}
+
+void Display::drawValue(long value)
+{
+    uint8_t *buffer = pDevice->getBuffer();
+    if (buffer == nullptr)
+        return;
+
+    for (uint8_t p = 0; p < GLYPH_PAGES; p++)
+        memset(buffer + (DISPLAY_VALUE_PAGE + p) * pDevice->width() + DISPLAY_VALUE_X, 0, DISPLAY_VALUE_WIDTH);
+    char text[12];
+    snprintf(text, sizeof(text), "%ld", value);
+    drawGlyphs(DISPLAY_VALUE_X, DISPLAY_VALUE_PAGE, text, DISPLAY_VALUE_WIDTH);
+}
+
+void Display::drawHistory()
+{
+    uint8_t *buffer = pDevice->getBuffer();
+    if (history == nullptr || buffer == nullptr)
+        return;
+
+    for (uint8_t p = 0; p < DISPLAY_HISTORY_PAGES; p++)
+        memset(buffer + (DISPLAY_HISTORY_PAGE + p) * pDevice->width(), 0, pDevice->width());
+    if (history->count() == 0)
+        return;
+
+    // the range is only fitted here, a point outside of it redraws the whole plot
+    long low = history->point(history->newest());
+    long high = low;
+    for (size_t slot = 0; slot < HISTORY_SIZE; slot++)
+    {
+        if (!history->has(slot))
+            continue;
+        long value = history->point(slot);
+        low = value < low ? value : low;
+        high = value > high ? value : high;
+    }
+    if (high - low < DISPLAY_HISTORY_MIN_RANGE)
+    {
+        low -= (DISPLAY_HISTORY_MIN_RANGE - (high - low)) / 2;
+        high = low + DISPLAY_HISTORY_MIN_RANGE;
+    }
+    long margin = (high - low) / 8;
+    historyLow = low - margin;
+    historyHigh = high + margin;
+
+    for (size_t slot = 0; slot < HISTORY_SIZE; slot++)
+        drawHistoryColumn(slot);
+    clearHistoryCursor();
+}
+
+void Display::drawHistoryColumn(size_t slot)
+{
+    uint8_t *buffer = pDevice->getBuffer();
+    uint16_t columns = pDevice->width();
+    if (buffer == nullptr || slot >= columns)
+        return;
+
+    uint32_t mask = 0;
+    if (history->has(slot))
+    {
+        uint8_t from = historyRow(history->point(slot));
+        uint8_t to = from;
+        size_t previous = (slot + HISTORY_SIZE - 1) % HISTORY_SIZE;
+        if (history->has(previous))
+        {
+            uint8_t row = historyRow(history->point(previous));
+            from = row < from ? row : from;
+            to = row > to ? row : to;
+        }
+        mask = ((2UL << to) - 1) & ~((1UL << from) - 1);
+    }
+    for (uint8_t p = 0; p < DISPLAY_HISTORY_PAGES; p++)
+        buffer[(DISPLAY_HISTORY_PAGE + p) * columns + slot] = mask >> (8 * p);
+}
+
+void Display::clearHistoryCursor()
+{
+    uint8_t *buffer = pDevice->getBuffer();
+    uint16_t columns = pDevice->width();
+    size_t slot = (history->newest() + 1) % HISTORY_SIZE;
+    if (buffer == nullptr || slot >= columns)
+        return;
+
+    for (uint8_t p = 0; p < DISPLAY_HISTORY_PAGES; p++)
+        buffer[(DISPLAY_HISTORY_PAGE + p) * columns + slot] = 0;
+}
+
+uint8_t Display::historyRow(long value)
+{
+    const long rows = DISPLAY_HISTORY_PAGES * 8;
+    if (value >= historyHigh)
+        return 0;
+    if (value <= historyLow)
+        return rows - 1;
+    return (long long)(historyHigh - value) * (rows - 1) / (historyHigh - historyLow);
+}
+
+void Display::setHistory(const History *history)
+{
+    this->history = history;
+}
+
+void Display::updateHistory()
+{
+    if (history == nullptr || history->count() == 0 || screen != Screen::Measurement || displayStandby)
+        return;
+
+    long value = history->point(history->newest());
+    if (value < historyLow || value > historyHigh)
+    {
+        drawHistory();
+    }
+    else
+    {
+        drawHistoryColumn(history->newest());
+        clearHistoryCursor();
+    }
+    present();
+}
+
+void Display::benchmarkValue(long value, uint16_t runs)
+{
+    unsigned long start = micros();
+    for (uint16_t i = 0; i < runs; i++)
+        drawValue(value);
+    unsigned long atlas = micros() - start;
+
+    start = micros();
+    for (uint16_t i = 0; i < runs; i++)
+    {
+        pDevice->fillRect(DISPLAY_VALUE_X, DISPLAY_VALUE_PAGE * 8, DISPLAY_VALUE_WIDTH, GLYPH_PAGES * 8, BLACK);
+        pDevice->setTextSize(2);
+        pDevice->setTextColor(WHITE);
+        pDevice->setCursor(DISPLAY_VALUE_X, DISPLAY_VALUE_PAGE * 8);
+        pDevice->print(value);
+    }
+    unsigned long gfx = micros() - start;
+
+    Serial.printf("display value: atlas %lu us, gfx text %lu us per draw", atlas / runs, gfx / runs);
+    Serial.println();
+    screen = Screen::Other;
+}
+
 void Display::setScreenTimeOut(unsigned long screenTimeOut) {
     timeout = screenTimeOut;
 }
 
+void Display::setFlushInterval(unsigned long interval) {
+    flushInterval = interval;
+}
+
 
 bool Display::init()
 {
-    bool result = pDevice->begin(SSD1306_SWITCHCAPVCC, 0x3C);
+    bool result = pDevice->begin(SSD1306_SWITCHCAPVCC, DISPLAY_I2C_ADDRESS);
     if(result){
+        // the panel content is unknown after power up, it is cleared once with a full update
+        pDevice->clearDisplay();
+        pDevice->display();
+        frameSize = pDevice->width() * ((pDevice->height() + 7) / 8);
+        shadow = new uint8_t[frameSize];
+        memcpy(shadow, pDevice->getBuffer(), frameSize);
+        sendingFrame = new uint8_t[frameSize];
+        pendingFrame = new uint8_t[frameSize];
+#ifdef DISPLAY_FLUSH_TASK
+        frameMutex = xSemaphoreCreateMutex();
+        if (xTaskCreatePinnedToCore(flushTask, "display", DISPLAY_TASK_STACK_SIZE, this, DISPLAY_TASK_PRIORITY, &flushTaskHandle, DISPLAY_TASK_CORE) != pdPASS)
+            Serial.println(F("Failed to start the display task, flushing from the loop."));
+#endif
         Serial.println(F("SSD1306 init succeeded"));
     } else {
         Serial.println(F("SSD1306 allocation failed"));
@@ -137,6 +461,14 @@ void Display::loop()
 {
     unsigned long current = millis();
 
+#ifdef DISPLAY_FLUSH_TASK
+    bool flushInLoop = flushTaskHandle == nullptr;
+#else
+    bool flushInLoop = true;
+#endif
+    if (flushInLoop && current - lastFlush >= flushInterval && flushFrame())
+        lastFlush = current;
+
     if ((current - lastUpdate >= timeout) && !displayStandby)
     {
         clearDisplay();
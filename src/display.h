@@ -2,17 +2,140 @@
 #define DISPLAY_H
 
 #include "constants.h"
+#include "history.h"
 #include <Arduino.h>
 #include <Adafruit_SSD1306.h>
 
+#ifdef DISPLAY_FLUSH_TASK
+#ifndef ESP32
+#error "DISPLAY_FLUSH_TASK requires FreeRTOS on the ESP32"
+#endif
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#ifndef DISPLAY_TASK_CORE
+#define DISPLAY_TASK_CORE 0 // Core the flush task is pinned to, the Arduino loop runs on core 1.
+#endif
+#ifndef DISPLAY_TASK_PRIORITY
+#define DISPLAY_TASK_PRIORITY 1 // Priority of the flush task, below the sampling task.
+#endif
+#ifndef DISPLAY_TASK_STACK_SIZE
+#define DISPLAY_TASK_STACK_SIZE 4096 // Stack size of the flush task in bytes.
+#endif
+#endif
+
+/**
+ * @brief I2C address of the display.
+ */
+#define DISPLAY_I2C_ADDRESS 0x3C
+
+/**
+ * @brief I2C clock while the display is updated, the clock is restored to DISPLAY_I2C_RESTORE_CLOCK afterwards.
+ */
+#define DISPLAY_I2C_CLOCK 400000UL
+#define DISPLAY_I2C_RESTORE_CLOCK 100000UL
+
+/**
+ * @brief Maximum number of data bytes in one I2C transmission, one byte of the Wire buffer is taken by the control byte.
+ */
+#if defined(I2C_BUFFER_LENGTH)
+#define DISPLAY_I2C_CHUNK (I2C_BUFFER_LENGTH - 1)
+#else
+#define DISPLAY_I2C_CHUNK 31
+#endif
+
+/**
+ * @brief Unchanged columns between two changed spans of a page up to which both are sent as one span.
+ * Sending a new span costs a command transmission of 8 bytes.
+ */
+#define DISPLAY_SPAN_GAP 8
+
+/**
+ * @brief Position of the weight readout, the value is drawn with the glyph atlas into whole pages.
+ */
+#define DISPLAY_VALUE_X 10
+#define DISPLAY_VALUE_PAGE 4
+#define DISPLAY_VALUE_WIDTH 90
+#define DISPLAY_UNIT_X 100
+
+/**
+ * @brief Pages of the weight history sparkline above the title.
+ */
+#define DISPLAY_HISTORY_PAGE 0
+#define DISPLAY_HISTORY_PAGES 2
+
+/**
+ * @brief Smallest weight range in grams spanned by the sparkline, so the noise of a constant weight stays flat.
+ */
+#define DISPLAY_HISTORY_MIN_RANGE 16
+
 /**
  * @brief The Display class provides an interface for controlling an SSD1306 OLED display.
- * 
+ *
+ * The screens are drawn into the framebuffer of Adafruit_SSD1306, the back buffer. present() copies a finished
+ * screen into the pending frame, replacing a frame that wasn't sent yet, so the latest screen always wins. At most
+ * once per flush interval the flusher takes the pending frame and sends only the columns of each page that differ
+ * from a shadow copy of the panel content, using column and page addressing. A new weight therefore only transfers
+ * the changed digits instead of the whole 1 KB framebuffer.
+ *
+ * The weight is drawn with a pre-rasterized glyph atlas (glyphs.h) that is already in the page format of the
+ * framebuffer, so a digit is copied column by column instead of being scaled from the GFX font pixel by pixel.
+ *
+ * Above it a sparkline shows the weight history. Each point of the history ring owns one column, so a new point
+ * only redraws its column and blanks the next one as a sweep cursor. The plot is only redrawn completely when the
+ * screen is entered or a point leaves the plotted weight range.
+ *
+ * Built with DISPLAY_FLUSH_TASK (ESP32 only), the flusher runs in its own FreeRTOS task and the loop never waits on
+ * I2C. Otherwise loop() flushes cooperatively.
  */
 class Display
 {
+public:
+    /**
+     * @brief Struct for reporting the I2C traffic of the display updates.
+     */
+    struct Statistics
+    {
+        unsigned long flushes; // Display updates.
+        unsigned long bytes;   // Bytes sent, without the I2C address bytes.
+        unsigned long spans;   // Column spans sent.
+        unsigned long dropped; // Frames replaced by a newer one before they were sent.
+    };
+
 private:
+    /**
+     * @brief Screen shown on the display, a measurement update only redraws the value if it's already shown.
+     */
+    enum Screen
+    {
+        Other,
+        Measurement
+    };
+
     Adafruit_SSD1306 *pDevice; /**< Pointer to the Adafruit_SSD1306 object used to control the display. */
+    uint8_t *shadow = nullptr; /**< Copy of the panel content, nullptr until init() succeeded. */
+    uint8_t *pendingFrame = nullptr; /**< Latest presented frame, waiting for the flusher. */
+    uint8_t *sendingFrame = nullptr; /**< Frame being sent by the flusher, swapped with pendingFrame. */
+    size_t frameSize = 0; /**< Size of a frame in bytes. */
+    volatile bool frameReady = false; /**< Flag indicating whether pendingFrame holds a frame that wasn't sent yet. */
+    unsigned long flushInterval = 100; /**< Minimum time in milliseconds between two flushes. */
+    unsigned long lastFlush = 0; /**< The time in milliseconds of the last flush. */
+    Screen screen = Screen::Other; /**< Screen drawn in the framebuffer. */
+    Statistics statistics = {0, 0, 0, 0}; /**< I2C traffic counters. */
+    const History *history = nullptr; /**< Weight history of the sparkline, nullptr if none is shown. */
+    long historyLow = 1; /**< Weight at the bottom row of the sparkline, above historyHigh until the range is set. */
+    long historyHigh = 0; /**< Weight at the top row of the sparkline. */
+#ifdef DISPLAY_FLUSH_TASK
+    TaskHandle_t flushTaskHandle = nullptr; /**< Handle of the flush task. */
+    SemaphoreHandle_t frameMutex = nullptr; /**< Guards pendingFrame and frameReady shared with the flush task. */
+
+    /**
+     * @brief Flush task, sends the pending frame once per flush interval.
+     * @param param The Display instance.
+     */
+    static void flushTask(void *param);
+#endif
     unsigned long timeout = 30000; /**< The time in milliseconds before the display goes into standby mode. */
     unsigned long lastUpdate = 0; /**< The time in milliseconds of the last display update. */
     bool displayStandby = false; /**< Flag indicating whether the display is in standby mode. */
@@ -21,6 +144,74 @@ private:
      * 
      */
     void clearDisplay();
+    /**
+     * @brief Hands the framebuffer to the flusher, replacing a pending frame.
+     *
+     */
+    void present();
+    /**
+     * @brief Sends the changed columns of the pending frame to the panel.
+     *
+     * @return true if a frame was pending, false otherwise.
+     */
+    bool flushFrame();
+    /**
+     * @brief Sends a span of columns of a page to the panel.
+     *
+     * @param row The page in the frame being sent.
+     * @param page The page (row of 8 pixels).
+     * @param first The first column.
+     * @param last The last column.
+     */
+    void sendSpan(const uint8_t *row, uint8_t page, uint16_t first, uint16_t last);
+    /**
+     * @brief Copies text from the glyph atlas into the framebuffer.
+     *
+     * @param x The first column.
+     * @param page The first page (row of 8 pixels).
+     * @param text The text to draw.
+     * @param width The maximum width in columns, the text is clipped.
+     * @return false if a character isn't in the atlas, nothing is drawn then.
+     */
+    bool drawGlyphs(int16_t x, uint8_t page, const char *text, int16_t width);
+    /**
+     * @brief Draws the measurement value into the framebuffer.
+     *
+     * @param value The value.
+     */
+    void drawValue(long value);
+    /**
+     * @brief Fits the sparkline range to the history and draws all of its columns into the framebuffer.
+     *
+     */
+    void drawHistory();
+    /**
+     * @brief Draws a column of the sparkline into the framebuffer, connecting the point to the previous one.
+     *
+     * @param slot The history slot, which is also the column.
+     */
+    void drawHistoryColumn(size_t slot);
+    /**
+     * @brief Blanks the sparkline column after the newest point, it marks the sweep position.
+     *
+     */
+    void clearHistoryCursor();
+    /**
+     * @brief Returns the sparkline row of a weight, 0 is the top row.
+     *
+     * @param value The weight.
+     */
+    uint8_t historyRow(long value);
+    /**
+     * @brief Takes the lock shared with the flush task, a no-op without DISPLAY_FLUSH_TASK.
+     *
+     */
+    void lock();
+    /**
+     * @brief Releases the lock shared with the flush task, a no-op without DISPLAY_FLUSH_TASK.
+     *
+     */
+    void unlock();
 public:
     /**
      * @brief The Data struct contains the data to be displayed on the screen.
@@ -66,6 +257,32 @@ public:
      * @param screenTimeOut The time in milliseconds before the display goes into standby mode.
      */
     void setScreenTimeOut(unsigned long screenTimeOut); 
+    /**
+     * @brief Sets the minimum time between two transfers to the panel, screens shown in between are coalesced.
+     * 
+     * @param interval The flush interval in milliseconds.
+     */
+    void setFlushInterval(unsigned long interval);
+    /**
+     * @brief Sets the weight history shown as a sparkline on the measurement screen.
+     *
+     * @param history The history, nullptr to show none. Must outlive the display.
+     */
+    void setHistory(const History *history);
+    /**
+     * @brief Draws the newest point of the history if the measurement screen is shown.
+     *
+     */
+    void updateHistory();
+    /**
+     * @brief Compares drawing a value with the glyph atlas and with the GFX text of size 2, prints the timings.
+     * Only touches the framebuffer, the next screen replaces it. Called by the test action on the device,
+     * test_display times the same draws on the host.
+     *
+     * @param value The value to draw.
+     * @param runs The number of draws per method.
+     */
+    void benchmarkValue(long value, uint16_t runs);
     /**
      * @brief Displays the measurement data.
      * 
@@ -101,6 +318,12 @@ public:
      * @param calibration The calibration value to be displayed.
      */
     void showCalibrationMessage(long calibration);
+    /**
+     * @brief Returns the I2C traffic counters of the display updates.
+     *
+     * @return The counters since init().
+     */
+    Statistics getStatistics();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,239 @@
+/**
+ * @file filter.cpp
+ * @brief Implementation of the streaming filters applied to load cell samples.
+ *
+ */
+#include "filter.h"
+
+// scales the MAD to the standard deviation of normally distributed samples
+static const float MAD_SCALE = 1.4826f;
+
+void MedianFilter::configure(uint8_t windowSize, float hampelThreshold)
+{
+    size = windowSize > MAX_WINDOW ? MAX_WINDOW : windowSize;
+    threshold = hampelThreshold;
+    reset();
+}
+
+void MedianFilter::reset()
+{
+    count = 0;
+    index = 0;
+}
+
+bool MedianFilter::isEnabled()
+{
+    return size > 1;
+}
+
+float MedianFilter::median(float *values, uint8_t length)
+{
+    // insertion sort, the window is tiny
+    for (uint8_t i = 1; i < length; i++)
+    {
+        float value = values[i];
+        int8_t j = i - 1;
+        while (j >= 0 && values[j] > value)
+        {
+            values[j + 1] = values[j];
+            j--;
+        }
+        values[j + 1] = value;
+    }
+
+    if (length % 2)
+        return values[length / 2];
+    return (values[length / 2 - 1] + values[length / 2]) / 2;
+}
+
+float MedianFilter::process(float sample)
+{
+    window[index] = sample;
+    index = (index + 1) % size;
+    if (count < size)
+        count++;
+
+    float sorted[MAX_WINDOW];
+    memcpy(sorted, window, count * sizeof(float));
+    float med = median(sorted, count);
+
+    if (threshold <= 0)
+        return med;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        sorted[i] = fabsf(window[i] - med);
+    }
+    float mad = median(sorted, count) * MAD_SCALE;
+
+    return fabsf(sample - med) > threshold * mad ? med : sample;
+}
+
+void EmaFilter::configure(float smoothing)
+{
+    alpha = smoothing > 1 ? 1 : smoothing;
+    reset();
+}
+
+void EmaFilter::reset()
+{
+    primed = false;
+}
+
+bool EmaFilter::isEnabled()
+{
+    return alpha > 0;
+}
+
+float EmaFilter::process(float sample)
+{
+    if (!primed)
+    {
+        value = sample;
+        primed = true;
+    }
+    else
+    {
+        value += alpha * (sample - value);
+    }
+    return value;
+}
+
+void KalmanFilter::configure(float processNoise, float measurementNoise)
+{
+    q = processNoise;
+    r = measurementNoise > 0 ? measurementNoise : 1;
+    reset();
+}
+
+void KalmanFilter::reset()
+{
+    primed = false;
+}
+
+bool KalmanFilter::isEnabled()
+{
+    return q > 0;
+}
+
+float KalmanFilter::process(float sample)
+{
+    if (!primed)
+    {
+        estimate = sample;
+        error = r;
+        primed = true;
+        return estimate;
+    }
+
+    // predict: the weight is modelled as constant, only the uncertainty grows
+    error += q;
+    // update
+    float gain = error / (error + r);
+    estimate += gain * (sample - estimate);
+    error *= 1 - gain;
+    return estimate;
+}
+
+void FilterChain::configure(const FilterChain::Config &config)
+{
+    median.configure(config.medianWindow, config.hampelThreshold);
+    kalman.configure(config.kalmanQ, config.kalmanR);
+    ema.configure(config.emaAlpha);
+}
+
+void FilterChain::reset()
+{
+    median.reset();
+    kalman.reset();
+    ema.reset();
+}
+
+float FilterChain::process(float sample)
+{
+    if (median.isEnabled())
+        sample = median.process(sample);
+    if (kalman.isEnabled())
+        sample = kalman.process(sample);
+    if (ema.isEnabled())
+        sample = ema.process(sample);
+    return sample;
+}
+
+void StabilityDetector::configure(float varianceThreshold, unsigned long hold)
+{
+    threshold = varianceThreshold;
+    holdMs = hold;
+    reset();
+}
+
+void StabilityDetector::reset()
+{
+    count = 0;
+    index = 0;
+    sum = 0;
+    sumSquares = 0;
+    quiet = false;
+    stable = false;
+    settledValid = false;
+}
+
+bool StabilityDetector::isStable()
+{
+    return stable;
+}
+
+bool StabilityDetector::hasSettled()
+{
+    return settledValid;
+}
+
+float StabilityDetector::getSettled()
+{
+    return settled;
+}
+
+void StabilityDetector::process(float sample, unsigned long ts)
+{
+    if (count == WINDOW)
+    {
+        sum -= window[index];
+        sumSquares -= (double)window[index] * window[index];
+    }
+    else
+    {
+        count++;
+    }
+    window[index] = sample;
+    index = (index + 1) % WINDOW;
+    sum += sample;
+    sumSquares += (double)sample * sample;
+
+    if (count < WINDOW)
+        return;
+
+    double mean = sum / WINDOW;
+    double variance = sumSquares / WINDOW - mean * mean;
+    if (variance > (double)threshold * threshold)
+    {
+        quiet = false;
+        stable = false;
+        return;
+    }
+
+    if (!quiet)
+    {
+        quiet = true;
+        quietSince = ts;
+    }
+
+    if (ts - quietSince >= holdMs)
+    {
+        stable = true;
+        if (!settledValid || fabs(mean - settled) >= threshold)
+        {
+            settled = mean;
+            settledValid = true;
+        }
+    }
+}
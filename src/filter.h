@@ -0,0 +1,244 @@
+/**
+ * @file filter.h
+ * @brief Header file for the streaming filters applied to load cell samples.
+ *
+ * This file contains the declaration of a Hampel/median outlier rejector, an exponential moving average and a 1-D Kalman filter.
+ * The FilterChain class combines them into a fixed pipeline. All filters work on statically sized state and never allocate.
+ * The StabilityDetector decides whether the filtered signal has settled.
+ *
+ */
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Rolling median filter with optional Hampel outlier rejection.
+ *
+ * With a threshold of zero every sample is replaced by the median of the window. Otherwise a sample is only
+ * replaced if it deviates more than threshold * MAD (median absolute deviation) from the median.
+ */
+class MedianFilter
+{
+public:
+    static const uint8_t MAX_WINDOW = 9; // Maximum window size, bounds the cost per sample.
+
+    /**
+     * @brief Configures the filter and resets its state.
+     * @param windowSize The number of samples in the rolling window, 0 or 1 disables the filter.
+     * @param threshold The Hampel threshold in multiples of the scaled MAD, 0 for a plain median.
+     */
+    void configure(uint8_t windowSize, float threshold);
+
+    /**
+     * @brief Resets the filter state.
+     */
+    void reset();
+
+    /**
+     * @brief Processes a sample.
+     * @param sample The input sample.
+     * @return The filtered sample.
+     */
+    float process(float sample);
+
+    /**
+     * @brief Checks if the filter is enabled.
+     * @return True if the filter is enabled, false otherwise.
+     */
+    bool isEnabled();
+
+private:
+    float window[MAX_WINDOW]; // Ring buffer of the last samples.
+    uint8_t size = 0; // Configured window size.
+    uint8_t count = 0; // Number of samples in the window.
+    uint8_t index = 0; // Next slot written in the window.
+    float threshold = 0; // Hampel threshold.
+
+    /**
+     * @brief Returns the median of an array, the array is sorted in place.
+     */
+    static float median(float *values, uint8_t length);
+};
+
+/**
+ * @brief Exponential moving average.
+ */
+class EmaFilter
+{
+public:
+    /**
+     * @brief Configures the filter and resets its state.
+     * @param alpha The smoothing factor in (0, 1], 0 disables the filter.
+     */
+    void configure(float alpha);
+
+    /**
+     * @brief Resets the filter state.
+     */
+    void reset();
+
+    /**
+     * @brief Processes a sample.
+     * @param sample The input sample.
+     * @return The filtered sample.
+     */
+    float process(float sample);
+
+    /**
+     * @brief Checks if the filter is enabled.
+     * @return True if the filter is enabled, false otherwise.
+     */
+    bool isEnabled();
+
+private:
+    float alpha = 0; // Smoothing factor.
+    float value = 0; // Current average.
+    bool primed = false; // Flag to indicate if the average has been seeded with a sample.
+};
+
+/**
+ * @brief 1-D Kalman filter for a constant signal with process noise.
+ */
+class KalmanFilter
+{
+public:
+    /**
+     * @brief Configures the filter and resets its state.
+     * @param processNoise The process noise variance (q), 0 disables the filter.
+     * @param measurementNoise The measurement noise variance (r).
+     */
+    void configure(float processNoise, float measurementNoise);
+
+    /**
+     * @brief Resets the filter state.
+     */
+    void reset();
+
+    /**
+     * @brief Processes a sample.
+     * @param sample The input sample.
+     * @return The filtered sample.
+     */
+    float process(float sample);
+
+    /**
+     * @brief Checks if the filter is enabled.
+     * @return True if the filter is enabled, false otherwise.
+     */
+    bool isEnabled();
+
+private:
+    float q = 0; // Process noise variance.
+    float r = 1; // Measurement noise variance.
+    float estimate = 0; // Current state estimate.
+    float error = 0; // Current estimate error variance.
+    bool primed = false; // Flag to indicate if the estimate has been seeded with a sample.
+};
+
+/**
+ * @brief Fixed pipeline of median/Hampel -> Kalman -> EMA. Disabled stages are skipped.
+ */
+class FilterChain
+{
+public:
+    /**
+     * @brief Struct for the tunable parameters of all stages.
+     */
+    struct Config
+    {
+        uint8_t medianWindow; // Window size of the median filter, 0 disables it.
+        float hampelThreshold; // Hampel threshold in MADs, 0 for a plain median.
+        float emaAlpha; // Smoothing factor of the EMA, 0 disables it.
+        float kalmanQ; // Process noise of the Kalman filter, 0 disables it.
+        float kalmanR; // Measurement noise of the Kalman filter.
+    };
+
+    /**
+     * @brief Configures all stages and resets their state.
+     * @param config The stage parameters.
+     */
+    void configure(const Config &config);
+
+    /**
+     * @brief Resets the state of all stages, e.g. after taring.
+     */
+    void reset();
+
+    /**
+     * @brief Passes a sample through all enabled stages.
+     * @param sample The input sample.
+     * @return The filtered sample.
+     */
+    float process(float sample);
+
+private:
+    MedianFilter median;
+    KalmanFilter kalman;
+    EmaFilter ema;
+};
+
+/**
+ * @brief Detects a settled signal with a windowed variance test and a hold time.
+ *
+ * The signal is stable once the standard deviation of the last WINDOW samples stays within the threshold for the hold time.
+ * The settled value only follows the window mean if it moved by at least the threshold, so noise doesn't produce new values.
+ */
+class StabilityDetector
+{
+public:
+    static const uint8_t WINDOW = 10; // Number of samples in the variance window.
+
+    /**
+     * @brief Configures the detector and resets its state.
+     * @param threshold The maximum standard deviation in grams for a stable signal.
+     * @param holdMs The time in milliseconds the signal has to stay within the threshold.
+     */
+    void configure(float threshold, unsigned long holdMs);
+
+    /**
+     * @brief Resets the detector state, e.g. after taring.
+     */
+    void reset();
+
+    /**
+     * @brief Adds a sample to the variance window.
+     * @param sample The filtered sample.
+     * @param ts The timestamp of the sample in milliseconds.
+     */
+    void process(float sample, unsigned long ts);
+
+    /**
+     * @brief Checks if the signal is stable.
+     * @return True if the signal stayed within the threshold for the hold time, false otherwise.
+     */
+    bool isStable();
+
+    /**
+     * @brief Checks if the signal has settled at least once since the last reset.
+     * @return True if a settled value is available, false otherwise.
+     */
+    bool hasSettled();
+
+    /**
+     * @brief Returns the last settled value.
+     * @return The mean of the variance window when the signal settled.
+     */
+    float getSettled();
+
+private:
+    float window[WINDOW]; // Ring buffer of the last samples.
+    uint8_t count = 0; // Number of samples in the window.
+    uint8_t index = 0; // Next slot written in the window.
+    double sum = 0; // Running sum of the window.
+    double sumSquares = 0; // Running sum of squares of the window.
+    float threshold = 2; // Maximum standard deviation of a stable signal.
+    unsigned long holdMs = 500; // Hold time in milliseconds.
+    unsigned long quietSince = 0; // Timestamp when the signal entered the threshold.
+    bool quiet = false; // Flag to indicate if the signal is within the threshold.
+    bool stable = false; // Flag to indicate if the signal is stable.
+    bool settledValid = false; // Flag to indicate if settled holds a value.
+    float settled = 0; // Last settled value.
+};
+
+#endif
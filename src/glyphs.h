@@ -0,0 +1,91 @@
+/**
+ * @file glyphs.h
+ * @brief Glyph atlas of the weight readout in SSD1306 page format, generated by tools/glyphs.py, do not edit.
+ */
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+#include <Arduino.h>
+
+#define GLYPH_WIDTH 12 // Columns of a glyph.
+#define GLYPH_PAGES 3 // Pages (8 pixel rows) of a glyph.
+#define GLYPH_SPACING 2 // Blank columns between two glyphs.
+
+static const char GLYPH_CHARS[] = "0123456789-g"; // Characters in the atlas, in atlas order.
+
+static const uint8_t GLYPH_ATLAS[12][GLYPH_PAGES * GLYPH_WIDTH] = {
+    // 0
+    {
+        0xf0, 0xfc, 0xfe, 0x0e, 0x07, 0x07, 0x07, 0x07, 0x0e, 0xfe, 0xfc, 0xf0,
+        0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff,
+        0x00, 0x03, 0x07, 0x07, 0x0e, 0x0e, 0x0e, 0x0e, 0x07, 0x07, 0x03, 0x00,
+    },
+    // 1
+    {
+        0x00, 0x30, 0x38, 0x3c, 0x1e, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x0e, 0x0e, 0x0e, 0x0e, 0x0f, 0x0f, 0x0f, 0x0e, 0x0e, 0x0e, 0x0e,
+    },
+    // 2
+    {
+        0x70, 0x7c, 0x7e, 0x0e, 0x07, 0x07, 0x07, 0x07, 0x0e, 0xfe, 0xfc, 0xf0,
+        0x00, 0x00, 0x80, 0xc0, 0xe0, 0xf8, 0x7c, 0x3e, 0x0f, 0x07, 0x03, 0x00,
+        0x0e, 0x0f, 0x0f, 0x0f, 0x0f, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e,
+    },
+    // 3
+    {
+        0x00, 0x1c, 0x1e, 0x0e, 0x07, 0x07, 0x07, 0x07, 0x8e, 0xfe, 0xfc, 0xf8,
+        0x80, 0xc0, 0xc0, 0x00, 0x00, 0x07, 0x07, 0x07, 0x0f, 0xff, 0xfd, 0xf0,
+        0x00, 0x03, 0x07, 0x07, 0x0e, 0x0e, 0x0e, 0x0e, 0x07, 0x07, 0x03, 0x00,
+    },
+    // 4
+    {
+        0x00, 0x00, 0x00, 0x80, 0xe0, 0xf0, 0xfc, 0xff, 0xff, 0xff, 0x00, 0x00,
+        0x30, 0x3c, 0x3e, 0x3f, 0x37, 0x31, 0x30, 0xff, 0xff, 0xff, 0x30, 0x30,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x0f, 0x0f, 0x00, 0x00,
+    },
+    // 5
+    {
+        0xff, 0xff, 0xff, 0x87, 0x87, 0x87, 0x87, 0x87, 0x07, 0x07, 0x07, 0x07,
+        0x03, 0x83, 0x83, 0x03, 0x03, 0x03, 0x03, 0x03, 0x07, 0xff, 0xfe, 0xf8,
+        0x00, 0x03, 0x07, 0x07, 0x0e, 0x0e, 0x0e, 0x0e, 0x07, 0x07, 0x03, 0x00,
+    },
+    // 6
+    {
+        0xf0, 0xfc, 0xfe, 0x0e, 0x07, 0x07, 0x07, 0x07, 0x0e, 0x1e, 0x1c, 0x00,
+        0xff, 0xff, 0xff, 0x0e, 0x07, 0x07, 0x07, 0x07, 0x0e, 0xfe, 0xfc, 0xf0,
+        0x00, 0x03, 0x07, 0x07, 0x0e, 0x0e, 0x0e, 0x0e, 0x07, 0x07, 0x03, 0x00,
+    },
+    // 7
+    {
+        0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0xc7, 0xff, 0xff, 0x3f, 0x07,
+        0x00, 0x00, 0x00, 0x00, 0xc0, 0xf8, 0xff, 0x3f, 0x0f, 0x01, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x0e, 0x0f, 0x0f, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    },
+    // 8
+    {
+        0x00, 0xfc, 0xfe, 0xde, 0x87, 0x07, 0x07, 0x87, 0xde, 0xfe, 0xfc, 0x00,
+        0xf8, 0xfc, 0xff, 0x0f, 0x07, 0x07, 0x07, 0x07, 0x0f, 0xff, 0xfc, 0xf8,
+        0x00, 0x03, 0x07, 0x07, 0x0e, 0x0e, 0x0e, 0x0e, 0x07, 0x07, 0x03, 0x00,
+    },
+    // 9
+    {
+        0xf0, 0xfc, 0xfe, 0x0e, 0x07, 0x07, 0x07, 0x07, 0x0e, 0xfe, 0xfc, 0xf0,
+        0x00, 0x83, 0x87, 0x07, 0x0e, 0x0e, 0x0e, 0x0e, 0x07, 0xff, 0xff, 0xff,
+        0x00, 0x03, 0x07, 0x07, 0x0e, 0x0e, 0x0e, 0x0e, 0x07, 0x07, 0x03, 0x00,
+    },
+    // -
+    {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x0e, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    },
+    // g
+    {
+        0x00, 0x80, 0xc0, 0xc0, 0xe0, 0xe0, 0xe0, 0xe0, 0xc0, 0xe0, 0xe0, 0xe0,
+        0x1e, 0x7f, 0xff, 0xe1, 0xc0, 0xc0, 0xc0, 0xc0, 0xe1, 0xff, 0xff, 0xff,
+        0x1c, 0x7c, 0xfc, 0xe0, 0xe1, 0xc1, 0xc1, 0xe1, 0xe0, 0xff, 0x7f, 0x1f,
+    },
+};
+
+#endif
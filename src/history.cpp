@@ -0,0 +1,49 @@
+#include "history.h"
+
+History::History(unsigned long interval)
+{
+    this->interval = interval;
+}
+
+void History::setInterval(unsigned long interval)
+{
+    this->interval = interval;
+}
+
+bool History::add(long value, unsigned long now)
+{
+    if (samples == 0)
+        start = now;
+    sum += value;
+    samples++;
+    if (now - start < interval)
+        return false;
+
+    points[head] = sum / (long long)samples;
+    head = (head + 1) % HISTORY_SIZE;
+    if (stored < HISTORY_SIZE)
+        stored++;
+    sum = 0;
+    samples = 0;
+    return true;
+}
+
+size_t History::count() const
+{
+    return stored;
+}
+
+size_t History::newest() const
+{
+    return (head + HISTORY_SIZE - 1) % HISTORY_SIZE;
+}
+
+long History::point(size_t slot) const
+{
+    return points[slot];
+}
+
+bool History::has(size_t slot) const
+{
+    return stored == HISTORY_SIZE || slot < head;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file history.h
+ * @brief Header file for the weight history shown as a sparkline on the display.
+ *
+ * The measurements are averaged into one point per interval and stored in a fixed ring of HISTORY_SIZE points,
+ * one point per display column. Adding a sample is O(1) and never allocates.
+ */
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Number of points in the history, the width of the display.
+ */
+#define HISTORY_SIZE 128
+
+/**
+ * @brief Ring of downsampled weight points.
+ */
+class History
+{
+public:
+    /**
+     * @brief Constructor for the History class.
+     * @param interval The time in milliseconds averaged into one point.
+     */
+    History(unsigned long interval);
+
+    /**
+     * @brief Sets the time averaged into one point, takes effect with the next point.
+     * @param interval The interval in milliseconds.
+     */
+    void setInterval(unsigned long interval);
+
+    /**
+     * @brief Adds a measurement to the current point.
+     * @param value The measured weight.
+     * @param now The time of the measurement in milliseconds.
+     * @return True if the interval elapsed and a new point was stored, false otherwise.
+     */
+    bool add(long value, unsigned long now);
+
+    /**
+     * @brief Returns the number of stored points, at most HISTORY_SIZE.
+     */
+    size_t count() const;
+
+    /**
+     * @brief Returns the slot of the newest point, only valid if count() is not zero.
+     */
+    size_t newest() const;
+
+    /**
+     * @brief Returns the point stored in a slot.
+     * @param slot The slot, below HISTORY_SIZE.
+     */
+    long point(size_t slot) const;
+
+    /**
+     * @brief Checks if a slot holds a point.
+     * @param slot The slot, below HISTORY_SIZE.
+     */
+    bool has(size_t slot) const;
+
+private:
+    long points[HISTORY_SIZE]; // Ring of the points, the slot of a point is its display column.
+    size_t head = 0;           // Slot written next.
+    size_t stored = 0;         // Number of stored points.
+    unsigned long interval;    // Time in milliseconds averaged into one point.
+    unsigned long start = 0;   // Time of the first sample of the current point.
+    long long sum = 0;         // Sum of the samples of the current point.
+    unsigned long samples = 0; // Number of samples of the current point.
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "journal.h"
+
+Journal::Journal(BlockDevice *blockDevice)
+{
+    device = blockDevice;
+}
+
+bool Journal::begin()
+{
+    ready = false;
+    if (device == nullptr || !device->begin())
+        return false;
+
+    size_t sectorSize = device->sectorSize();
+    if (sectorSize < JOURNAL_SLOT_SIZE || sectorSize % JOURNAL_SLOT_SIZE != 0 || device->size() < 2 * sectorSize)
+    {
+        Serial.println(F("Journal device too small or misaligned."));
+        return false;
+    }
+    slotsPerSector = sectorSize / JOURNAL_SLOT_SIZE;
+    slotCount = device->size() / sectorSize * slotsPerSector;
+    // the ring is written sector by sector in sequence order, the first record of every sector is enough to find the
+    // sector of the newest record and the oldest sector. Scanning every slot would read all 22k slots of the default
+    // 1.4 MB partition at each boot.
+    size_t sectorCount = slotCount / slotsPerSector;
+    bool found = false;
+    size_t headSector = 0;
+    size_t oldestSector = 0;
+    uint32_t headSectorSeq = 0;
+    uint32_t oldestSeq = 0;
+    for (size_t sector = 0; sector < sectorCount; sector++)
+    {
+        SlotRecord record;
+        if (!findRecord(sector, false, record))
+            continue;
+        if (!found || record.seq > headSectorSeq)
+        {
+            headSector = sector;
+            headSectorSeq = record.seq;
+        }
+        if (!found || record.seq < oldestSeq)
+        {
+            oldestSector = sector;
+            oldestSeq = record.seq;
+        }
+        found = true;
+    }
+
+    head = 0;
+    tail = 0;
+    pendingCount = 0;
+    nextSeq = 1;
+    if (found)
+    {
+        SlotRecord newest;
+        findRecord(headSector, true, newest);
+        head = nextSlot(newest.slot);
+        nextSeq = newest.seq + 1;
+
+        // records are consumed in sequence order, so the sectors from the oldest one to the head sector hold
+        // consumed records first and pending ones after them. The tail is in the first sector that ends with a
+        // pending record.
+        size_t low = 0;
+        size_t high = (headSector + sectorCount - oldestSector) % sectorCount + 1;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            SlotRecord last;
+            if (findRecord((oldestSector + middle) % sectorCount, true, last) && last.pending)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+
+        tail = head;
+        if (low <= (headSector + sectorCount - oldestSector) % sectorCount)
+        {
+            byte buffer[JOURNAL_SLOT_SIZE];
+            size_t first = (oldestSector + low) % sectorCount * slotsPerSector;
+            for (size_t slot = first; slot < first + slotsPerSector; slot++)
+            {
+                if (readSlot(slot, buffer) != SlotKind::Pending)
+                    continue;
+                uint32_t seq;
+                memcpy(&seq, buffer + 4, sizeof(seq));
+                // sequence numbers have no gaps, a torn append doesn't advance them
+                tail = slot;
+                pendingCount = newest.seq - seq + 1;
+                break;
+            }
+        }
+    }
+
+    Serial.printf("Journal with %lu slots, %lu records pending.", (unsigned long)slotCount, (unsigned long)pendingCount);
+    Serial.println();
+
+    ready = true;
+    return true;
+}
+
+bool Journal::append(const void *payload, uint8_t length)
+{
+    if (!ready || length > MAX_PAYLOAD)
+        return false;
+
+    // find a free slot, a sector is erased when the head enters it again
+    byte buffer[JOURNAL_SLOT_SIZE];
+    size_t attempts = 0;
+    while (readSlot(head, buffer) != SlotKind::Free)
+    {
+        if (head % slotsPerSector == 0)
+        {
+            if (!eraseSector(head))
+                return false;
+            continue;
+        }
+        // torn record of a power loss, skip the slot until the sector is erased
+        head = nextSlot(head);
+        if (++attempts >= slotCount)
+            return false;
+    }
+
+    memset(buffer, 0xFF, sizeof(buffer));
+    buffer[2] = length;
+    memcpy(buffer + 4, &nextSeq, sizeof(nextSeq));
+    memcpy(buffer + JOURNAL_HEADER_SIZE, payload, length);
+    uint32_t crc = recordCrc(buffer);
+    memcpy(buffer + 8, &crc, sizeof(crc));
+
+    // the magic is programmed last, it commits the record
+    size_t offset = slotOffset(head);
+    if (!device->program(offset + 2, buffer + 2, JOURNAL_HEADER_SIZE - 2 + length))
+        return false;
+    buffer[0] = SLOT_MAGIC;
+    if (!device->program(offset, buffer, 1))
+        return false;
+
+    if (pendingCount == 0)
+        tail = head;
+    pendingCount++;
+    nextSeq++;
+    head = nextSlot(head);
+    statistics.appended++;
+    return true;
+}
+
+bool Journal::peek(void *payload, uint8_t &length, uint32_t &seq)
+{
+    if (!ready)
+        return false;
+
+    byte buffer[JOURNAL_SLOT_SIZE];
+    for (size_t i = 0; i < slotCount && pendingCount > 0; i++)
+    {
+        if (readSlot(tail, buffer) == SlotKind::Pending)
+        {
+            length = buffer[2];
+            memcpy(&seq, buffer + 4, sizeof(seq));
+            memcpy(payload, buffer + JOURNAL_HEADER_SIZE, length);
+            return true;
+        }
+        tail = nextSlot(tail);
+    }
+    pendingCount = 0;
+    tail = head;
+    return false;
+}
+
+bool Journal::consume()
+{
+    byte payload[MAX_PAYLOAD];
+    uint8_t length;
+    uint32_t seq;
+    if (!peek(payload, length, seq))
+        return false;
+
+    byte state = STATE_CONSUMED;
+    if (!device->program(slotOffset(tail) + 1, &state, 1))
+        return false;
+
+    pendingCount--;
+    tail = pendingCount > 0 ? nextSlot(tail) : head;
+    statistics.consumed++;
+    return true;
+}
+
+size_t Journal::pending()
+{
+    return pendingCount;
+}
+
+Journal::Statistics Journal::getStatistics()
+{
+    return statistics;
+}
+
+Journal::SlotKind Journal::readSlot(size_t slot, byte *buffer)
+{
+    if (!device->read(slotOffset(slot), buffer, JOURNAL_SLOT_SIZE))
+        return SlotKind::Invalid;
+
+    if (buffer[0] != SLOT_MAGIC)
+    {
+        for (uint8_t i = 0; i < JOURNAL_SLOT_SIZE; i++)
+        {
+            if (buffer[i] != 0xFF)
+                return SlotKind::Invalid;
+        }
+        return SlotKind::Free;
+    }
+
+    uint32_t crc;
+    memcpy(&crc, buffer + 8, sizeof(crc));
+    if (buffer[2] > MAX_PAYLOAD || crc != recordCrc(buffer))
+        return SlotKind::Invalid;
+
+    return buffer[1] == STATE_PENDING ? SlotKind::Pending : SlotKind::Consumed;
+}
+
+bool Journal::findRecord(size_t sector, bool last, Journal::SlotRecord &record)
+{
+    // torn slots are skipped, in the head sector the free slots after the newest record as well. A sector is written
+    // from its first slot on, so a free first slot means an empty sector.
+    byte buffer[JOURNAL_SLOT_SIZE];
+    size_t first = sector * slotsPerSector;
+    for (size_t i = 0; i < slotsPerSector; i++)
+    {
+        size_t slot = last ? first + slotsPerSector - 1 - i : first + i;
+        SlotKind kind = readSlot(slot, buffer);
+        if (kind == SlotKind::Free && !last)
+            return false;
+        if (kind != SlotKind::Pending && kind != SlotKind::Consumed)
+            continue;
+
+        record.slot = slot;
+        memcpy(&record.seq, buffer + 4, sizeof(record.seq));
+        record.pending = kind == SlotKind::Pending;
+        return true;
+    }
+    return false;
+}
+
+bool Journal::eraseSector(size_t slot)
+{
+    byte buffer[JOURNAL_SLOT_SIZE];
+    bool tailInSector = false;
+    for (size_t i = slot; i < slot + slotsPerSector; i++)
+    {
+        if (readSlot(i, buffer) == SlotKind::Pending)
+        {
+            pendingCount--;
+            statistics.dropped++;
+        }
+        tailInSector |= i == tail;
+    }
+
+    if (!device->erase(slotOffset(slot)))
+        return false;
+    statistics.erases++;
+
+    if (pendingCount == 0)
+        tail = slot;
+    else if (tailInSector)
+        tail = nextSlot(slot + slotsPerSector - 1);
+    return true;
+}
+
+size_t Journal::slotOffset(size_t slot)
+{
+    return slot * JOURNAL_SLOT_SIZE;
+}
+
+size_t Journal::nextSlot(size_t slot)
+{
+    return slot + 1 < slotCount ? slot + 1 : 0;
+}
+
+uint32_t Journal::recordCrc(const byte *buffer)
+{
+    // length and sequence number, then the payload, the state byte changes when the record is consumed
+    uint32_t crc = Conversion::crc32(buffer + 2, 1);
+    crc = Conversion::crc32(buffer + 4, 4, crc);
+    return Conversion::crc32(buffer + JOURNAL_HEADER_SIZE, buffer[2], crc);
+}
@@ -0,0 +1,172 @@
+/**
+ * @file journal.h
+ * @brief Append-only store-and-forward journal on a BlockDevice.
+ *
+ * Records are written into fixed size slots that fill the device sector by sector, like a ring. Each record carries a
+ * sequence number and a CRC32; its magic byte is programmed last, so a record torn by a power loss is never taken for
+ * a valid one. Consuming a record only clears its state byte, so a sector is erased once per pass of the ring, right
+ * before it is written again. When the ring is full, the oldest sector is erased and its pending records are dropped.
+ */
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+
+#include "blockdevice.h"
+#include "conversion.h"
+
+/**
+ * @brief Size of a journal slot in bytes, a divisor of the sector size.
+ */
+#define JOURNAL_SLOT_SIZE 64
+
+/**
+ * @brief Size of the slot header in bytes (magic, state, length, reserved, sequence number, crc).
+ */
+#define JOURNAL_HEADER_SIZE 12
+
+/**
+ * @brief Class for a bounded journal of small records that survives resets and power losses.
+ */
+class Journal
+{
+public:
+    static const uint8_t MAX_PAYLOAD = JOURNAL_SLOT_SIZE - JOURNAL_HEADER_SIZE; // Maximum payload size of a record.
+
+    /**
+     * @brief Struct for reporting the journal counters since begin().
+     */
+    struct Statistics
+    {
+        unsigned long appended; // Records written.
+        unsigned long consumed; // Records marked as consumed.
+        unsigned long dropped;  // Pending records lost because the journal was full.
+        unsigned long erases;   // Sector erases.
+    };
+
+    /**
+     * @brief Constructor for the Journal class.
+     * @param device The block device holding the journal, nullptr disables the journal.
+     */
+    Journal(BlockDevice *device);
+
+    /**
+     * @brief Opens the device and finds the newest and the oldest pending record.
+     *
+     * Reads the first record of every sector and binary searches the sectors for the oldest pending record, a few
+     * hundred slot reads for a partition of thousands of slots.
+     *
+     * @return True if the journal is usable, false otherwise.
+     */
+    bool begin();
+
+    /**
+     * @brief Appends a record. Overwrites the oldest sector if the journal is full.
+     * @param payload The payload of the record.
+     * @param length The size of the payload, at most MAX_PAYLOAD.
+     * @return True if the record was written, false otherwise.
+     */
+    bool append(const void *payload, uint8_t length);
+
+    /**
+     * @brief Reads the oldest pending record without consuming it.
+     * @param payload Buffer of at least MAX_PAYLOAD bytes for the payload.
+     * @param length The size of the payload.
+     * @param seq The sequence number of the record.
+     * @return True if a record was pending, false otherwise.
+     */
+    bool peek(void *payload, uint8_t &length, uint32_t &seq);
+
+    /**
+     * @brief Marks the oldest pending record as consumed.
+     * @return True if a record was consumed, false otherwise.
+     */
+    bool consume();
+
+    /**
+     * @brief Returns the number of pending records.
+     */
+    size_t pending();
+
+    /**
+     * @brief Returns the journal counters.
+     */
+    Statistics getStatistics();
+
+private:
+    static const uint8_t SLOT_MAGIC = 0x4A; // Marks a completely written slot.
+    static const uint8_t STATE_PENDING = 0xFF; // State of a record that wasn't consumed yet.
+    static const uint8_t STATE_CONSUMED = 0x00; // State of a consumed record.
+
+    /**
+     * @brief Kind of a slot found on the device.
+     */
+    enum SlotKind
+    {
+        Free,     // erased
+        Pending,  // valid record, not consumed yet
+        Consumed, // valid record, consumed
+        Invalid   // torn or foreign data
+    };
+
+    /**
+     * @brief Valid record found on the device.
+     */
+    struct SlotRecord
+    {
+        size_t slot;  // Slot index.
+        uint32_t seq; // Sequence number.
+        bool pending; // Flag to indicate if the record wasn't consumed yet.
+    };
+
+    BlockDevice *device; // The block device holding the journal.
+    bool ready = false; // Flag to indicate if begin() succeeded.
+    size_t slotCount = 0; // Number of slots on the device.
+    size_t slotsPerSector = 0; // Number of slots of a sector.
+    size_t head = 0; // Slot the next record is written to.
+    size_t tail = 0; // Slot of the oldest pending record.
+    size_t pendingCount = 0; // Number of pending records.
+    uint32_t nextSeq = 1; // Sequence number of the next record.
+    Statistics statistics = {0, 0, 0, 0}; // Journal counters.
+
+    /**
+     * @brief Reads and classifies a slot.
+     * @param slot The slot index.
+     * @param buffer Buffer of JOURNAL_SLOT_SIZE bytes receiving the slot.
+     * @return The kind of the slot.
+     */
+    SlotKind readSlot(size_t slot, byte *buffer);
+
+    /**
+     * @brief Finds the first or the last valid record of a sector.
+     * @param sector The sector index.
+     * @param last True for the last record, false for the first one.
+     * @param record The record found.
+     * @return True if the sector holds a valid record, false otherwise.
+     */
+    bool findRecord(size_t sector, bool last, SlotRecord &record);
+
+    /**
+     * @brief Erases the sector of a slot and drops its pending records.
+     * @param slot The first slot of the sector.
+     * @return True if successful, false otherwise.
+     */
+    bool eraseSector(size_t slot);
+
+    /**
+     * @brief Returns the device offset of a slot.
+     */
+    size_t slotOffset(size_t slot);
+
+    /**
+     * @brief Returns the slot following a slot in the ring.
+     */
+    size_t nextSlot(size_t slot);
+
+    /**
+     * @brief Calculates the CRC32 of a record over its length, sequence number and payload.
+     */
+    static uint32_t recordCrc(const byte *buffer);
+};
+
+#endif
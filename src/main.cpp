@@ -19,6 +19,8 @@
 #include "display.h"
 #include "scale.h"
 #include "rfid.h"
+#include "journal.h"
+#include "command.h"
 #include <ArduinoJson.h>
 #include <Preferences.h>
 
@@ -34,6 +36,25 @@ enum RunMode
   Test
 };
 
+/**
+ * @brief When measurements are published on the status topic.
+ */
+enum StatusMode
+{
+  Change, // every changed measurement
+  Settled, // settled changes and a keepalive
+  Batch    // changed measurements, several per message
+};
+
+/**
+ * @brief Encoding of the status, heartbeat and response payloads.
+ */
+enum PayloadFormat
+{
+  Json,   // JSON text
+  MsgPack // MessagePack, on topics with a "/msgpack" suffix
+};
+
 Preferences preferences;
 
 /**
@@ -44,160 +65,590 @@ struct Configuration
 {
 
   unsigned long displayTimeout;
+  unsigned long displayFlushInterval;
+  unsigned long displayHistoryInterval;
   long loadcellCalibration;
   unsigned long loadcellKnownWeight;
   unsigned long loadcellMeasurementIntervall;
   uint8_t loadcellMeasurementSampling;
+  FilterChain::Config loadcellFilter;
+  float loadcellStabilityThreshold;
+  unsigned long loadcellStabilityHold;
+  uint8_t statusMode;
+  uint8_t payloadFormat;
+  unsigned long statusKeepalive;
+  uint8_t statusBatchSize;
+  unsigned long statusBatchInterval;
   unsigned long rfidDecay;
+  unsigned long rfidPollIdle;
+  unsigned long rfidPollBurst;
+  unsigned long rfidBurstDuration;
+  unsigned long rfidStepThreshold;
+  unsigned long journalDrainInterval;
 };
 Configuration config;
 
+/**
+ * @brief Fields of the Configuration struct the configure action can change, as (field, member) pairs.
+ */
+#define CONFIG_FIELDS(X)                                              \
+  X(FieldDisplayTimeout, displayTimeout)                              \
+  X(FieldDisplayFlushInterval, displayFlushInterval)                  \
+  X(FieldDisplayHistoryInterval, displayHistoryInterval)              \
+  X(FieldLoadcellCalibration, loadcellCalibration)                    \
+  X(FieldLoadcellKnownWeight, loadcellKnownWeight)                    \
+  X(FieldLoadcellMeasurementIntervall, loadcellMeasurementIntervall)  \
+  X(FieldLoadcellMeasurementSampling, loadcellMeasurementSampling)    \
+  X(FieldFilterMedian, loadcellFilter.medianWindow)                   \
+  X(FieldFilterHampel, loadcellFilter.hampelThreshold)                \
+  X(FieldFilterKalmanQ, loadcellFilter.kalmanQ)                       \
+  X(FieldFilterKalmanR, loadcellFilter.kalmanR)                       \
+  X(FieldFilterEma, loadcellFilter.emaAlpha)                          \
+  X(FieldStabilityThreshold, loadcellStabilityThreshold)              \
+  X(FieldStabilityHold, loadcellStabilityHold)                        \
+  X(FieldStatusMode, statusMode)                                      \
+  X(FieldStatusKeepalive, statusKeepalive)                            \
+  X(FieldStatusBatchSize, statusBatchSize)                            \
+  X(FieldStatusBatchInterval, statusBatchInterval)                    \
+  X(FieldPayloadFormat, payloadFormat)                                \
+  X(FieldRfidDecay, rfidDecay)                                        \
+  X(FieldRfidPollIdle, rfidPollIdle)                                  \
+  X(FieldRfidPollBurst, rfidPollBurst)                                \
+  X(FieldRfidBurstDuration, rfidBurstDuration)                        \
+  X(FieldRfidStepThreshold, rfidStepThreshold)                        \
+  X(FieldJournalDrainInterval, journalDrainInterval)
+
+/**
+ * @brief Bit positions of the changeable configuration fields in ConfigPatch::mask.
+ */
+enum ConfigField
+{
+#define CONFIG_FIELD_ENUM(field, member) field,
+  CONFIG_FIELDS(CONFIG_FIELD_ENUM)
+#undef CONFIG_FIELD_ENUM
+  ConfigFieldCount
+};
+static_assert(ConfigFieldCount <= 32, "ConfigPatch::mask holds 32 fields");
+
+/**
+ * @brief Changes of a configure command, only the fields set in mask are valid.
+ */
+struct ConfigPatch
+{
+  uint32_t mask;        // bit per ConfigField
+  Configuration values; // new values of the fields in mask
+};
+
+/**
+ * @brief Sets a field of a ConfigPatch and marks it as changed.
+ */
+#define PATCH_FIELD(patch, field, member, value) \
+  do                                             \
+  {                                              \
+    (patch).values.member = (value);             \
+    (patch).mask |= 1UL << (field);              \
+  } while (0)
+
+/**
+ * @brief Copies the fields of a patch into a configuration, or into an older patch to merge both.
+ */
+void applyPatch(Configuration &target, const ConfigPatch &patch)
+{
+#define CONFIG_FIELD_APPLY(field, member) \
+  if (patch.mask & (1UL << field))        \
+    target.member = patch.values.member;
+  CONFIG_FIELDS(CONFIG_FIELD_APPLY)
+#undef CONFIG_FIELD_APPLY
+}
+
+/**
+ * @brief Command waiting in the command queue.
+ */
+struct QueuedCommand
+{
+  const char *action;       // action of the command, for the responses
+  RunMode mode;             // run mode started by the command
+  char id[COMMAND_ID_SIZE]; // correlation id echoed in the responses, empty if none
+  ConfigPatch patch;        // changes of a configure command
+  TagData tag;              // fields of a write-tag command
+};
+
+CommandQueue<QueuedCommand, COMMAND_QUEUE_SIZE> commandQueue;
+
+/**
+ * @brief Response of a command handler, published after the MQTT callback returned.
+ */
+struct DeferredResponse
+{
+  const char *action;       // action of the command
+  char id[COMMAND_ID_SIZE]; // correlation id of the command, empty if none
+  const char *result;       // result, a string constant
+};
+
+CommandQueue<DeferredResponse, COMMAND_QUEUE_SIZE> responseQueue;
+char commandId[COMMAND_ID_SIZE] = ""; // correlation id of the running command
+
 RunMode currentMode = RunMode::Initialize;
 bool modeSwitch = true;
+uint8_t flowStep = 0;          // current step of the flow of the current run mode
+unsigned long flowStepTs = 0;  // timestamp of the last step change
+
+/**
+ * @brief Switches the run mode and starts its flow at the first step.
+ */
+void setRunMode(RunMode mode)
+{
+  currentMode = mode;
+  flowStep = 0;
+  flowStepTs = millis();
+}
+
+/**
+ * @brief Advances the flow of the current run mode to its next step.
+ */
+void nextFlowStep()
+{
+  flowStep++;
+  flowStepTs = millis();
+}
+
+/**
+ * @brief Checks if the current flow step has been active for the given time. Replaces delay() in the flows, so the loop keeps running.
+ */
+bool flowStepElapsed(unsigned long ms)
+{
+  return millis() - flowStepTs >= ms;
+}
+
+/**
+ * @brief Checks if a flow is running that must not be interrupted by another command.
+ */
+bool isBusy()
+{
+  return currentMode != RunMode::Measure && currentMode != RunMode::Error;
+}
 
 Display display(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_RESET_PIN, DISPLAY_TIMEOUT);
+History history(DISPLAY_HISTORY_INTERVAL);
 Display::Data displayData;
 Display::Error displayError;
 
-Scale scale(LOADCELL_DOUT_PIN, LOADCELL_SCK_PIN);
+#ifdef SCALE_SAMPLING_TASK
+Scale scale(LOADCELL_DOUT_PIN, LOADCELL_SCK_PIN, Scale::SamplingMode::Task);
+#else
+Scale scale(LOADCELL_DOUT_PIN, LOADCELL_SCK_PIN, LOADCELL_INTERRUPT_SAMPLING ? Scale::SamplingMode::Interrupt : Scale::SamplingMode::Polling);
+#endif
 Scale::Measurement measurement;
 
 RFID rfid(RFID_SS_PIN, RFID_RST_PIN);
 TagData wTag; // tag data to be written to the RFID reader
 TagData rTag; // tag data read from the RFID reader
 unsigned long lastTagRead = 0;
+long rfidStepReference = 0; // weight of the last step that started an RFID burst
+
+long lastStatusValue = 0; // last value published on the status topic
+unsigned long lastStatusPublish = 0;
 
 /**
- * Callback function for MQTT messages. Parses the message payload as a JSON object and performs actions based on the "action" key.
- * @param topic The MQTT topic the message was received on.
- * @param payload The message payload.
- * @param length The length of the message payload.
+ * @brief Status message as stored in the journal while the broker is unreachable.
  */
-void mqttCb(char *topic, byte *payload, unsigned int length)
+struct StatusRecord
+{
+  uint32_t ts;      // epoch seconds, 0 if the time wasn't synced yet
+  int32_t value;    // published weight
+  byte spoolId[16]; // spool on the scale, all zero if none
+  uint8_t stable;   // stable flag of the settled status mode
+};
+
+#if defined(ESP32)
+PartitionBlockDevice journalDevice(JOURNAL_PARTITION);
+Journal journal(&journalDevice);
+#elif defined(ESP8266)
+FlashBlockDevice journalDevice;
+Journal journal(&journalDevice);
+#else
+// the native simulator has no flash: the journal stays disabled, append() fails and status messages are dropped while
+// offline (or retried with the next measurement in settled mode)
+Journal journal(nullptr);
+#endif
+unsigned long lastJournalDrain = 0;
+
+/**
+ * @brief Samples collected for one message of the batch status mode.
+ */
+struct StatusBatch
+{
+  uint32_t ts;                             // epoch seconds of the first sample, 0 if the time wasn't synced yet
+  unsigned long start;                     // millis() of the first sample
+  byte spoolId[16];                        // spool of all samples, all zero if none
+  uint8_t count;                           // number of samples
+  long values[STATUS_BATCH_MAX];           // weights
+  unsigned long offsets[STATUS_BATCH_MAX]; // milliseconds since the first sample
+};
+StatusBatch statusBatch = {};
+
+/**
+ * @brief Maps the name of a status mode to the StatusMode enum, unknown names fall back to StatusMode::Change.
+ */
+StatusMode parseStatusMode(const char *mode)
+{
+  if (mode != NULL && strcmp(mode, STATUS_MODE_SETTLED) == 0)
+    return StatusMode::Settled;
+  if (mode != NULL && strcmp(mode, STATUS_MODE_BATCH) == 0)
+    return StatusMode::Batch;
+  return StatusMode::Change;
+}
+
+/**
+ * @brief Maps the name of a payload format to the PayloadFormat enum, unknown names fall back to PayloadFormat::Json.
+ */
+PayloadFormat parsePayloadFormat(const char *format)
+{
+  if (format != NULL && strcmp(format, PAYLOAD_FORMAT_MSGPACK) == 0)
+    return PayloadFormat::MsgPack;
+  return PayloadFormat::Json;
+}
+
+/**
+ * @brief Queues a response of a command handler until the MQTT callback returned.
+ *
+ * The command document points into the buffer of PubSubClient, which a publish from within the callback overwrites.
+ * PubSubClient delivers at most one message per loop() call and publishDeferredResponses() runs after every call, so
+ * at most one response waits at a time.
+ */
+void deferCommandResponse(const char *action, const char *id, const char *result)
+{
+  DeferredResponse response;
+  response.action = action;
+  strlcpy(response.id, id, sizeof(response.id));
+  response.result = result;
+  if (!responseQueue.push(response))
+    Serial.println("response queue full, response dropped.");
+}
+
+/**
+ * @brief Creates a queue entry for a command and copies its correlation id.
+ */
+QueuedCommand newCommand(const char *action, RunMode mode, JsonObject command)
 {
-  StaticJsonDocument<512> doc;
-  ArduinoJson::V6213PB2::DeserializationError serializationResult = deserializeJson(doc, payload, length);
-  if (serializationResult)
+  QueuedCommand queued = {};
+  queued.action = action;
+  queued.mode = mode;
+  const char *id = command["id"];
+  if (id != NULL)
+    strlcpy(queued.id, id, sizeof(queued.id));
+  return queued;
+}
+
+/**
+ * @brief Queues a command until the running flow is finished.
+ *
+ * A tare or configure command that follows the same command at the end of the queue is merged into it, the
+ * superseded command is answered as "coalesced". A full queue is answered as "queue-full".
+ */
+void enqueueCommand(const QueuedCommand &command)
+{
+  QueuedCommand *last = commandQueue.back();
+  if (last != nullptr && last->mode == command.mode && (command.mode == RunMode::Tare || command.mode == RunMode::Configure))
   {
-    Serial.println("serialization failed.");
+    applyPatch(last->patch.values, command.patch);
+    last->patch.mask |= command.patch.mask;
+    deferCommandResponse(last->action, last->id, RESULT_COALESCED);
+    strlcpy(last->id, command.id, sizeof(last->id));
+    return;
   }
 
-  if (doc != NULL && doc.containsKey(ACTION_KEY))
+  if (!commandQueue.push(command))
   {
+    Serial.println("command queue full, command dropped.");
+    deferCommandResponse(command.action, command.id, RESULT_QUEUE_FULL);
+  }
+}
 
-    if (strcmp(doc[ACTION_KEY], ACTION_TARE) == 0)
+/**
+ * @brief Starts the oldest queued command once no flow is running.
+ */
+void runQueuedCommand()
+{
+  QueuedCommand command;
+  if (isBusy() || !commandQueue.pop(command))
+    return;
+
+  strlcpy(commandId, command.id, sizeof(commandId));
+  if (command.mode == RunMode::Configure)
+    applyPatch(config, command.patch);
+  else if (command.mode == RunMode::WriteTag)
+    wTag = command.tag;
+  setRunMode(command.mode);
+}
+
+/**
+ * @brief Handles the tare action.
+ */
+void onTare(JsonObject command)
+{
+  enqueueCommand(newCommand(ACTION_TARE, RunMode::Tare, command));
+}
+
+/**
+ * @brief Handles the calibrate action, calibration results aren't commands.
+ */
+void onCalibrate(JsonObject command)
+{
+  if (!command.containsKey("result"))
+    enqueueCommand(newCommand(ACTION_CALIBRATE, RunMode::Calibrate, command));
+}
+
+/**
+ * @brief Handles the configure action, only the given keys change the configuration.
+ */
+void onConfigure(JsonObject command)
+{
+  QueuedCommand queued = newCommand(ACTION_CONFIGURE, RunMode::Configure, command);
+
+  JsonObject scaleJson = command["scale"];
+  if (scaleJson != NULL)
+  {
+    // instead of using containsKey() and accessing the value via key, we save ONE key lookup by using ArduinoJSONs default values.
+    long loadcellCalibration = scaleJson["calibration"];
+    unsigned long loadcellKnownWeight = scaleJson["known_weight"];
+    unsigned long loadcellMeasurementIntervall = scaleJson["update_interval"];
+    uint8_t loadcellMeasurementSampling = scaleJson["sampling_size"];
+    float loadcellStabilityThreshold = scaleJson["stability_threshold"];
+    unsigned long loadcellStabilityHold = scaleJson["stability_hold"];
+
+    if (loadcellCalibration != 0)
     {
-      currentMode = RunMode::Tare;
+      PATCH_FIELD(queued.patch, FieldLoadcellCalibration, loadcellCalibration, loadcellCalibration);
     }
-    else if (strcmp(doc[ACTION_KEY], ACTION_CALIBRATE) == 0)
+    if (loadcellKnownWeight != 0)
     {
-      if (!doc.containsKey("result"))
-        currentMode = RunMode::Calibrate;
+      PATCH_FIELD(queued.patch, FieldLoadcellKnownWeight, loadcellKnownWeight, loadcellKnownWeight);
     }
-    else if (strcmp(doc[ACTION_KEY], ACTION_CONFIGURE) == 0)
+    if (loadcellMeasurementIntervall != 0)
     {
-      JsonObject scaleJson = doc["scale"];
-      if (scaleJson != NULL)
-      {
-        // instead of using containsKey() and accessing the value via key, we save ONE key lookup by using ArduinoJSONs default values.
-        long loadcellCalibration = scaleJson["calibration"];
-        unsigned long loadcellKnownWeight = scaleJson["known_weight"];
-        unsigned long loadcellMeasurementIntervall = scaleJson["update_interval"];
-        uint8_t loadcellMeasurementSampling = scaleJson["sampling_size"];
-
-        if (loadcellCalibration != 0)
-        {
-          config.loadcellCalibration = loadcellCalibration;
-        }
-        if (loadcellKnownWeight != 0)
-        {
-          config.loadcellKnownWeight = loadcellKnownWeight;
-        }
-        if (loadcellMeasurementIntervall != 0)
-        {
-          config.loadcellMeasurementIntervall = loadcellMeasurementIntervall;
-        }
-        if (loadcellMeasurementSampling != 0)
-        {
-          config.loadcellMeasurementSampling = loadcellMeasurementSampling;
-        }
-      }
+      PATCH_FIELD(queued.patch, FieldLoadcellMeasurementIntervall, loadcellMeasurementIntervall, loadcellMeasurementIntervall);
+    }
+    if (loadcellMeasurementSampling != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldLoadcellMeasurementSampling, loadcellMeasurementSampling, loadcellMeasurementSampling);
+    }
+    if (loadcellStabilityThreshold != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldStabilityThreshold, loadcellStabilityThreshold, loadcellStabilityThreshold);
+    }
+    if (loadcellStabilityHold != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldStabilityHold, loadcellStabilityHold, loadcellStabilityHold);
+    }
 
-      JsonObject display = doc["display"];
-      if (display != NULL)
-      {
-        // can't use the efficient way, as a display_timeout of zero and ArduinoJson type defaults are not necessarily the same thing
-        // unsigned long timeout = display["display_timeout"];
-        // if (timeout != 0) config.displayTimeout = timeout;
-        if (display.containsKey("display_timeout"))
-        {
-          config.displayTimeout = display["display_timeout"];
-        }
-      }
+    JsonObject filterJson = scaleJson["filter"];
+    if (filterJson != NULL)
+    {
+      // zero disables a stage, so the keys have to be checked
+      if (filterJson.containsKey("median"))
+        PATCH_FIELD(queued.patch, FieldFilterMedian, loadcellFilter.medianWindow, filterJson["median"]);
+      if (filterJson.containsKey("hampel"))
+        PATCH_FIELD(queued.patch, FieldFilterHampel, loadcellFilter.hampelThreshold, filterJson["hampel"]);
+      if (filterJson.containsKey("kalman_q"))
+        PATCH_FIELD(queued.patch, FieldFilterKalmanQ, loadcellFilter.kalmanQ, filterJson["kalman_q"]);
+      if (filterJson.containsKey("kalman_r"))
+        PATCH_FIELD(queued.patch, FieldFilterKalmanR, loadcellFilter.kalmanR, filterJson["kalman_r"]);
+      if (filterJson.containsKey("ema"))
+        PATCH_FIELD(queued.patch, FieldFilterEma, loadcellFilter.emaAlpha, filterJson["ema"]);
+    }
+  }
 
-      JsonObject rfidJson = doc["rfid"];
-      if (rfidJson != NULL)
-      {
-        unsigned long rfidDecay = rfidJson["decay"];
-        if (rfidDecay != 0)
-        {
-          config.rfidDecay = rfidDecay;
-        }
-      }
+  JsonObject statusJson = command["status"];
+  if (statusJson != NULL)
+  {
+    const char *statusMode = statusJson["mode"];
+    unsigned long statusKeepalive = statusJson["keepalive"];
+    uint8_t statusBatchSize = statusJson["batch_size"];
+    unsigned long statusBatchInterval = statusJson["batch_interval"];
+    if (statusMode != NULL)
+    {
+      PATCH_FIELD(queued.patch, FieldStatusMode, statusMode, parseStatusMode(statusMode));
+    }
+    if (statusKeepalive != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldStatusKeepalive, statusKeepalive, statusKeepalive);
+    }
+    if (statusBatchSize != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldStatusBatchSize, statusBatchSize, statusBatchSize < STATUS_BATCH_MAX ? statusBatchSize : STATUS_BATCH_MAX);
+    }
+    if (statusBatchInterval != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldStatusBatchInterval, statusBatchInterval, statusBatchInterval);
+    }
+  }
 
-      currentMode = RunMode::Configure;
+  JsonObject payloadJson = command["payload"];
+  if (payloadJson != NULL)
+  {
+    const char *payloadFormat = payloadJson["format"];
+    if (payloadFormat != NULL)
+    {
+      PATCH_FIELD(queued.patch, FieldPayloadFormat, payloadFormat, parsePayloadFormat(payloadFormat));
     }
-    else if (strcmp(doc[ACTION_KEY], ACTION_WRITETAG) == 0)
+  }
+
+  JsonObject display = command["display"];
+  if (display != NULL)
+  {
+    // can't use the efficient way, as a display_timeout of zero and ArduinoJson type defaults are not necessarily the same thing
+    // unsigned long timeout = display["display_timeout"];
+    // if (timeout != 0) config.displayTimeout = timeout;
+    if (display.containsKey("display_timeout"))
     {
-      Serial.println("write-tag action started");
-      JsonObject tagJson = doc["tag"];
-      if (tagJson != NULL)
-      {
-        // support for char and char* is not implemented in ArduinoJson 6.18+, so we have to use String
-        String spoolId = tagJson["spool_id"];
-        unsigned long spoolWeight = tagJson["spool_weight"];
-        String material = tagJson["material"];
-        String color = tagJson["color"];
-        String manufacturer = tagJson["manufacturer"];
-        String spoolName = tagJson["spool_name"];
-        unsigned long timestamp = tagJson["timestamp"];
-
-        Serial.printf("SpoolId: ");
-        Serial.print(spoolId);
-        Serial.println();
-
-        if (spoolId.isEmpty())
-        {
-          Serial.println("spool id is empty");
-          return; // early exit because we need a spool id from the backend
-        }
-        else
-        {
-          wTag.spoolId = spoolId;
-        }
-
-        if(spoolWeight != 0)
-          wTag.spoolWeight = spoolWeight;
-        if (!material.isEmpty())
-          wTag.material = material;
-        if (!color.isEmpty())
-          wTag.color = color;
-        if (!manufacturer.isEmpty())
-          wTag.manufacturer = manufacturer;
-        if (!spoolName.isEmpty())
-          wTag.spoolName = spoolName;
-        if (timestamp != 0)
-          wTag.timestamp = timestamp;
-      }
+      PATCH_FIELD(queued.patch, FieldDisplayTimeout, displayTimeout, display["display_timeout"]);
+    }
+    unsigned long flushInterval = display["flush_interval"];
+    if (flushInterval != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldDisplayFlushInterval, displayFlushInterval, flushInterval);
+    }
+    unsigned long historyInterval = display["history_interval"];
+    if (historyInterval != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldDisplayHistoryInterval, displayHistoryInterval, historyInterval);
+    }
+  }
 
-      currentMode = RunMode::WriteTag;
+  JsonObject rfidJson = command["rfid"];
+  if (rfidJson != NULL)
+  {
+    unsigned long rfidDecay = rfidJson["decay"];
+    unsigned long rfidPollIdle = rfidJson["idle_interval"];
+    unsigned long rfidPollBurst = rfidJson["burst_interval"];
+    unsigned long rfidBurstDuration = rfidJson["burst_duration"];
+    unsigned long rfidStepThreshold = rfidJson["step_threshold"];
+    if (rfidDecay != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldRfidDecay, rfidDecay, rfidDecay);
+    }
+    if (rfidPollIdle != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldRfidPollIdle, rfidPollIdle, rfidPollIdle);
+    }
+    if (rfidPollBurst != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldRfidPollBurst, rfidPollBurst, rfidPollBurst);
+    }
+    if (rfidBurstDuration != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldRfidBurstDuration, rfidBurstDuration, rfidBurstDuration);
     }
-    else if (strcmp(doc[ACTION_KEY], ACTION_TEST) == 0)
+    if (rfidStepThreshold != 0)
     {
-      currentMode = RunMode::Test;
+      PATCH_FIELD(queued.patch, FieldRfidStepThreshold, rfidStepThreshold, rfidStepThreshold);
     }
   }
-};
+
+  JsonObject journalJson = command["journal"];
+  if (journalJson != NULL)
+  {
+    unsigned long journalDrainInterval = journalJson["drain_interval"];
+    if (journalDrainInterval != 0)
+    {
+      PATCH_FIELD(queued.patch, FieldJournalDrainInterval, journalDrainInterval, journalDrainInterval);
+    }
+  }
+
+  enqueueCommand(queued);
+}
+
+/**
+ * @brief Handles the write-tag action, the tag fields are copied into the queued command.
+ */
+void onWriteTag(JsonObject command)
+{
+  Serial.println("write-tag action received");
+  QueuedCommand queued = newCommand(ACTION_WRITETAG, RunMode::WriteTag, command);
+  TagData &tag = queued.tag;
+  JsonObject tagJson = command["tag"];
+  if (tagJson == NULL)
+  {
+    Serial.println("tag is missing");
+    deferCommandResponse(queued.action, queued.id, RESULT_TAG_MISSING);
+    return;
+  }
+
+  // the strings point into the MQTT payload, they are copied into the fixed buffers of the tag
+  const char *spoolId = tagJson["spool_id"];
+  unsigned long spoolWeight = tagJson["spool_weight"];
+  const char *material = tagJson["material"];
+  const char *color = tagJson["color"];
+  const char *manufacturer = tagJson["manufacturer"];
+  const char *spoolName = tagJson["spool_name"];
+  unsigned long timestamp = tagJson["timestamp"];
+
+  Serial.printf("SpoolId: ");
+  Serial.print(spoolId != NULL ? spoolId : "");
+  Serial.println();
+
+  if (spoolId == NULL || !Conversion::parseUuid(spoolId, tag.spoolId))
+  {
+    Serial.println("spool id is empty or invalid");
+    deferCommandResponse(queued.action, queued.id, RESULT_INVALID_SPOOL_ID);
+    return; // early exit because we need a spool id from the backend
+  }
+
+  if(spoolWeight != 0)
+    tag.spoolWeight = spoolWeight;
+  if (material != NULL && material[0] != '\0')
+    strlcpy(tag.material, material, sizeof(tag.material));
+  if (color != NULL && color[0] != '\0')
+    strlcpy(tag.color, color, sizeof(tag.color));
+  if (manufacturer != NULL && manufacturer[0] != '\0')
+    strlcpy(tag.manufacturer, manufacturer, sizeof(tag.manufacturer));
+  if (spoolName != NULL && spoolName[0] != '\0')
+    strlcpy(tag.spoolName, spoolName, sizeof(tag.spoolName));
+  if (timestamp != 0)
+    tag.timestamp = timestamp;
+
+  enqueueCommand(queued);
+}
+
+/**
+ * @brief Handles the test action.
+ */
+void onTest(JsonObject command)
+{
+  enqueueCommand(newCommand(ACTION_TEST, RunMode::Test, command));
+}
+
+CommandDecoder commands(ACTION_KEY);
+
+/**
+ * Callback function for MQTT messages. Decodes the message payload in place and dispatches it to the handler of its "action" key.
+ * @param topic The MQTT topic the message was received on.
+ * @param payload The message payload.
+ * @param length The length of the message payload.
+ */
+void mqttCb(char *topic, byte *payload, unsigned int length)
+{
+  // the handlers only queue the commands and their responses, the running flow and the data it works on stay
+  // untouched and nothing is published while the command points into the buffer of PubSubClient
+  commands.dispatch(payload, length);
+}
+
+/**
+ * @brief Registers the command handlers and the keys they read.
+ */
+void initCommands()
+{
+  commands.on(ACTION_TARE, onTare);
+  commands.on(ACTION_CALIBRATE, onCalibrate);
+  commands.on(ACTION_CONFIGURE, onConfigure);
+  commands.on(ACTION_WRITETAG, onWriteTag);
+  commands.on(ACTION_TEST, onTest);
+
+  const char *keys[] = {"id", "result", "scale", "status", "payload", "display", "rfid", "journal", "tag"};
+  for (const char *key : keys)
+    commands.keep(key);
+}
 
 /**
  * Callback function for RFID tag data. Prints the tag data to the serial console for debugging purposes.
@@ -207,9 +658,12 @@ void rfidCb(TagData &data)
     rTag = data;
     lastTagRead = millis();
 
+    char uuid[UUID_STRING_SIZE];
+    Conversion::byteToUuid(rTag.spoolId, uuid);
+
     Serial.println("CB Tagdata");
     Serial.printf("SpoolId ");
-    Serial.print(rTag.spoolId);
+    Serial.print(uuid);
     Serial.println();
     Serial.printf("Spool Weight ");
     Serial.print(rTag.spoolWeight);
@@ -235,6 +689,80 @@ MqttClient mqttClient(WIFI_SSID, WIFI_PASSWORD, MQTT_BROKER, MQTT_PORT, MQTT_USE
 
 char statusTopic[128], heartbeatTopic[128], commandTopic[128], responseTopic[128];
 
+/**
+ * @brief Builds the MQTT topics, the outgoing ones carry the suffix of the payload format.
+ */
+void buildTopics()
+{
+  statusTopic[0] = heartbeatTopic[0] = commandTopic[0] = responseTopic[0] = '\0';
+  MqttClient::buildTopic(MQTT_TOPIC, "status", MQTT_CLIENTID, statusTopic);
+  MqttClient::buildTopic(MQTT_TOPIC, "heartbeat", MQTT_CLIENTID, heartbeatTopic);
+  MqttClient::buildTopic(MQTT_TOPIC, "command", MQTT_CLIENTID, commandTopic);
+  MqttClient::buildTopic(MQTT_TOPIC, "response", MQTT_CLIENTID, responseTopic);
+
+  if (config.payloadFormat == PayloadFormat::MsgPack)
+  {
+    const char *suffix = PAYLOAD_FORMAT_MSGPACK;
+    strlcat(statusTopic, "/", sizeof(statusTopic));
+    strlcat(statusTopic, suffix, sizeof(statusTopic));
+    strlcat(heartbeatTopic, "/", sizeof(heartbeatTopic));
+    strlcat(heartbeatTopic, suffix, sizeof(heartbeatTopic));
+    strlcat(responseTopic, "/", sizeof(responseTopic));
+    strlcat(responseTopic, suffix, sizeof(responseTopic));
+  }
+  mqttClient.setHeartbeatTopic(heartbeatTopic);
+}
+
+/**
+ * @brief Streams a JsonDocument in the configured payload format, the payloadWriter of publishDocument().
+ */
+void writeDocument(Print &out, const void *context)
+{
+  const JsonDocument &doc = *(const JsonDocument *)context;
+  if (config.payloadFormat == PayloadFormat::MsgPack)
+    serializeMsgPack(doc, out);
+  else
+    serializeJson(doc, out);
+}
+
+/**
+ * @brief Publishes a document in the configured payload format, streamed without a payload buffer.
+ * @param topic Topic to publish to.
+ * @param doc The document.
+ * @return True if the message was published, false otherwise.
+ */
+bool publishDocument(const char *topic, const JsonDocument &doc)
+{
+  size_t length = config.payloadFormat == PayloadFormat::MsgPack ? measureMsgPack(doc) : measureJson(doc);
+  return mqttClient.publish(topic, length, writeDocument, &doc);
+}
+
+/**
+ * @brief Fills the common keys of a command response, the correlation id is echoed if the command had one.
+ */
+void initResponse(JsonDocument &doc, const char *action, const char *id)
+{
+  doc["device_id"] = MQTT_CLIENTID;
+  doc[ACTION_KEY] = action;
+  if (id[0] != '\0')
+    doc["id"] = id;
+}
+
+/**
+ * @brief Publishes the responses the command handlers queued, e.g. for commands that were dropped.
+ */
+void publishDeferredResponses()
+{
+  DeferredResponse response;
+  while (responseQueue.pop(response))
+  {
+    StaticJsonDocument<256> doc;
+    initResponse(doc, response.action, response.id);
+    doc["result"] = response.result;
+    publishDocument(responseTopic, doc);
+  }
+}
+
 /**
  * @brief Initializes the configuration struct with default values.
  */
@@ -242,11 +770,32 @@ void intializeConfiguration()
 {
   preferences.begin("smartmass", true);
   config.displayTimeout = preferences.getULong("d_timeout", DISPLAY_TIMEOUT);
+  config.displayFlushInterval = preferences.getULong("d_flush", DISPLAY_FLUSH_INTERVAL);
+  config.displayHistoryInterval = preferences.getULong("d_history", DISPLAY_HISTORY_INTERVAL);
   config.loadcellCalibration = preferences.getLong("lc_calibr", LOADCELL_CALIBRATION);
   config.loadcellKnownWeight = preferences.getULong("lc_weight", LOADCELL_KNOWN_WEIGHT);
   config.loadcellMeasurementIntervall =  preferences.getULong("lc_interval", LOADCELL_MEASUREMENT_INTERVAL);
   config.loadcellMeasurementSampling = preferences.getInt("lc_sampling", LOADCELL_MEASUREMENT_SAMPLING);
+  config.loadcellFilter.medianWindow = preferences.getUChar("lc_f_median", LOADCELL_FILTER_MEDIAN);
+  config.loadcellFilter.hampelThreshold = preferences.getFloat("lc_f_hampel", LOADCELL_FILTER_HAMPEL);
+  config.loadcellFilter.kalmanQ = preferences.getFloat("lc_f_kq", LOADCELL_FILTER_KALMAN_Q);
+  config.loadcellFilter.kalmanR = preferences.getFloat("lc_f_kr", LOADCELL_FILTER_KALMAN_R);
+  config.loadcellFilter.emaAlpha = preferences.getFloat("lc_f_ema", LOADCELL_FILTER_EMA);
+  config.loadcellStabilityThreshold = preferences.getFloat("lc_st_thresh", LOADCELL_STABILITY_THRESHOLD);
+  config.loadcellStabilityHold = preferences.getULong("lc_st_hold", LOADCELL_STABILITY_HOLD);
+  config.statusMode = preferences.getUChar("st_mode", parseStatusMode(MQTT_STATUS_MODE));
+  config.statusKeepalive = preferences.getULong("st_keepalive", MQTT_STATUS_KEEPALIVE);
+  config.payloadFormat = preferences.getUChar("pl_format", parsePayloadFormat(MQTT_PAYLOAD_FORMAT));
+  config.statusBatchSize = preferences.getUChar("st_batch", MQTT_STATUS_BATCH_SIZE);
+  if (config.statusBatchSize == 0 || config.statusBatchSize > STATUS_BATCH_MAX)
+    config.statusBatchSize = STATUS_BATCH_MAX;
+  config.statusBatchInterval = preferences.getULong("st_batch_int", MQTT_STATUS_BATCH_INTERVAL);
   config.rfidDecay = preferences.getULong("rfid_decay", RFID_DECAY);
+  config.rfidPollIdle = preferences.getULong("rfid_idle", RFID_POLL_IDLE);
+  config.rfidPollBurst = preferences.getULong("rfid_burst", RFID_POLL_BURST);
+  config.rfidBurstDuration = preferences.getULong("rfid_burst_dur", RFID_BURST_DURATION);
+  config.rfidStepThreshold = preferences.getULong("rfid_step", RFID_STEP_THRESHOLD);
+  config.journalDrainInterval = preferences.getULong("jr_drain", JOURNAL_DRAIN_INTERVAL);
 
   preferences.end();
 }
@@ -257,7 +806,7 @@ void intializeConfiguration()
 void setRunModeMeasure()
 {
   modeSwitch = true;
-  currentMode = RunMode::Measure;
+  setRunMode(RunMode::Measure);
 }
 
 /**
@@ -269,7 +818,7 @@ void setRunModeError(const char *module, const char *msg)
   displayError.msg = msg;
   display.showErrorMessage(displayError);
 
-  currentMode = RunMode::Error;
+  setRunMode(RunMode::Error);
 }
 
 /**
@@ -277,16 +826,25 @@ void setRunModeError(const char *module, const char *msg)
  */
 void initializeDevice()
 {
-  display.showInitMessage();
-  delay(3000);
-  if (scale.isReady())
-  {
-    display.showMessage(MESSAGE_SCALE_READY);
-    setRunModeMeasure();
-  }
-  else
+  switch (flowStep)
   {
-    setRunModeError(MODULE_SCALE, ERROR_SCALE_NOT_READY);
+  case 0:
+    display.showInitMessage();
+    nextFlowStep();
+    break;
+  case 1:
+    if (!flowStepElapsed(3000))
+      break;
+    if (scale.isReady())
+    {
+      display.showMessage(MESSAGE_SCALE_READY);
+      setRunModeMeasure();
+    }
+    else
+    {
+      setRunModeError(MODULE_SCALE, ERROR_SCALE_NOT_READY);
+    }
+    break;
   }
 }
 
@@ -295,31 +853,85 @@ void initializeDevice()
  */
 void calibrateDevice()
 {
-  display.showTitle(TITLE_CALIBRATION);
-  delay(1500);
-  display.showMessage(MESSAGE_CALIBRATION_START);
-  delay(2500);
-  display.showMessage(MESSAGE_TARE_START);
-  delay(5000);
-  scale.calibrationStep01();
-  display.showMessage(MESSAGE_CALIBRATION_KNOWN_WEIGHT);
-  delay(5000);
-  long result = scale.calibrationStep02(config.loadcellKnownWeight);
-  display.showCalibrationMessage(result);
+  switch (flowStep)
+  {
+  case 0:
+    display.showTitle(TITLE_CALIBRATION);
+    nextFlowStep();
+    break;
+  case 1:
+    if (flowStepElapsed(1500))
+    {
+      display.showMessage(MESSAGE_CALIBRATION_START);
+      nextFlowStep();
+    }
+    break;
+  case 2:
+    if (flowStepElapsed(2500))
+    {
+      display.showMessage(MESSAGE_TARE_START);
+      nextFlowStep();
+    }
+    break;
+  case 3:
+    if (flowStepElapsed(5000))
+    {
+      scale.beginCalibrationStep01();
+      nextFlowStep();
+    }
+    break;
+  case 4:
+    switch (scale.poll())
+    {
+    case Scale::JobState::Done:
+      display.showMessage(MESSAGE_CALIBRATION_KNOWN_WEIGHT);
+      nextFlowStep();
+      break;
+    case Scale::JobState::Failed:
+      setRunModeError(MODULE_SCALE, ERROR_SCALE_NOT_READY);
+      break;
+    default:
+      break;
+    }
+    break;
+  case 5:
+    if (flowStepElapsed(5000))
+    {
+      scale.beginCalibrationStep02(config.loadcellKnownWeight);
+      nextFlowStep();
+    }
+    break;
+  case 6:
+    switch (scale.poll())
+    {
+    case Scale::JobState::Done:
+    {
+      long result = scale.getCalibration();
+      display.showCalibrationMessage(result);
 
-  // TODO: writing calibration data immediately? yes/no?
-  // config.loadcellCalibration = result;
+      // TODO: writing calibration data immediately? yes/no?
+      // config.loadcellCalibration = result;
 
-  StaticJsonDocument<256> doc;
-  char buffer[256];
-  doc["device_id"] = MQTT_CLIENTID;
-  doc[ACTION_KEY] = "calibrate";
-  doc["result"] = result;
-  serializeJson(doc, buffer);
-  mqttClient.publish(responseTopic, buffer);
+      StaticJsonDocument<256> doc;
+      initResponse(doc, ACTION_CALIBRATE, commandId);
+      doc["result"] = result;
+      publishDocument(responseTopic, doc);
 
-  delay(5000);
-  setRunModeMeasure();
+      nextFlowStep();
+      break;
+    }
+    case Scale::JobState::Failed:
+      setRunModeError(MODULE_SCALE, ERROR_SCALE_NOT_READY);
+      break;
+    default:
+      break;
+    }
+    break;
+  case 7:
+    if (flowStepElapsed(5000))
+      setRunModeMeasure();
+    break;
+  }
 }
 
 /**
@@ -327,71 +939,266 @@ void calibrateDevice()
  */
 void configureDevice()
 {
-  display.showTitle(TITLE_CONFIGURATION);
-  delay(1500);
+  switch (flowStep)
+  {
+  case 0:
+    display.showTitle(TITLE_CONFIGURATION);
+    nextFlowStep();
+    break;
+  case 1:
+    if (!flowStepElapsed(1500))
+      break;
+
+    preferences.begin("smartmass", false);
+    preferences.putULong("d_timeout", config.displayTimeout);
+    preferences.putULong("d_flush", config.displayFlushInterval);
+    preferences.putULong("d_history", config.displayHistoryInterval);
+    preferences.putLong("lc_calibr", config.loadcellCalibration);
+    preferences.putULong("lc_weight", config.loadcellKnownWeight);
+    preferences.putULong("lc_interval", config.loadcellMeasurementIntervall);
+    preferences.putInt("lc_sampling", config.loadcellMeasurementSampling);
+    preferences.putUChar("lc_f_median", config.loadcellFilter.medianWindow);
+    preferences.putFloat("lc_f_hampel", config.loadcellFilter.hampelThreshold);
+    preferences.putFloat("lc_f_kq", config.loadcellFilter.kalmanQ);
+    preferences.putFloat("lc_f_kr", config.loadcellFilter.kalmanR);
+    preferences.putFloat("lc_f_ema", config.loadcellFilter.emaAlpha);
+    preferences.putFloat("lc_st_thresh", config.loadcellStabilityThreshold);
+    preferences.putULong("lc_st_hold", config.loadcellStabilityHold);
+    preferences.putUChar("st_mode", config.statusMode);
+    preferences.putULong("st_keepalive", config.statusKeepalive);
+    preferences.putUChar("pl_format", config.payloadFormat);
+    preferences.putUChar("st_batch", config.statusBatchSize);
+    preferences.putULong("st_batch_int", config.statusBatchInterval);
+    preferences.putULong("rfid_idle", config.rfidPollIdle);
+    preferences.putULong("rfid_burst", config.rfidPollBurst);
+    preferences.putULong("rfid_burst_dur", config.rfidBurstDuration);
+    preferences.putULong("rfid_step", config.rfidStepThreshold);
+    preferences.putULong("jr_drain", config.journalDrainInterval);
+    preferences.end();
+
+    display.setScreenTimeOut(config.displayTimeout);
+    display.setFlushInterval(config.displayFlushInterval);
+    history.setInterval(config.displayHistoryInterval);
+
+    Serial.printf("loadcell calibration: ");
+    Serial.print(config.loadcellCalibration);
+    Serial.println();
 
-  preferences.begin("smartmass", false);
-  preferences.putULong("d_timeout", config.displayTimeout);
-  preferences.putLong("lc_calibr", config.loadcellCalibration);
-  preferences.putULong("lc_weight", config.loadcellKnownWeight);
-  preferences.putULong("lc_interval", config.loadcellMeasurementIntervall);
-  preferences.putInt("lc_sampling", config.loadcellMeasurementSampling);
-  preferences.end();
+    Serial.printf("loadcell measurement intervall: ");
+    Serial.print(config.loadcellMeasurementIntervall);
+    Serial.println();
+    scale.setFilter(config.loadcellFilter);
+    scale.setStability(config.loadcellStabilityThreshold, config.loadcellStabilityHold);
+    rfid.setPolling(config.rfidPollIdle, config.rfidPollBurst, config.rfidBurstDuration);
+    buildTopics();
+
+    // the tare started by init() is finished by measure()
+    scale.init(config.loadcellCalibration, config.loadcellMeasurementIntervall);
+    nextFlowStep();
+    break;
+  case 2:
+    if (flowStepElapsed(1500))
+      setRunModeMeasure();
+    break;
+  }
+}
 
-  display.setScreenTimeOut(config.displayTimeout);
+/**
+ * @brief Tares the scale.
+ */
+void tare()
+{
+  switch (flowStep)
+  {
+  case 0:
+    display.showTitle(TITLE_TARE);
+    nextFlowStep();
+    break;
+  case 1:
+    if (flowStepElapsed(1000))
+    {
+      display.showMessage(MESSAGE_TARE_START);
+      nextFlowStep();
+    }
+    break;
+  case 2:
+    if (flowStepElapsed(1500))
+    {
+      scale.beginTare();
+      nextFlowStep();
+    }
+    break;
+  case 3:
+    switch (scale.poll())
+    {
+    case Scale::JobState::Done:
+      display.showMessage(MESSAGE_TARE_READY);
+      setRunModeMeasure();
+      break;
+    case Scale::JobState::Failed:
+      setRunModeError(MODULE_SCALE, ERROR_TARE_FAILED);
+      break;
+    default:
+      break;
+    }
+    break;
+  }
+}
 
-  Serial.printf("loadcell calibration: ");
-  Serial.print(config.loadcellCalibration);
-  Serial.println();
+/**
+ * @brief Writes a tag to the RFID reader.
+ */
+void writeTag()
+{
+  switch (flowStep)
+  {
+  case 0:
+    display.showTitle(TITLE_WRITETAG);
+    nextFlowStep();
+    break;
+  case 1:
+    if (flowStepElapsed(1500))
+    {
+      display.showMessage(MESSAGE_WRITETAG_START);
+      nextFlowStep();
+    }
+    break;
+  case 2:
+  {
+    if (!flowStepElapsed(5000))
+      break;
 
-  Serial.printf("loadcell measurement intervall: ");
-  Serial.print(config.loadcellMeasurementIntervall);
-  Serial.println();
-  scale.init(config.loadcellCalibration, config.loadcellMeasurementIntervall);
+    bool written = rfid.write(wTag);
+    RFID::WriteStatistics statistics = rfid.getWriteStatistics();
 
-  delay(1500);
+    StaticJsonDocument<256> doc;
+    initResponse(doc, ACTION_WRITETAG, commandId);
+    doc["result"] = written;
+    doc["written"] = statistics.written;
+    doc["skipped"] = statistics.skipped;
+    doc["verified"] = statistics.verified;
+    publishDocument(responseTopic, doc);
+
+    if (written)
+    {
+      display.showMessage(MESSAGE_WRITETAG_READY);
+      setRunModeMeasure();
+    }
+    else
+    {
+      setRunModeError(MODULE_RFID, ERROR_TAGWRITE_FAILED);
+    }
+    break;
+  }
+  }
+}
 
-  setRunModeMeasure();
+/**
+ * @brief Returns the current time in epoch seconds, 0 until it was synced by NTP.
+ */
+uint32_t epochTime()
+{
+  time_t now = time(nullptr);
+  return now > 1600000000 ? now : 0; // anything before 2020 is the unsynced clock
 }
 
 /**
- * @brief Tares the scale.
+ * @brief Publishes a status message on the status topic.
+ * @param record The status message.
+ * @param seq The journal sequence number of a replayed message, 0 for a live one.
+ * @return True if the message was published, false while offline.
  */
-void tare()
+bool publishStatus(StatusRecord &record, uint32_t seq)
 {
-  display.showTitle(TITLE_TARE);
-  delay(1000);
-  display.showMessage(MESSAGE_TARE_START);
-  delay(1500);
-  if (scale.tare())
+  StaticJsonDocument<256> doc;
+  char uuid[UUID_STRING_SIZE];
+  doc["device_id"] = MQTT_CLIENTID;
+  if (!Conversion::isEmptyUuid(record.spoolId))
   {
-    display.showMessage(MESSAGE_TARE_READY);
-    setRunModeMeasure();
+    Conversion::byteToUuid(record.spoolId, uuid);
+    doc["spool_id"] = (const char *)uuid; // not copied, the document is serialized below
   }
-  else
+  doc["value"] = record.value;
+  if (config.statusMode == StatusMode::Settled)
+  {
+    doc["stable"] = record.stable != 0;
+  }
+  if (record.ts != 0)
+  {
+    doc["ts"] = record.ts;
+  }
+  if (seq != 0)
   {
-    setRunModeError(MODULE_SCALE, ERROR_TARE_FAILED);
+    doc["seq"] = seq;
   }
+  return publishDocument(statusTopic, doc);
 }
 
 /**
- * @brief Writes a tag to the RFID reader.
+ * @brief Publishes the collected samples of the batch status mode as one message and starts a new batch.
+ *
+ * The first value is absolute, every further value and its "dt" are the differences to the previous sample. While
+ * offline, the samples are written to the journal one by one.
  */
-void writeTag()
+void flushStatusBatch()
 {
-  display.showTitle(TITLE_WRITETAG);
-  delay(1500);
-  display.showMessage(MESSAGE_WRITETAG_START);
-  delay(5000);
-  if (rfid.write(wTag))
+  if (statusBatch.count == 0)
+    return;
+
+  StaticJsonDocument<JSON_OBJECT_SIZE(5) + 2 * JSON_ARRAY_SIZE(STATUS_BATCH_MAX)> doc;
+  char uuid[UUID_STRING_SIZE];
+  doc["device_id"] = MQTT_CLIENTID;
+  if (!Conversion::isEmptyUuid(statusBatch.spoolId))
   {
-    display.showMessage(MESSAGE_WRITETAG_READY);
-    setRunModeMeasure();
+    Conversion::byteToUuid(statusBatch.spoolId, uuid);
+    doc["spool_id"] = (const char *)uuid; // not copied, the document is serialized below
   }
-  else
+  if (statusBatch.ts != 0)
+  {
+    doc["ts"] = statusBatch.ts;
+  }
+  JsonArray values = doc.createNestedArray("values");
+  JsonArray dt = doc.createNestedArray("dt");
+  for (uint8_t i = 0; i < statusBatch.count; i++)
   {
-    setRunModeError(MODULE_RFID, ERROR_TAGWRITE_FAILED);
+    values.add(i == 0 ? statusBatch.values[0] : statusBatch.values[i] - statusBatch.values[i - 1]);
+    dt.add(i == 0 ? 0 : statusBatch.offsets[i] - statusBatch.offsets[i - 1]);
   }
+  if (!publishDocument(statusTopic, doc))
+  {
+    StatusRecord record;
+    memcpy(record.spoolId, statusBatch.spoolId, sizeof(record.spoolId));
+    record.stable = 0;
+    for (uint8_t i = 0; i < statusBatch.count; i++)
+    {
+      record.ts = statusBatch.ts != 0 ? statusBatch.ts + statusBatch.offsets[i] / 1000 : 0;
+      record.value = statusBatch.values[i];
+      journal.append(&record, sizeof(record));
+    }
+  }
+  statusBatch.count = 0;
+}
+
+/**
+ * @brief Adds a sample to the batch status mode, a spool change publishes the previous batch first.
+ */
+void addStatusSample(long value, const byte *spoolId)
+{
+  if (statusBatch.count > 0 && memcmp(statusBatch.spoolId, spoolId, sizeof(statusBatch.spoolId)) != 0)
+    flushStatusBatch();
+
+  if (statusBatch.count == 0)
+  {
+    statusBatch.ts = epochTime();
+    statusBatch.start = millis();
+    memcpy(statusBatch.spoolId, spoolId, sizeof(statusBatch.spoolId));
+  }
+  statusBatch.values[statusBatch.count] = value;
+  statusBatch.offsets[statusBatch.count] = millis() - statusBatch.start;
+  statusBatch.count++;
+
+  if (statusBatch.count >= config.statusBatchSize)
+    flushStatusBatch();
 }
 
 /**
@@ -409,29 +1216,111 @@ void measure()
   unsigned long previousValue = measurement.result;
   scale.measure(measurement, config.loadcellMeasurementSampling);
 
+  // a spool change or a mode switch publishes the pending batch right away, a full or old batch is published as well
+  static const byte noSpool[16] = {};
+  const byte *currentSpool = millis() - lastTagRead < config.rfidDecay ? rTag.spoolId : noSpool;
+  if (statusBatch.count > 0 &&
+      (config.statusMode != StatusMode::Batch || memcmp(statusBatch.spoolId, currentSpool, sizeof(statusBatch.spoolId)) != 0 ||
+       millis() - statusBatch.start >= config.statusBatchInterval))
+  {
+    flushStatusBatch();
+  }
+
   if (measurement.ts > previousRun)
   {
     displayData.result = measurement.result;
     if (measurement.result != previousValue)
     {
       display.showMeasurement(displayData);
+    }
+    if (history.add(measurement.result, millis()))
+    {
+      display.updateHistory();
+    }
 
-      // TODO: contract JSON object
-      // https://arduinojson.org/v6/how-to/use-arduinojson-with-pubsubclient/
-      StaticJsonDocument<256> doc;
-      char buffer[256];
-      doc["device_id"] = MQTT_CLIENTID;
-      if(rTag.spoolId != NULL && millis() - lastTagRead < config.rfidDecay) {        
-        doc["spool_id"] = rTag.spoolId;
-      } 
-      doc["value"] = measurement.result;
-      serializeJson(doc, buffer);
+    // a new spool can only appear with a weight step, so the reader is polled fast for a while
+    if ((unsigned long)labs(measurement.result - rfidStepReference) >= config.rfidStepThreshold)
+    {
+      rfid.burst();
+      rfidStepReference = measurement.result;
+    }
+
+    long value = measurement.result;
+    bool publish = measurement.result != previousValue;
+    if (config.statusMode == StatusMode::Settled)
+    {
+      // only settled changes are published, the keepalive republishes the last settled value
+      value = measurement.settled;
+      publish = (measurement.stable && measurement.settled != lastStatusValue) || millis() - lastStatusPublish >= config.statusKeepalive;
+    }
 
-      mqttClient.publish(statusTopic, buffer);
+    if (publish && config.statusMode == StatusMode::Batch)
+    {
+      addStatusSample(value, currentSpool);
+      lastStatusValue = value;
+      lastStatusPublish = millis();
+    }
+    else if (publish)
+    {
+      StatusRecord record;
+      record.ts = epochTime();
+      record.value = value;
+      record.stable = measurement.stable;
+      memcpy(record.spoolId, currentSpool, sizeof(record.spoolId));
+
+      // while offline the message goes to the journal, in settled mode without a journal it is retried with the next measurement
+      if (publishStatus(record, 0) || journal.append(&record, sizeof(record)))
+      {
+        lastStatusValue = value;
+        lastStatusPublish = millis();
+      }
     }
   }
 }
 
+/**
+ * @brief Publishes the oldest journaled status message, at most one per drain interval.
+ */
+void drainJournal()
+{
+  if (journal.pending() == 0 || !mqttClient.isConnected() || millis() - lastJournalDrain < config.journalDrainInterval)
+    return;
+  lastJournalDrain = millis();
+
+  // peek() copies up to MAX_PAYLOAD bytes, more than a StatusRecord
+  byte payload[Journal::MAX_PAYLOAD];
+  uint8_t length;
+  uint32_t seq;
+  if (!journal.peek(payload, length, seq))
+    return;
+  // records of another layout can't be published, they are skipped
+  if (length != sizeof(StatusRecord))
+  {
+    journal.consume();
+    return;
+  }
+  StatusRecord record;
+  memcpy(&record, payload, sizeof(record));
+  if (publishStatus(record, seq))
+    journal.consume();
+}
+
+/**
+ * @brief Publishes the heartbeat with the runtime statistics, streamed like the other documents.
+ */
+bool heartbeatCb(const char *topic)
+{
+  StaticJsonDocument<256> doc;
+  doc["device_id"] = MQTT_CLIENTID;
+  doc[ACTION_KEY] = "heartbeat";
+  doc["status"] = "ok";
+  doc["rfid_poll_rate"] = rfid.getPollRate();
+  Display::Statistics displayStatistics = display.getStatistics();
+  doc["display_bytes"] = displayStatistics.flushes > 0 ? displayStatistics.bytes / displayStatistics.flushes : 0;
+  doc["display_dropped"] = displayStatistics.dropped;
+  return publishDocument(topic, doc);
+}
+
 /**
  * @brief Runs experiments for testing and debugging.
  */
@@ -457,6 +1346,9 @@ void runExperiments()
   // testing title display
   // display.showTitle(TITLE_CALIBRATION); // configuration should be the longest
 
+  // comparing the glyph atlas with the GFX text of the weight readout
+  display.benchmarkValue(-12345, 1000);
+
   delay(5000);
 }
 
@@ -469,22 +1361,29 @@ void setup()
 
   intializeConfiguration();
 
-  MqttClient::buildTopic(MQTT_TOPIC, "status", MQTT_CLIENTID, statusTopic);
-  MqttClient::buildTopic(MQTT_TOPIC, "heartbeat", MQTT_CLIENTID, heartbeatTopic);
-  MqttClient::buildTopic(MQTT_TOPIC, "command", MQTT_CLIENTID, commandTopic);
-  MqttClient::buildTopic(MQTT_TOPIC, "response", MQTT_CLIENTID, responseTopic);
+  buildTopics();
 
   display.init();
   display.setScreenTimeOut(config.displayTimeout);
+  display.setFlushInterval(config.displayFlushInterval);
+  history.setInterval(config.displayHistoryInterval);
+  display.setHistory(&history);
   displayData.title = DISPLAY_DATA_TITLE;
   displayData.unit = DISPLAY_DATA_UNIT;
 
+  scale.setFilter(config.loadcellFilter);
+  scale.setStability(config.loadcellStabilityThreshold, config.loadcellStabilityHold);
   scale.init(config.loadcellCalibration, config.loadcellMeasurementIntervall);
   measurement.ts = millis();
 
+  initCommands();
+  mqttClient.setHeartbeatCallback(heartbeatCb);
   mqttClient.init();
   mqttClient.subscribe(commandTopic);
+  configTime(0, 0, NTP_SERVER);
+  journal.begin();
 
+  rfid.setPolling(config.rfidPollIdle, config.rfidPollBurst, config.rfidBurstDuration);
   rfid.init(rfidCb);
 }
 
@@ -494,6 +1393,8 @@ void setup()
 void loop()
 {
 
+  runQueuedCommand();
+
   switch (currentMode)
   {
   case RunMode::Initialize:
@@ -509,15 +1410,14 @@ void loop()
     tare();
     break;
   case RunMode::WriteTag:
-    Serial.println("write tag loop");
     writeTag();
     break;
   case RunMode::Error:
     // TODO: error recovery, maybe re-init?
 
     // for now:
-    delay(5000);
-    setRunModeMeasure();
+    if (flowStepElapsed(5000))
+      setRunModeMeasure();
     break;
   case RunMode::Test:
     // This mode is used for testing and debugging various states.
@@ -532,6 +1432,8 @@ void loop()
   }
 
   mqttClient.loop();
+  publishDeferredResponses();
+  drainJournal();
   display.loop();
   rfid.loop();
 }
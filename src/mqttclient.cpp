@@ -11,77 +11,52 @@ MqttClient::MqttClient(const char *wifi_ssid, const char *wifi_password, const c
     mqttClientId = mqtt_clientid;
     callback = mqtt_callback;   
     buildTopic(mqtt_basetopic, "heartbeat", mqtt_clientid, mqttHeartbeatTopic);
-    sprintf(heartbeatPayload, "{\"device_id\":\"%s\",\"action\":\"heartbeat\",\"status\":\"ok\"}", mqtt_clientid);
 
     mqtt = new PubSubClient(wifi);
 }
 
-boolean MqttClient::wifiConnect()
+void MqttClient::setState(ConnectionState newState)
 {
-    if (WiFi.status() != WL_CONNECTED)
-    {
-        uint8_t attempt = RETRY_ATTEMPTS;
-        while (WiFi.status() != WL_CONNECTED && attempt)
-        {
-            WiFi.begin(wifiSsid, wifiPassword);
-            uint8_t timeout = RETRY_TIMEOUT;
-            while (timeout && (WiFi.status() != WL_CONNECTED))
-            {
-                timeout--;
-                delay(1000);
-            }
-            attempt--;
-        }
+    state = newState;
+    stateTs = millis();
+}
 
-        if (WiFi.status() != WL_CONNECTED)
-        {
-            Serial.println("WiFi connection attempts exhausted. Giving up.");
-            Serial.println();
-            return false;
-        } else {
-            Serial.printf("WiFi client IP: ");
-            Serial.print(WiFi.localIP());
-            Serial.println();
-            Serial.printf("RRSI: ");
-            Serial.print(WiFi.RSSI());
-            Serial.println();
-        }
-    }
-    return true;
+void MqttClient::retryLater()
+{
+    // full backoff plus up to half of it as jitter, so devices that lost the same AP don't reconnect in lockstep
+    backoff = retryDelay + random(retryDelay / 2 + 1);
+    retryDelay = retryDelay * 2 > RETRY_BACKOFF_MAX ? RETRY_BACKOFF_MAX : retryDelay * 2;
+    setState(ConnectionState::Offline);
+
+    Serial.printf("Reconnecting in %lu ms.", backoff);
+    Serial.println();
 }
 
-// TODO: non-blocking all the way! //https://github.com/knolleary/pubsubclient/blob/master/examples/mqtt_reconnect_nonblocking/mqtt_reconnect_nonblocking.ino
-boolean MqttClient::mqttConnect()
+void MqttClient::wifiConnect()
 {
-    if (!mqtt->connected())
-    {
-        mqtt->setCallback(callback);
-        mqtt->setSocketTimeout(MQTT_TIMEOUT);
-        mqtt->setBufferSize(512);
-        mqtt->setKeepAlive(MQTT_TIMEOUT);
-        mqtt->setServer(mqttBroker, mqttPort);
-
-        uint8_t attempt = RETRY_ATTEMPTS;
-        while (!mqtt->connected() && attempt)
-        {
-            mqtt->connect(mqttClientId, mqttUser, mqttPassword);
-            uint8_t timeout = RETRY_TIMEOUT;
-            while (!mqtt->connected() && timeout)
-            {
-                delay(1000);
-                timeout--;
-            }
-            attempt--;
-        }
+    WiFi.disconnect();
+    WiFi.begin(wifiSsid, wifiPassword);
+    setState(ConnectionState::WifiConnecting);
+}
 
-        if (!mqtt->connected())
-        {
-            Serial.println("MQTT connection attempts exhausted. Giving up.");
-            Serial.println();
-            return false;
-        }
+bool MqttClient::mqttConnect()
+{
+    // blocks for the DNS lookup of a hostname, the TCP connect and up to MQTT_SOCKET_TIMEOUT for the CONNACK
+    if (!mqtt->connect(mqttClientId, mqttUser, mqttPassword))
+    {
+        Serial.printf("MQTT connection failed, state %d.", mqtt->state());
+        Serial.println();
+        return false;
     }
 
+    for (uint8_t i = 0; i < subscriptionCount; i++)
+    {
+        mqtt->subscribe(subscriptions[i], 0);
+        Serial.print(millis());
+        Serial.printf(" - subscribed to topic ");
+        Serial.print(subscriptions[i]);
+        Serial.println();
+    }
     return true;
 }
 
@@ -92,21 +67,93 @@ void MqttClient::emitHeartbeat()
     {
         lastHeartbeat = now;       
         
-        publish(mqttHeartbeatTopic, heartbeatPayload);
+        if (heartbeatCb != nullptr)
+            heartbeatCb(mqttHeartbeatTopic);
+        else
+            publish(mqttHeartbeatTopic, strlen(HEARTBEAT_PREFIX) + strlen(mqttClientId) + strlen(HEARTBEAT_SUFFIX), writeHeartbeat, mqttClientId);
         // Serial.print(now);
         // Serial.printf(" - emitted hearbeat");
         // Serial.println();
     }
 }
 
+void MqttClient::writeHeartbeat(Print &out, const void *context)
+{
+    out.print(HEARTBEAT_PREFIX);
+    out.print((const char *)context);
+    out.print(HEARTBEAT_SUFFIX);
+}
+
 void MqttClient::loop()
 {
-    if (wifiConnect() && mqttConnect()) {
+    switch (state)
+    {
+    case ConnectionState::Offline:
+        if (millis() - stateTs < backoff)
+            break;
+        if (WiFi.status() == WL_CONNECTED)
+            setState(ConnectionState::MqttConnecting);
+        else
+            wifiConnect();
+        break;
+    case ConnectionState::WifiConnecting:
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            Serial.printf("WiFi client IP: ");
+            Serial.print(WiFi.localIP());
+            Serial.println();
+            Serial.printf("RRSI: ");
+            Serial.print(WiFi.RSSI());
+            Serial.println();
+            setState(ConnectionState::MqttConnecting);
+        }
+        else if (millis() - stateTs >= WIFI_CONNECT_TIMEOUT)
+        {
+            Serial.println("WiFi connection attempt timed out.");
+            retryLater();
+        }
+        break;
+    case ConnectionState::MqttConnecting:
+        if (WiFi.status() != WL_CONNECTED)
+        {
+            retryLater();
+        }
+        else if (mqttConnect())
+        {
+            Serial.println("Connected to MQTT broker.");
+            retryDelay = RETRY_BACKOFF_MIN;
+            setState(ConnectionState::Connected);
+        }
+        else
+        {
+            retryLater();
+        }
+        break;
+    case ConnectionState::Connected:
+        if (WiFi.status() != WL_CONNECTED || !mqtt->connected())
+        {
+            Serial.println("Connection to MQTT broker lost.");
+            retryDelay = RETRY_BACKOFF_MIN;
+            backoff = 0; // the first attempt after a loss starts right away
+            setState(ConnectionState::Offline);
+            break;
+        }
         emitHeartbeat();
         mqtt->loop();
+        break;
     }
 }
 
+bool MqttClient::isConnected()
+{
+    return state == ConnectionState::Connected;
+}
+
+MqttClient::ConnectionState MqttClient::getState()
+{
+    return state;
+}
+
 void MqttClient::disconnect()
 {
     if (mqtt->connected())
@@ -115,32 +162,129 @@ void MqttClient::disconnect()
         Serial.println("Disconnected from MQTT broker.");
         Serial.println();
     }
+    setState(ConnectionState::Offline);
 }
+
 void MqttClient::init()
 {
-    if (wifiConnect() && mqttConnect())
-        Serial.println("Connected to MQTT broker.");
-    else
-        Serial.println("Failed to connect to MQTT broker.");
+    mqtt->setCallback(callback);
+    mqtt->setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+    mqtt->setBufferSize(MQTT_INBOUND_BUFFER_SIZE);
+    mqtt->setKeepAlive(MQTT_TIMEOUT);
+    mqtt->setServer(mqttBroker, mqttPort);
 
-    Serial.println();
+    WiFi.mode(WIFI_STA);
+    backoff = 0;
+    setState(ConnectionState::Offline);
+    loop();
+}
+
+bool MqttClient::publish(const char *topic, const char *payload)
+{
+    return publish(topic, (const uint8_t *)payload, strlen(payload));
 }
 
-void MqttClient::publish(const char *topic, const char *payload)
+bool MqttClient::publish(const char *topic, const uint8_t *payload, size_t length)
 {
-    if (wifiConnect() && mqttConnect())
+    if (!isConnected())
+        return logPublish(topic, false);
+
+    // written straight to the socket instead of being copied into the buffer of PubSubClient
+    bool result = mqtt->beginPublish(topic, length, false) && mqtt->write(payload, length) == length && mqtt->endPublish() == 1;
+    return logPublish(topic, result);
+}
+
+bool MqttClient::publish(const char *topic, size_t length, payloadWriter writer, const void *context)
+{
+    if (!isConnected())
+        return logPublish(topic, false);
+
+    if (!mqtt->beginPublish(topic, length, false))
+        return logPublish(topic, false);
+
+    ChunkedWriter out(*mqtt);
+    writer(out, context);
+    out.flush();
+    if (out.written() != length)
     {
-        mqtt->publish(topic, payload);
-        Serial.print(millis());
-        Serial.printf(" - published payload to topic ");
-        Serial.print(topic);
+        // the packet length is already on the wire, the connection can't be used anymore
+        Serial.printf("Payload of %lu bytes announced, %lu written.", (unsigned long)length, (unsigned long)out.written());
         Serial.println();
+        mqtt->disconnect();
+        return logPublish(topic, false);
     }
+    return logPublish(topic, mqtt->endPublish() == 1);
+}
+
+bool MqttClient::logPublish(const char *topic, bool result)
+{
+    Serial.print(millis());
+    if (!isConnected())
+        Serial.printf(" - offline, dropped payload to topic ");
+    else
+        Serial.printf(result ? " - published payload to topic " : " - failed to publish payload to topic ");
+    Serial.print(topic);
+    Serial.println();
+    return result;
+}
+
+MqttClient::ChunkedWriter::ChunkedWriter(Print &sink) : out(sink)
+{
+}
+
+size_t MqttClient::ChunkedWriter::write(uint8_t c)
+{
+    if (used == sizeof(chunk))
+        flush();
+    chunk[used++] = c;
+    return 1;
+}
+
+size_t MqttClient::ChunkedWriter::write(const uint8_t *buffer, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        write(buffer[i]);
+    return size;
+}
+
+void MqttClient::ChunkedWriter::flush()
+{
+    if (used == 0)
+        return;
+    total += out.write(chunk, used);
+    used = 0;
+}
+
+size_t MqttClient::ChunkedWriter::written()
+{
+    return total;
+}
+
+void MqttClient::setHeartbeatCallback(heartbeatCallback callback)
+{
+    heartbeatCb = callback;
+}
+
+void MqttClient::setHeartbeatTopic(const char *topic)
+{
+    strncpy(mqttHeartbeatTopic, topic, sizeof(mqttHeartbeatTopic) - 1);
+    mqttHeartbeatTopic[sizeof(mqttHeartbeatTopic) - 1] = '\0';
 }
 
 void MqttClient::subscribe(const char *topic)
 {
-    if (wifiConnect() && mqttConnect())
+    if (subscriptionCount < MAX_SUBSCRIPTIONS)
+    {
+        strncpy(subscriptions[subscriptionCount], topic, sizeof(subscriptions[0]) - 1);
+        subscriptions[subscriptionCount][sizeof(subscriptions[0]) - 1] = '\0';
+        subscriptionCount++;
+    }
+    else
+    {
+        Serial.println("Too many subscriptions, topic won't be resubscribed.");
+    }
+
+    if (isConnected())
     {
         mqtt->subscribe(topic, 0);
         Serial.print(millis());
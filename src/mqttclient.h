@@ -7,20 +7,71 @@
 
 typedef void (*mqttCallback)(char *topic, byte *payload, unsigned int length);
 
+/**
+ * @brief Callback function type for publishing the heartbeat, e.g. a document streamed with publish(topic, length,
+ *        writer, context).
+ *
+ * @param topic Topic of the heartbeat messages.
+ * @return True if the message was published, false otherwise.
+ */
+typedef bool (*heartbeatCallback)(const char *topic);
+
+/**
+ * @brief Callback function type for streaming a payload to the broker.
+ *
+ * @param out Sink to write the payload to.
+ * @param context Pointer passed through from publish(), e.g. the document to serialize.
+ */
+typedef void (*payloadWriter)(Print &out, const void *context);
+
+/**
+ * @brief Static heartbeat payload before and after the client id.
+ */
+#define HEARTBEAT_PREFIX "{\"device_id\":\""
+#define HEARTBEAT_SUFFIX "\",\"action\":\"heartbeat\",\"status\":\"ok\"}"
+
 /**
  * @brief Timeout for MQTT connection in seconds.
  */
 #define MQTT_TIMEOUT 60
 
 /**
- * @brief Number of retry attempts for MQTT connection.
+ * @brief Time in seconds PubSubClient waits for the CONNACK and for the rest of a packet it started to read.
+ *
+ * A broker in the LAN answers within milliseconds, every second of this timeout is a second a connect to a broker
+ * that doesn't answer stalls loop().
+ */
+#define MQTT_SOCKET_TIMEOUT 1
+
+/**
+ * @brief Time in milliseconds a WiFi association may take before the attempt counts as failed.
+ */
+#define WIFI_CONNECT_TIMEOUT 10000
+
+/**
+ * @brief Delay in milliseconds before the first reconnect attempt, doubled after every failed attempt.
+ */
+#define RETRY_BACKOFF_MIN 1000
+
+/**
+ * @brief Upper limit of the reconnect delay in milliseconds.
  */
-#define RETRY_ATTEMPTS 5
+#define RETRY_BACKOFF_MAX 60000
 
 /**
- * @brief Timeout for retry attempts in seconds.
+ * @brief Number of topics that are resubscribed after a reconnect.
  */
-#define RETRY_TIMEOUT 3 // seconds
+#define MAX_SUBSCRIPTIONS 4
+
+/**
+ * @brief Size of the PubSubClient buffer in bytes. Outgoing payloads are streamed, so it only limits incoming messages.
+ */
+#define MQTT_INBOUND_BUFFER_SIZE 512
+
+/**
+ * @brief Size in bytes of the chunks streamed payloads are written to the socket in.
+ */
+#define MQTT_WRITE_CHUNK_SIZE 64
 
 /**
  * @brief Separator for MQTT topics.
@@ -28,10 +79,52 @@ typedef void (*mqttCallback)(char *topic, byte *payload, unsigned int length);
 
 /**
  * @brief Class for handling MQTT client connections.
+ *
+ * The connection is driven by a state machine in loop(): the WiFi association is started and its progress checked on
+ * the following calls. The broker connect is the one step that blocks, PubSubClient connects synchronously: resolving
+ * a broker hostname, the TCP connect within the timeout of the WiFi client and waiting up to MQTT_SOCKET_TIMEOUT for
+ * the CONNACK. Configure the broker by IP address to skip the DNS lookup. Failed attempts are retried with an
+ * exponential backoff with jitter, so an unreachable broker stalls loop() once per backoff period. While offline,
+ * publish() returns false right away and leaves it to the caller to drop or repeat the message.
  */
 class MqttClient
 {
+public:
+    /**
+     * @brief States of the connection manager.
+     */
+    enum ConnectionState
+    {
+        Offline,        // waiting for the backoff delay to pass
+        WifiConnecting, // WiFi association started
+        MqttConnecting, // WiFi is up, the next loop() connects to the broker and blocks while doing so
+        Connected       // connected to the broker
+    };
+
 private:
+    /**
+     * @brief Print sink that collects single bytes into chunks, so a serializer doesn't cause a socket write per byte.
+     */
+    class ChunkedWriter : public Print
+    {
+    private:
+        Print &out;
+        uint8_t chunk[MQTT_WRITE_CHUNK_SIZE];
+        size_t used = 0;
+        size_t total = 0;
+
+    public:
+        ChunkedWriter(Print &out);
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t *buffer, size_t size) override;
+        void flush() override;
+
+        /**
+         * @brief Returns the number of bytes written to the sink so far.
+         */
+        size_t written();
+    };
+
     WiFiClient wifi;
     PubSubClient *mqtt;
     const char *wifiSsid;
@@ -42,39 +135,61 @@ private:
     const char *mqttPassword;
     const char *mqttClientId;
     char mqttHeartbeatTopic[128];
-    char heartbeatPayload[128];
     unsigned long lastHeartbeat = 0;
     const unsigned long heartbeatInterval = 60000; // milliseconds
     mqttCallback callback;
+    heartbeatCallback heartbeatCb = nullptr;
+    ConnectionState state = ConnectionState::Offline;
+    unsigned long stateTs = 0;        // timestamp of the last state change or connection attempt
+    unsigned long backoff = 0;        // delay in milliseconds before the next attempt
+    unsigned long retryDelay = RETRY_BACKOFF_MIN; // base of the backoff, doubled after every failed attempt
+    char subscriptions[MAX_SUBSCRIPTIONS][128]; // topics that are resubscribed after a reconnect
+    uint8_t subscriptionCount = 0;
 
     /**
-     * @brief Connects to WiFi network.
-     * @return True if successful, false otherwise.
+     * @brief Switches the connection manager to a new state.
+     * @param newState The new state.
      */
-    bool wifiConnect();
+    void setState(ConnectionState newState);
 
     /**
-     * @brief Connects to MQTT broker.
-     * @return True if successful, false otherwise.
+     * @brief Goes offline and schedules the next attempt with an exponential backoff with jitter.
      */
-    bool mqttConnect();
+    void retryLater();
 
     /**
-     * @brief Disconnects from MQTT broker.
+     * @brief Starts the WiFi association, returns immediately.
      */
-    void mqttDisconnect();
+    void wifiConnect();
+
+    /**
+     * @brief Tries to connect to the MQTT broker and subscribes to all stored topics. Blocks until the broker answered
+     *        or a timeout passed, see the class description.
+     * @return True if successful, false otherwise.
+     */
+    bool mqttConnect();
 
     /**
      * @brief emits hearbeat message to MQTT broker.
      */
     void emitHeartbeat();
 
-protected:
     /**
-     * @brief Connects to WiFi and MQTT broker.
+     * @brief Writes the static heartbeat payload, the payloadWriter of emitHeartbeat() without a heartbeat callback.
+     * @param out Sink to write the payload to.
+     * @param context The client id.
      */
-    void connect();
+    static void writeHeartbeat(Print &out, const void *context);
 
+    /**
+     * @brief Logs the result of a publish.
+     * @param topic Topic of the message.
+     * @param result True if the message was published, false otherwise.
+     * @return The result.
+     */
+    bool logPublish(const char *topic, bool result);
+
+protected:
     /**
      * @brief Disconnects from MQTT broker and WiFi network.
      */
@@ -105,24 +220,69 @@ public:
     MqttClient(const char *wifiSsid, const char *wifiPassword, const char *mqttBroker, int mqttPort, const char *mqttUser, const char *mqttPassword, const char *mqttClientId, const char *mqttBaseTopic, mqttCallback callback);
 
     /**
-     * @brief Initializes WiFi and MQTT connections.
+     * @brief Configures the client and starts connecting, returns immediately.
      */
     void init();
 
     /**
-     * @brief Loops through MQTT messages.
+     * @brief Advances the connection state machine and loops through MQTT messages. Only blocks in the MqttConnecting
+     *        state, for one broker connect per backoff period.
      */
     void loop();
 
+    /**
+     * @brief Checks if the client is connected to the broker.
+     * @return True if connected, false otherwise.
+     */
+    bool isConnected();
+
+    /**
+     * @brief Returns the state of the connection manager.
+     * @return The current ConnectionState.
+     */
+    ConnectionState getState();
+
     /**
      * @brief Publishes a message to an MQTT topic.
      * @param topic Topic to publish to.
      * @param payload Message payload.
+     * @return True if the message was handed to the broker connection, false while offline.
+     */
+    bool publish(const char *topic, const char *payload);
+
+    /**
+     * @brief Publishes a binary message to an MQTT topic.
+     * @param topic Topic to publish to.
+     * @param payload Message payload.
+     * @param length Length of the payload in bytes.
+     * @return True if the message was handed to the broker connection, false while offline.
+     */
+    bool publish(const char *topic, const uint8_t *payload, size_t length);
+
+    /**
+     * @brief Publishes a message that is streamed to the broker, without a copy of the payload in RAM.
+     * @param topic Topic to publish to.
+     * @param length Length of the payload in bytes, the writer must write exactly this many bytes.
+     * @param writer Callback writing the payload.
+     * @param context Pointer passed to the writer.
+     * @return True if the message was handed to the broker connection, false while offline.
+     */
+    bool publish(const char *topic, size_t length, payloadWriter writer, const void *context);
+
+    /**
+     * @brief Sets a callback that publishes the heartbeat, e.g. to report runtime statistics. Without it, a static payload is sent.
+     * @param callback Callback function publishing the heartbeat.
+     */
+    void setHeartbeatCallback(heartbeatCallback callback);
+
+    /**
+     * @brief Replaces the heartbeat topic, e.g. to mark the encoding of the heartbeat payload.
+     * @param topic Topic for the heartbeat messages.
      */
-    void publish(const char *topic, const char *payload);
+    void setHeartbeatTopic(const char *topic);
 
     /**
-     * @brief Subscribes to an MQTT topic.
+     * @brief Subscribes to an MQTT topic, now if connected and again after every reconnect.
      * @param topic Topic to subscribe to.
      */
     void subscribe(const char *topic);
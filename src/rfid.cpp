@@ -7,10 +7,16 @@
  *
  */
 #include "rfid.h"
+#include "tagschema.h"
 
 RFID::RFID(uint8_t chipselectPin, uint8_t resetPin)
 {
     pMfrc522 = new MFRC522(chipselectPin, resetPin);
+    for (uint8_t i = 0; i < TAG_CACHE_SIZE; i++)
+    {
+        cache[i].used = false;
+        cache[i].lastUsed = 0;
+    }
 }
 
 void RFID::prepareKey()
@@ -49,6 +55,8 @@ void RFID::init(byte authKey[6], rfidCallback rfidCb)
 bool RFID::write(TagData &tagData)
 {
     bool result = writeTag(tagData);
+    // the uid of the last selected tag is still set, even if the write failed halfway
+    invalidateCache();
     if (result)
         Serial.println(F("Tag written."));
 
@@ -57,325 +65,619 @@ bool RFID::write(TagData &tagData)
 
 void RFID::loop()
 {
+    unsigned long now = millis();
+    if (bursting && now - burstTs >= burstDurationMs)
+        bursting = false;
+
+    if (now - lastPollTs < (bursting ? pollBurstMs : pollIdleMs))
+        return;
+    lastPollTs = now;
+
+    pollRateCount++;
+    if (now - pollRateTs >= POLL_RATE_WINDOW_MS)
+    {
+        pollRate = pollRateCount * 1000.0f / (now - pollRateTs);
+        pollRateCount = 0;
+        pollRateTs = now;
+    }
+
     readTag();
 }
 
+void RFID::setPolling(unsigned long idleMs, unsigned long burstMs, unsigned long burstDuration)
+{
+    pollIdleMs = idleMs;
+    pollBurstMs = burstMs;
+    burstDurationMs = burstDuration;
+}
+
+void RFID::burst()
+{
+    bursting = true;
+    burstTs = millis();
+}
+
+float RFID::getPollRate()
+{
+    return pollRate;
+}
+
 void RFID::readTag()
 {
     if (!openTag())
         return;
 
-    byte size = 18; // The MIFARE_Read method requires a buffer that is at least 18 bytes to hold the 16 bytes of a block.
-    byte buffer[size];
+    unsigned long started = micros();
+    authentications = 0;
+
+    TagImage image;
+    memset(&image, 0, sizeof(image));
+
+    // the spool id lives in sector 0, without it the tag is useless
+    if (!readSector(0, image))
+    {
+        Serial.println(F("Reading spoolid failed."));
+        closeTag();
+        return;
+    }
+
+    // a known v2 tag only needs sector 0 to be read, its header carries the CRC of the whole record.
+    // a v1 tag has no checksum, all of its blocks are read and compared.
+    bool legacy = !isRecord(image);
+    bool complete = false;
+    CacheEntry *entry = findCache();
+    if (entry != nullptr)
+    {
+        if (legacy)
+            complete = readImage(image);
+        if ((complete || !legacy) && isCacheValid(*entry, image))
+        {
+            closeTag();
+            cacheStatistics.hits++;
+            entry->lastUsed = ++cacheUseCounter;
+
+            Serial.printf("Tag served from cache in %lu us with %u authentications.", micros() - started, authentications);
+            Serial.println();
+
+            callback(entry->data);
+            return;
+        }
+        entry->used = false;
+    }
+    cacheStatistics.misses++;
+
+    // the sectors of a cached v1 tag were read by the check already
+    if (entry == nullptr || !legacy)
+        complete = readImage(image);
+
+    // a missing sector would decode to empty fields, the tag isn't halted so that the next poll reads it again
+    if (!complete)
+    {
+        pMfrc522->PCD_StopCrypto1();
+        Serial.println(F("Tag read incomplete."));
+        return;
+    }
+    closeTag();
+
+    Serial.printf("Tag read in %lu us with %u authentications.", micros() - started, authentications);
+    Serial.println();
+
     TagData td;
+    if (!decodeTag(image, td))
+    {
+        Serial.println(F("Tag data is corrupt."));
+        return;
+    }
+    storeCache(image, td);
 
-    if (readBlock(spoolIdBlock, buffer))
+    // Dump the sector data
+    // Serial.println(F("Current data in sector:"));
+    // pMfrc522->PICC_DumpMifareClassicSectorToSerial(&(pMfrc522->uid), &key, sector);
+    // Serial.println();
+
+    callback(td);
+}
+
+bool RFID::readImage(TagImage &image)
+{
+    // a v2 record only occupies the sectors its length requires, a v1 tag may use all of them
+    byte sectors = isRecord(image) ? recordSectors(image.blocks[1][3]) : LEGACY_SECTORS;
+    bool result = true;
+    for (byte sector = 1; sector < sectors; sector++)
     {
-        td.spoolId = Conversion::byteToUuid(buffer);
+        if (!readSector(sector, image))
+        {
+            Serial.printf("Reading sector %u failed.", sector);
+            Serial.println();
+            result = false;
+        }
     }
-    else
+    return result;
+}
+
+RFID::CacheStatistics RFID::getCacheStatistics()
+{
+    return cacheStatistics;
+}
+
+RFID::WriteStatistics RFID::getWriteStatistics()
+{
+    return writeStatistics;
+}
+
+RFID::CacheEntry *RFID::findCache()
+{
+    for (uint8_t i = 0; i < TAG_CACHE_SIZE; i++)
     {
-        Serial.println(F("Reading spoolid failed."));
-        return; // early exit w/o spoolid
+        CacheEntry &entry = cache[i];
+        if (entry.used && entry.uidSize == pMfrc522->uid.size && memcmp(entry.uid, pMfrc522->uid.uidByte, entry.uidSize) == 0)
+            return &entry;
     }
+    return nullptr;
+}
 
-    if (readBlock(spoolWeightBlock, buffer))
+void RFID::storeCache(TagImage &image, TagData &tagData)
+{
+    CacheEntry *slot = findCache();
+    for (uint8_t i = 0; slot == nullptr && i < TAG_CACHE_SIZE; i++)
     {
-        td.spoolWeight = Conversion::byteToLong(buffer);
+        if (!cache[i].used)
+            slot = &cache[i];
     }
-    else
+    if (slot == nullptr)
     {
-        Serial.println(F("Reading spool weight failed."));
+        // evict the least recently used tag
+        slot = &cache[0];
+        for (uint8_t i = 1; i < TAG_CACHE_SIZE; i++)
+        {
+            if (cache[i].lastUsed < slot->lastUsed)
+                slot = &cache[i];
+        }
     }
 
-    if (readBlock(spoolManufacturerBlock, buffer))
+    slot->used = true;
+    slot->uidSize = pMfrc522->uid.size;
+    memcpy(slot->uid, pMfrc522->uid.uidByte, slot->uidSize);
+    memcpy(slot->validation, image.blocks[1], sizeof(slot->validation));
+    slot->legacyCrc = isRecord(image) ? 0 : legacyCrc(image);
+    slot->lastUsed = ++cacheUseCounter;
+    slot->data = tagData;
+}
+
+void RFID::invalidateCache()
+{
+    CacheEntry *entry = findCache();
+    if (entry != nullptr)
+        entry->used = false;
+}
+
+bool RFID::isCacheValid(CacheEntry &entry, TagImage &image)
+{
+    if (memcmp(entry.validation, image.blocks[1], sizeof(entry.validation)) != 0)
+        return false;
+    return isRecord(image) || legacyCrc(image) == entry.legacyCrc;
+}
+
+/**
+ * @brief Reads a length prefixed string field of a v2 record.
+ *
+ * @param record The record.
+ * @param length The length of the record.
+ * @param offset The offset of the field, advanced past the field.
+ * @param value The character array to store the field in, longer fields are cut off.
+ * @param size The size of the character array.
+ * @return true if the field lies within the record, false otherwise.
+ */
+static bool readField(byte *record, byte length, byte &offset, char *value, size_t size)
+{
+    if (offset >= length || offset + 1 + record[offset] > length)
+        return false;
+
+    Conversion::bytesToCharArray(record + offset + 1, record[offset], value, size);
+    offset += 1 + record[offset];
+    return true;
+}
+
+/**
+ * @brief Appends a length prefixed string field to a v2 record.
+ *
+ * @param record The record.
+ * @param length The length of the record, advanced past the field.
+ * @param value The string to append.
+ * @return true if the field fits into the record, false otherwise.
+ */
+static bool writeField(byte *record, byte &length, const char *value)
+{
+    size_t size = strlen(value);
+    if (length + 1 + size > TAG_RECORD_SIZE)
+        return false;
+
+    record[length] = size;
+    memcpy(record + length + 1, value, size);
+    length += 1 + size;
+    return true;
+}
+
+bool RFID::decodeTag(TagImage &image, TagData &td)
+{
+    if (!isRecord(image))
     {
-        td.manufacturer = Conversion::byteArrayToString(buffer);
+        decodeLegacyTag(image, td);
+        return true;
     }
-    else
+
+    byte record[TAG_RECORD_SIZE];
+    for (byte i = 0; i < TAG_DATA_BLOCKS; i++)
+        memcpy(record + i * TAG_BLOCK_SIZE, image.blocks[TagSchema::dataBlock(i)], TAG_BLOCK_SIZE);
+
+    byte length = record[3];
+    if (length < TAG_HEADER_SIZE + 20 || length > TAG_RECORD_SIZE)
+        return false;
+
+    // the crc is calculated with its own field set to zero
+    uint32_t crc = Conversion::unpackULong(record + 4);
+    memset(record + 4, 0, 4);
+    if (Conversion::crc32(record, length) != crc)
+        return false;
+
+    for (byte i = 0; i < RECORD_FIELD_COUNT; i++)
     {
-        Serial.println(F("Reading spool manufacturer failed."));
+        const RecordField &field = RECORD_FIELDS[i];
+        decodeField(field.codec, record + field.offset, field.width, (byte *)&td + field.member, field.memberSize, record[8]);
     }
 
-    if (readBlock(spoolMaterialBlock, buffer))
+    byte offset = RECORD_TEXT_START;
+    for (byte i = 0; i < RECORD_TEXT_FIELD_COUNT; i++)
     {
-        td.material = Conversion::byteArrayToString(buffer);
+        const TextField &field = RECORD_TEXT_FIELDS[i];
+        if (!readField(record, length, offset, (char *)&td + field.member, field.memberSize))
+            return false;
     }
-    else
+    return true;
+}
+
+void RFID::decodeLegacyTag(TagImage &image, TagData &td)
+{
+    // fields spanning several blocks are adjacent in the image
+    for (byte i = 0; i < LEGACY_FIELD_COUNT; i++)
     {
-        Serial.println(F("Reading spool material failed."));
+        const BlockField &field = LEGACY_FIELDS[i];
+        decodeField(field.codec, image.blocks[field.block], field.blocks * TAG_BLOCK_SIZE, (byte *)&td + field.member, field.memberSize, 0);
     }
+}
+
+bool RFID::encodeTag(TagData &tagData, TagImage &image, uint16_t &blockMask)
+{
+    blockMask = 0;
 
-    if (readBlock(spoolColorBlock, buffer))
+    if (Conversion::isEmptyUuid(tagData.spoolId))
     {
-        td.color = Conversion::byteArrayToString(buffer);
+        Serial.println(F("Empty spool id"));
+        return false;
     }
-    else
+
+    byte record[TAG_RECORD_SIZE];
+    memset(record, 0, sizeof(record));
+    record[0] = TAG_MAGIC0;
+    record[1] = TAG_MAGIC1;
+    record[2] = TAG_VERSION;
+
+    for (byte i = 0; i < RECORD_FIELD_COUNT; i++)
     {
-        Serial.println(F("Reading spool color failed."));
+        const RecordField &field = RECORD_FIELDS[i];
+        encodeField(field.codec, (byte *)&tagData + field.member, record + field.offset, record[8]);
     }
 
-    if (readBlock(spoolNameBlock1, buffer))
+    byte length = RECORD_TEXT_START;
+    for (byte i = 0; i < RECORD_TEXT_FIELD_COUNT; i++)
     {
-        byte buffer2[size];
-        byte buffer3[size];
-        if (readBlock(spoolNameBlock2, buffer2))
+        if (!writeField(record, length, (char *)&tagData + RECORD_TEXT_FIELDS[i].member))
         {
-            if (readBlock(spoolNameBlock3, buffer3))
-            {
-                td.spoolName = Conversion::byteArraysToString(buffer, buffer2, buffer3);
-            }
-            else
-            {
-                Serial.println(F("Reading spool name block3 failed."));
-            }
-        }
-        else
-        {
-            Serial.println(F("Reading spool name block2 failed."));
+            Serial.printf("Tag data exceeds %u bytes", TAG_RECORD_SIZE);
+            Serial.println();
+            return false;
         }
     }
-    else
+    record[3] = length;
+    Conversion::packULong(Conversion::crc32(record, length), record + 4);
+
+    for (byte i = 0; i * TAG_BLOCK_SIZE < length; i++)
     {
-        Serial.println(F("Reading spool name block1 failed."));
+        byte blockId = TagSchema::dataBlock(i);
+        memcpy(image.blocks[blockId], record + i * TAG_BLOCK_SIZE, TAG_BLOCK_SIZE);
+        blockMask |= 1 << blockId;
     }
+    return true;
+}
 
-    if (readBlock(spoolTimestampBlock, buffer))
+void RFID::mergeTag(TagData &tagData, TagData &existing)
+{
+    // the spool id is mandatory and never taken from the tag
+    for (byte i = 0; i < RECORD_FIELD_COUNT; i++)
     {
-        td.timestamp = Conversion::byteToLong(buffer);
+        const RecordField &field = RECORD_FIELDS[i];
+        if (field.codec != UuidCodec)
+            mergeField(field.codec, (byte *)&tagData + field.member, (byte *)&existing + field.member, field.memberSize);
     }
-    else
+    for (byte i = 0; i < RECORD_TEXT_FIELD_COUNT; i++)
     {
-        Serial.println(F("Reading spool timestamp failed."));
+        const TextField &field = RECORD_TEXT_FIELDS[i];
+        mergeField(TextCodec, (byte *)&tagData + field.member, (byte *)&existing + field.member, field.memberSize);
     }
+}
 
-    // Dump the sector data
-    // Serial.println(F("Current data in sector:"));
-    // pMfrc522->PICC_DumpMifareClassicSectorToSerial(&(pMfrc522->uid), &key, sector);
-    // Serial.println();
+void RFID::decodeField(FieldCodec codec, const byte *bytes, byte width, byte *member, size_t memberSize, byte flags)
+{
+    switch (codec)
+    {
+    case UuidCodec:
+        memcpy(member, bytes, memberSize);
+        break;
+    case ULongCodec:
+        *(unsigned long *)member = Conversion::unpackULong(bytes);
+        break;
+    case TextCodec:
+        Conversion::bytesToCharArray(bytes, width, (char *)member, memberSize);
+        break;
+    case ColorCodec:
+        if (flags & TAG_FLAG_COLOR)
+            Conversion::bytesToColor(bytes, (char *)member);
+        else
+            member[0] = '\0';
+        break;
+    }
+}
 
-    callback(td);
-    closeTag();
+void RFID::encodeField(FieldCodec codec, const byte *member, byte *bytes, byte &flags)
+{
+    switch (codec)
+    {
+    case UuidCodec:
+        memcpy(bytes, member, 16);
+        break;
+    case ULongCodec:
+        Conversion::packULong(*(const unsigned long *)member, bytes);
+        break;
+    case TextCodec:
+        // text fields are length prefixed, see writeField()
+        break;
+    case ColorCodec:
+        if (member[0] == '\0')
+            break;
+        if (Conversion::colorToBytes((const char *)member, bytes))
+            flags |= TAG_FLAG_COLOR;
+        else
+            Serial.println(F("Skipping invalid spool color"));
+        break;
+    }
 }
 
-bool RFID::readBlock(byte blockId, byte buffer[18])
+void RFID::mergeField(FieldCodec codec, byte *member, const byte *existing, size_t memberSize)
+{
+    switch (codec)
+    {
+    case ULongCodec:
+        if (*(unsigned long *)member == 0)
+            *(unsigned long *)member = *(const unsigned long *)existing;
+        break;
+    case TextCodec:
+    case ColorCodec:
+        if (member[0] == '\0')
+            memcpy(member, existing, memberSize);
+        break;
+    default:
+        break;
+    }
+}
+
+bool RFID::isRecord(TagImage &image)
+{
+    return image.blocks[1][0] == TAG_MAGIC0 && image.blocks[1][1] == TAG_MAGIC1 && image.blocks[1][2] == TAG_VERSION;
+}
+
+uint32_t RFID::legacyCrc(TagImage &image)
+{
+    // the blocks are adjacent in the image, the sector trailers are never read and stay zero
+    return Conversion::crc32(image.blocks[1], (LEGACY_SECTORS * BLOCKS_PER_SECTOR - 1) * TAG_BLOCK_SIZE);
+}
+
+byte RFID::recordSectors(byte length)
+{
+    byte blocks = (length + TAG_BLOCK_SIZE - 1) / TAG_BLOCK_SIZE;
+    if (blocks == 0)
+        blocks = 1;
+    if (blocks > TAG_DATA_BLOCKS)
+        blocks = TAG_DATA_BLOCKS;
+    return blockToSector(TagSchema::dataBlock(blocks - 1)) + 1;
+}
+
+bool RFID::readSector(byte sector, TagImage &image)
 {
-    if (authenticate(authKey, blockId))
+    byte firstBlock = sector * BLOCKS_PER_SECTOR;
+    if (!authenticate(authKey, firstBlock))
+        return false;
+
+    byte buffer[18]; // The MIFARE_Read method requires a buffer that is at least 18 bytes to hold the 16 bytes of a block.
+    for (byte blockId = firstBlock; blockId < firstBlock + BLOCKS_PER_SECTOR - 1; blockId++)
     {
-        byte size = 18;
-        MFRC522::StatusCode status;
-        status = (MFRC522::StatusCode)pMfrc522->MIFARE_Read(blockId, buffer, &size);
-        if (status != MFRC522::STATUS_OK)
-        {
-            Serial.printf("Reading block ");
-            Serial.print(blockId);
-            Serial.printf(" failed");
-            Serial.println();
+        // block 0 holds the manufacturer data
+        if (blockId == 0)
+            continue;
+
+        if (!readBlock(blockId, buffer))
             return false;
-        }
-        else
+        memcpy(image.blocks[blockId], buffer, TAG_BLOCK_SIZE);
+    }
+    return true;
+}
+
+bool RFID::writeSector(byte sector, TagImage &image, uint16_t blockMask)
+{
+    byte firstBlock = sector * BLOCKS_PER_SECTOR;
+    if (!authenticate(authKey, firstBlock))
+        return false;
+
+    bool result = true;
+    for (byte blockId = firstBlock; blockId < firstBlock + BLOCKS_PER_SECTOR - 1; blockId++)
+    {
+        if (blockMask & (1 << blockId))
+            result &= writeBlock(blockId, image.blocks[blockId], TAG_BLOCK_SIZE);
+    }
+    return result;
+}
+
+bool RFID::verifySector(byte sector, TagImage &image, uint16_t blockMask)
+{
+    TagImage readBack;
+    if (!readSector(sector, readBack))
+        return false;
+
+    byte firstBlock = sector * BLOCKS_PER_SECTOR;
+    for (byte blockId = firstBlock; blockId < firstBlock + BLOCKS_PER_SECTOR - 1; blockId++)
+    {
+        if ((blockMask & (1 << blockId)) && memcmp(readBack.blocks[blockId], image.blocks[blockId], TAG_BLOCK_SIZE) != 0)
         {
-            Serial.printf("Reading block ");
-            Serial.print(blockId);
-            Serial.printf(" succeded");
+            Serial.printf("Verifying block %u failed", blockId);
             Serial.println();
-            return true;
+            return false;
         }
     }
-    else
+    return true;
+}
+
+bool RFID::readBlock(byte blockId, byte buffer[18])
+{
+    byte size = 18;
+    MFRC522::StatusCode status;
+    status = (MFRC522::StatusCode)pMfrc522->MIFARE_Read(blockId, buffer, &size);
+    if (status != MFRC522::STATUS_OK)
     {
-        Serial.printf("authenticating block ");
+        Serial.printf("Reading block ");
         Serial.print(blockId);
         Serial.printf(" failed");
         Serial.println();
         return false;
     }
+    return true;
 }
 
 bool RFID::writeBlock(byte blockId, byte block[16], byte size)
 {
-    if (authenticate(authKey, blockId))
+    if ((MFRC522::StatusCode)pMfrc522->MIFARE_Write(blockId, block, size) != MFRC522::STATUS_OK)
     {
-        if ((MFRC522::StatusCode)pMfrc522->MIFARE_Write(blockId, block, size) != MFRC522::STATUS_OK)
-        {
-            Serial.printf("Writing block ");
-            Serial.print(blockId);
-            Serial.printf(" failed");
-            Serial.println();
-            return false;
-        }
-        else
-        {
-            Serial.printf("Writing block ");
-            Serial.print(blockId);
-            Serial.printf(" succeded");
-            Serial.println();
-            return true;
-        }
+        Serial.printf("Writing block ");
+        Serial.print(blockId);
+        Serial.printf(" failed");
+        Serial.println();
+        return false;
     }
     else
     {
-        Serial.printf("authenticating block ");
+        Serial.printf("Writing block ");
         Serial.print(blockId);
-        Serial.printf(" failed");
+        Serial.printf(" succeded");
         Serial.println();
-        return false;
+        return true;
     }
 }
 
 bool RFID::writeTag(TagData &tagData)
 {
-    if (!openTag())
+    writeStatistics = {0, 0, false};
+
+    if (!openTag(true))
     {
         Serial.println("no tag found");
         return false;
     }
 
-    byte size = 16;
-    MFRC522::StatusCode status;
-    byte block[size];
+    unsigned long started = micros();
+    authentications = 0;
 
-    if (!tagData.spoolId.isEmpty())
+    // the record is rewritten as a whole, fields that aren't given keep the data already on the tag
+    TagImage image;
+    memset(&image, 0, sizeof(image));
+    if (!readSector(0, image))
     {
-        Conversion::uuidToByte(tagData.spoolId, block);
-        if (!writeBlock(spoolIdBlock, block, size))
-        {
-            Serial.println(F("Writing spool id failed"));
-            return false; // early exit
-        }
-        Serial.println(F("Writing spool id succeeded"));
+        Serial.println(F("Reading tag before writing failed"));
+        closeTag();
+        return false; // early exit
     }
-    else
+    // fields of a sector that couldn't be read would be overwritten with empty values
+    if (!readImage(image))
     {
-        Serial.println(F("Empty spool id"));
+        Serial.println(F("Reading tag before writing failed"));
+        closeTag();
         return false; // early exit
     }
 
-    if (tagData.spoolWeight != 0)
-    {
-        Conversion::ulongToByte(tagData.spoolWeight, block);
-        if (!writeBlock(spoolWeightBlock, block, size))
-        {
-            Serial.println(F("Writing spool weight failed"));
-        }
-        else
-        {
-            Serial.println(F("Writing spool weight succeeded"));
-        }
-    }
-    else
-    {
-        Serial.println(F("Skipping spool weight"));
-    }
+    TagData data = tagData;
+    TagData existing;
+    if (decodeTag(image, existing))
+        mergeTag(data, existing);
 
-    if (!tagData.manufacturer.isEmpty())
+    TagImage current = image;
+    uint16_t blockMask;
+    if (!encodeTag(data, image, blockMask))
     {
-        Conversion::stringToByteArray(tagData.manufacturer, block);
-        if (!writeBlock(spoolManufacturerBlock, block, size))
-        {
-            Serial.println(F("Writing spool manufacturer failed"));
-        }
-        else
-        {
-            Serial.println(F("Writing spool manufacturer succeeded"));
-        }
-    }
-    else
-    {
-        Serial.println(F("Skipping spool manufacturer"));
+        closeTag();
+        return false; // early exit
     }
 
-    if (!tagData.material.isEmpty())
-    {
-        Conversion::stringToByteArray(tagData.material, block);
-        if (!writeBlock(spoolMaterialBlock, block, size))
-        {
-            Serial.println(F("Writing spool material failed"));
-        }
-        else
-        {
-            Serial.println(F("Writing spool material succeeded"));
-        }
-    }
-    else
+    // only blocks that differ from the tag are written
+    for (byte blockId = 0; blockId < TAG_SECTORS * BLOCKS_PER_SECTOR; blockId++)
     {
-        Serial.println(F("Skipping spool material"));
-    }
+        if (!(blockMask & (1 << blockId)))
+            continue;
 
-    if (!tagData.color.isEmpty())
-    {
-        Conversion::stringToByteArray(tagData.color, block);
-        if (!writeBlock(spoolColorBlock, block, size))
+        if (memcmp(image.blocks[blockId], current.blocks[blockId], TAG_BLOCK_SIZE) == 0)
         {
-            Serial.println(F("Writing spool color failed"));
+            blockMask &= ~(1 << blockId);
+            writeStatistics.skipped++;
         }
         else
         {
-            Serial.println(F("Writing spool color succeeded"));
+            writeStatistics.written++;
         }
     }
-    else
-    {
-        Serial.println(F("Skipping spool color"));
-    }
 
-    if (!tagData.spoolName.isEmpty())
+    // one authentication per sector, then all of its changed blocks
+    for (byte sector = 0; sector < TAG_SECTORS; sector++)
     {
-        byte block2[size];
-        byte block3[size];
-        Conversion::splitToByteArrays(tagData.spoolName, block, block2, block3);
-        if (!writeBlock(spoolNameBlock1, block, size))
-        {
-            Serial.println(F("Writing spool name block1 failed"));
-        }
-        else
-        {
-            if (!writeBlock(spoolNameBlock2, block2, size))
-            {
-                Serial.println(F("Writing spool name block2 failed"));
-            }
-            else
-            {
-                if (!writeBlock(spoolNameBlock3, block3, size))
-                {
-                    Serial.println(F("Writing spool name block3 failed"));
-                }
-                else
-                {
-                    Serial.println(F("Writing spool name succeeded"));
-                }
-            }
-        }
-    }
-    else
-    {
-        Serial.println(F("Skipping spool name"));
-    }
+        uint16_t sectorMask = blockMask & (0x0F << (sector * BLOCKS_PER_SECTOR));
+        if (sectorMask == 0)
+            continue;
 
-    if (tagData.timestamp != 0)
-    {
-        Conversion::ulongToByte(tagData.timestamp, block);
-        if (!writeBlock(spoolTimestampBlock, block, size))
+        // the crc only matches the complete record, a partially written tag reads as corrupt
+        if (!writeSector(sector, image, sectorMask))
         {
-            Serial.println(F("Writing spool timestamp failed"));
-        }
-        else
-        {
-            Serial.println(F("Writing spool timestamp succeeded"));
+            Serial.printf("Writing sector %u failed", sector);
+            Serial.println();
+            closeTag();
+            return false; // early exit
         }
     }
-    else
+
+    // read the written blocks back, a tag pulled away mid-write doesn't always make MIFARE_Write fail
+    writeStatistics.verified = true;
+    for (byte sector = 0; sector < TAG_SECTORS && writeStatistics.verified; sector++)
     {
-        Serial.println(F("Skipping spool timestamp"));
+        uint16_t sectorMask = blockMask & (0x0F << (sector * BLOCKS_PER_SECTOR));
+        if (sectorMask != 0)
+            writeStatistics.verified = verifySector(sector, image, sectorMask);
     }
 
+    Serial.printf("Tag written in %lu us with %u authentications, %u blocks written, %u skipped, verification %s.",
+                  micros() - started, authentications, writeStatistics.written, writeStatistics.skipped, writeStatistics.verified ? "passed" : "failed");
+    Serial.println();
+
     // Dump the sector data
     // Serial.println(F("Current data in sector:"));
     // pMfrc522->PICC_DumpMifareClassicSectorToSerial(&(pMfrc522->uid), &key, sector);
     // Serial.println();
 
     closeTag();
-    return true;
+    return writeStatistics.verified;
 }
 
 // bool RFID::clearTag(byte authKey[6])
@@ -412,10 +714,16 @@ bool RFID::writeTag(TagData &tagData)
 //     }
 // }
 
-bool RFID::openTag()
+bool RFID::openTag(bool wakeup)
 {
     if (!pMfrc522->PICC_IsNewCardPresent())
-        return false;
+    {
+        // loop() halts every tag it has read, a halted tag only answers a wake-up
+        byte atqa[2];
+        byte atqaSize = sizeof(atqa);
+        if (!wakeup || pMfrc522->PICC_WakeupA(atqa, &atqaSize) != MFRC522::STATUS_OK)
+            return false;
+    }
     if (!pMfrc522->PICC_ReadCardSerial())
         return false;
     MFRC522::PICC_Type piccType = pMfrc522->PICC_GetType(pMfrc522->uid.sak);
@@ -433,8 +741,14 @@ void RFID::closeTag()
     pMfrc522->PCD_StopCrypto1();
 }
 
+byte RFID::blockToSector(byte blockId)
+{
+    return blockId / BLOCKS_PER_SECTOR;
+}
+
 bool RFID::authenticate(MFRC522::PICC_Command keySlot, byte blockId)
 {
+    authentications++;
     MFRC522::StatusCode status;
     status = (MFRC522::StatusCode)pMfrc522->PCD_Authenticate(keySlot, blockId, &this->key, &(pMfrc522->uid));
     if (status != MFRC522::STATUS_OK)
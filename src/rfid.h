@@ -7,22 +7,117 @@
 
 #include "conversion.h"
 
+/**
+ * @brief Maximum lengths of the text fields of a tag, without the terminating null character.
+ */
+#define TAG_MATERIAL_LENGTH 16
+#define TAG_MANUFACTURER_LENGTH 32
+#define TAG_NAME_LENGTH 48
+
 /**
  * @brief Struct to hold RFID tag data.
  *
+ * All fields are stored inline, so copying or decoding a tag never touches the heap.
+ * The spool id is only formatted as string where it leaves the device (JSON, serial).
  */
 typedef struct
 {
-    // String instead of char array because ArduinoJson doesn't support char arrays
-    String spoolId;      // uuid
-    unsigned long spoolWeight;    // grams
-    String material;     // PLA, ABS, PETG, etc.
-    String color;        // hex
-    String manufacturer; // Prusa, Hatchbox, etc.
-    String spoolName;    // name of the spool
-    unsigned long timestamp;      // timestamp of spool creation
+    byte spoolId[16];                                // uuid, all zero if unset
+    unsigned long spoolWeight;                       // grams
+    char material[TAG_MATERIAL_LENGTH + 1];          // PLA, ABS, PETG, etc.
+    char color[COLOR_STRING_SIZE];                   // #rrggbb
+    char manufacturer[TAG_MANUFACTURER_LENGTH + 1];  // Prusa, Hatchbox, etc.
+    char spoolName[TAG_NAME_LENGTH + 1];             // name of the spool
+    unsigned long timestamp;                         // timestamp of spool creation
 } TagData;
 
+/**
+ * @brief Number of 16 byte blocks of a MIFARE Classic sector (the last one is the sector trailer).
+ */
+#define BLOCKS_PER_SECTOR 4
+
+/**
+ * @brief Number of sectors holding the tag data.
+ */
+#define TAG_SECTORS 4
+
+/**
+ * @brief Size of a MIFARE Classic block in bytes.
+ */
+#define TAG_BLOCK_SIZE 16
+
+/**
+ * @brief Magic bytes and version of the compact v2 tag layout.
+ *
+ * A v2 record is packed into the data blocks 1, 2, 4, 5, 6, 8, ... (skipping block 0 and the sector trailers):
+ *
+ *  offset | size | field
+ *  -------+------+------------------------------------------------------------
+ *       0 |    2 | magic 0xA5 0x5A
+ *       2 |    1 | version (2)
+ *       3 |    1 | length of the whole record in bytes
+ *       4 |    4 | CRC32 of the record, calculated with this field set to zero
+ *       8 |    1 | flags (TAG_FLAG_*)
+ *       9 |    4 | spool weight in grams, big endian
+ *      13 |    3 | color as raw red, green and blue bytes
+ *      16 |   16 | spool id (uuid)
+ *      32 |    4 | timestamp, big endian
+ *      36 |  1+n | material, length prefixed
+ *     ... |  1+n | manufacturer, length prefixed
+ *     ... |  1+n | spool name, length prefixed
+ *
+ * Header and spool id fill sector 0, a typical spool fits into sector 1 with the rest.
+ * Tags without the magic are decoded with the legacy v1 layout of fixed 16 byte blocks.
+ */
+#define TAG_MAGIC0 0xA5
+#define TAG_MAGIC1 0x5A
+#define TAG_VERSION 2
+
+/**
+ * @brief Flags of the v2 tag header.
+ */
+#define TAG_FLAG_COLOR 0x01 // the color bytes are set
+
+/**
+ * @brief Size of the v2 header block in bytes.
+ */
+#define TAG_HEADER_SIZE 16
+
+/**
+ * @brief Number of data blocks available to a v2 record (block 0 and the sector trailers excluded).
+ */
+#define TAG_DATA_BLOCKS (TAG_SECTORS * (BLOCKS_PER_SECTOR - 1) - 1)
+
+/**
+ * @brief Maximum size of a v2 record in bytes.
+ */
+#define TAG_RECORD_SIZE (TAG_DATA_BLOCKS * TAG_BLOCK_SIZE)
+
+/**
+ * @brief Number of decoded tags kept in the UID-keyed cache.
+ */
+#define TAG_CACHE_SIZE 8
+
+/**
+ * @brief Raw image of the data blocks of the tag sectors, as read from or written to the tag.
+ *
+ */
+typedef struct
+{
+    byte blocks[TAG_SECTORS * BLOCKS_PER_SECTOR][TAG_BLOCK_SIZE]; // indexed by block id, block 0 and the sector trailers stay unused
+} TagImage;
+
+/**
+ * @brief How a field is stored on the tag.
+ */
+enum FieldCodec
+{
+    UuidCodec,  // 16 raw bytes
+    ULongCodec, // 4 bytes, big endian
+    TextCodec,  // null padded (v1) or length prefixed (v2) characters
+    ColorCodec  // 3 raw bytes, "#rrggbb" in TagData, flagged with TAG_FLAG_COLOR in the v2 header
+};
+
 /**
  * @brief Callback function type for RFID events.
  *
@@ -37,6 +132,27 @@ typedef void (*rfidCallback)(TagData &data);
 class RFID
 {
 public:
+    /**
+     * @brief Struct for reporting the tag cache counters.
+     *
+     */
+    struct CacheStatistics
+    {
+        unsigned long hits;   // Tags served from the cache after the validity check.
+        unsigned long misses; // Tags that needed a full read.
+    };
+
+    /**
+     * @brief Struct for reporting the outcome of the last tag write.
+     *
+     */
+    struct WriteStatistics
+    {
+        uint8_t written; // Blocks that differed from the tag and were written.
+        uint8_t skipped; // Blocks of the record that already held the right data.
+        bool verified;   // Flag to indicate if reading back the written blocks matched.
+    };
+
     /**
      * @brief Constructor for RFID class.
      *
@@ -61,11 +177,33 @@ public:
     void init(byte authKey[6], rfidCallback callback);
 
     /**
-     * @brief Main loop function for the RFID reader.
+     * @brief Main loop function for the RFID reader. Polls for a tag at the idle interval, or at the burst interval while a burst is active.
      *
      */
     void loop();
 
+    /**
+     * @brief Configures the poll scheduler.
+     *
+     * @param idleMs Time in milliseconds between two polls while no burst is active.
+     * @param burstMs Time in milliseconds between two polls during a burst.
+     * @param burstDurationMs Time in milliseconds a burst lasts.
+     */
+    void setPolling(unsigned long idleMs, unsigned long burstMs, unsigned long burstDurationMs);
+
+    /**
+     * @brief Starts (or extends) a burst of fast polls, e.g. because the weight on the scale changed and a new spool may have been placed.
+     *
+     */
+    void burst();
+
+    /**
+     * @brief Returns the measured poll rate.
+     *
+     * @return Polls per second over the last POLL_RATE_WINDOW_MS.
+     */
+    float getPollRate();
+
     /**
      * @brief Writes data to the RFID tag.
      *
@@ -74,6 +212,20 @@ public:
      */
     bool write(TagData &tagData);
 
+    /**
+     * @brief Returns the hit and miss counters of the tag cache.
+     *
+     * @return CacheStatistics struct with the counters.
+     */
+    CacheStatistics getCacheStatistics();
+
+    /**
+     * @brief Returns the block counters and the verification result of the last write.
+     *
+     * @return WriteStatistics struct of the last call to write().
+     */
+    WriteStatistics getWriteStatistics();
+
     // /**
     //  * @brief Clears the RFID tag. This is done by writing all zeros to the tag and applying a new authentication key.
     //  *
@@ -82,29 +234,71 @@ public:
     // bool clearTag(byte authKey[6]);
 
 private:
+    /**
+     * @brief Struct for a decoded tag in the cache, keyed by the PICC UID.
+     *
+     */
+    struct CacheEntry
+    {
+        bool used;                                         // Flag to indicate if the slot holds a tag.
+        byte uidSize;                                      // Size of the UID in bytes.
+        byte uid[10];                                      // PICC UID of the tag.
+        byte validation[BLOCKS_PER_SECTOR - 2][TAG_BLOCK_SIZE]; // Data blocks of sector 0 (v2 header with the CRC, or the v1 spool id and weight) at the time of caching.
+        uint32_t legacyCrc;                                // CRC32 of all data blocks of a v1 tag at the time of caching, a v2 header carries its own.
+        unsigned long lastUsed;                            // Use counter value of the last hit, for LRU eviction.
+        TagData data;                                      // Decoded tag data.
+    };
+
+    static const unsigned long POLL_RATE_WINDOW_MS = 10000; // Time window in milliseconds for measuring the poll rate.
+
+    unsigned long pollIdleMs = 1000;     // Time in milliseconds between two polls while no burst is active.
+    unsigned long pollBurstMs = 50;      // Time in milliseconds between two polls during a burst.
+    unsigned long burstDurationMs = 3000; // Time in milliseconds a burst lasts.
+    bool bursting = false;               // Flag to indicate if a burst is active.
+    unsigned long burstTs = 0;           // Timestamp of the burst start.
+    unsigned long lastPollTs = 0;        // Timestamp of the last poll.
+    unsigned long pollRateTs = 0;        // Start of the current poll rate window.
+    unsigned long pollRateCount = 0;     // Polls in the current poll rate window.
+    float pollRate = 0.0f;               // Polls per second measured in the last window.
+
+    CacheEntry cache[TAG_CACHE_SIZE];                                       // Fixed arena of cached tags.
+    unsigned long cacheUseCounter = 0;                                      // Monotonic counter for the LRU order.
+    CacheStatistics cacheStatistics = {0, 0};                               // Hit and miss counters of the cache.
+    WriteStatistics writeStatistics = {0, 0, false};                        // Outcome of the last write.
     rfidCallback callback;                                                  // Callback function to be called when RFID tag is read.
     TagData writeData;                                                      // TagData struct containing the data to be written to the RFID tag.
     byte clearBlock[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}; // all zeros. This can be used to delete a block.
     MFRC522 *pMfrc522;                                                      // Pointer to the MFRC522 object.
     MFRC522::MIFARE_Key key;                                                // MIFARE key object.
     MFRC522::PICC_Command authKey = MFRC522::PICC_CMD_MF_AUTH_KEY_A;        // default key is A.
-    const byte spoolIdBlock = 1;
-    const byte spoolWeightBlock = 2;
-    const byte spoolManufacturerBlock = 4;
-    const byte spoolMaterialBlock = 5;
-    const byte spoolColorBlock = 6;
-    const byte spoolNameBlock1 = 8;
-    const byte spoolNameBlock2 = 9;
-    const byte spoolNameBlock3 = 10;
-    const byte spoolTimestampBlock = 12;
     bool IsWrite = false;             // Flag to indicate if the RFID tag is being written to.
+    uint8_t authentications = 0;      // Number of authentications of the current tag operation.
     void prepareKey();                // Helper function to prepare the default authentication key.
     void prepareKey(byte authKey[6]); // Helper function to prepare a custom authentication key.
     bool writeTag(TagData &tagData);  // Helper function to write data to the RFID tag.
     void readTag();                   // Helper function to read data from the RFID tag.
-    bool readBlock(byte blockId, byte buffer[18]); // Helper function to read a certain block from the RFID tag, includes call to authenticate().
-    bool writeBlock(byte blockId, byte block[16], byte size); // Helper function to write a certain block to the RFID tag, includes call to authenticate().
-    bool openTag();  // Helper function to open the RFID tag for writing.
+    bool readSector(byte sector, TagImage &image); // Helper function to read all data blocks of a sector into the image with a single authentication.
+    bool writeSector(byte sector, TagImage &image, uint16_t blockMask); // Helper function to write the masked blocks of a sector from the image with a single authentication.
+    bool verifySector(byte sector, TagImage &image, uint16_t blockMask); // Helper function to read back the masked blocks of a sector and compare them with the image.
+    bool readBlock(byte blockId, byte buffer[18]); // Helper function to read a certain block from the RFID tag, the sector must be authenticated.
+    bool writeBlock(byte blockId, byte block[16], byte size); // Helper function to write a certain block to the RFID tag, the sector must be authenticated.
+    bool readImage(TagImage &image); // Helper function to read the sectors after sector 0 that hold the tag data, false if one of them failed.
+    bool decodeTag(TagImage &image, TagData &tagData); // Helper function to decode the tag data from a raw tag image, false if the image is corrupt.
+    void decodeLegacyTag(TagImage &image, TagData &tagData); // Helper function to decode a tag written with the v1 layout.
+    bool encodeTag(TagData &tagData, TagImage &image, uint16_t &blockMask); // Helper function to encode the tag data as v2 record into a raw tag image, blockMask receives the blocks to write.
+    static void mergeTag(TagData &tagData, TagData &existing); // Helper function to fill the empty fields of the tag data with the data already on the tag.
+    static bool isRecord(TagImage &image); // Helper function to check if the image starts with a v2 header.
+    static uint32_t legacyCrc(TagImage &image); // Helper function to checksum the data blocks of a v1 tag.
+    static byte recordSectors(byte length); // Helper function to get the number of sectors a v2 record of the given length occupies.
+    static void decodeField(FieldCodec codec, const byte *bytes, byte width, byte *member, size_t memberSize, byte flags); // Helper function to decode a schema field into its TagData member.
+    static void encodeField(FieldCodec codec, const byte *member, byte *bytes, byte &flags); // Helper function to encode a fixed size schema field from its TagData member.
+    static void mergeField(FieldCodec codec, byte *member, const byte *existing, size_t memberSize); // Helper function to fill an empty TagData member with the value already on the tag.
+    static byte blockToSector(byte blockId); // Helper function to get the sector of a block.
+    CacheEntry *findCache(); // Helper function to find the cache entry of the selected tag, nullptr if it isn't cached.
+    void storeCache(TagImage &image, TagData &tagData); // Helper function to cache the selected tag, evicts the least recently used entry.
+    void invalidateCache(); // Helper function to drop the cache entry of the selected tag.
+    bool isCacheValid(CacheEntry &entry, TagImage &image); // Helper function to compare a cache entry with a tag image, a v1 image must be read completely.
+    bool openTag(bool wakeup = false);  // Helper function to open the RFID tag, wakeup also selects a tag that was already read and halted.
     void closeTag(); // Helper function to close the RFID tag after writing.
     bool authenticate(MFRC522::PICC_Command key, byte blockId); // Helper function to authenticate the RFID tag.
 };
@@ -8,97 +8,470 @@
  */
 #include "scale.h"
 
-Scale::Scale(uint8_t dOutPin, uint8_t sckPin)
+Scale *Scale::instance = nullptr;
+
+Scale::Scale(uint8_t dOutPin, uint8_t sckPin, SamplingMode mode)
 {
+    this->dOutPin = dOutPin;
+    this->sckPin = sckPin;
+    samplingMode = mode;
     scale.begin(dOutPin, sckPin);
 }
 
-void Scale::init(long calibration)
+void IRAM_ATTR Scale::onDataReady()
+{
+    if (instance != nullptr)
+        instance->readSample();
+}
+
+void IRAM_ATTR Scale::readSample()
 {
-    if (scale.is_ready())
+    // the falling edges caused by shifting out the previous conversion trigger the interrupt again, DOUT is high by then.
+    if (digitalRead(dOutPin) != LOW)
+        return;
+
+    // same protocol as HX711::read(): 24 bits MSB first, followed by one pulse selecting channel A with gain 128 for the next conversion.
+    // SCK must not stay high for more than 60us, otherwise the HX711 powers down.
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < 24; i++)
     {
-        scale.set_scale(calibration);
-        scale.tare();
+        digitalWrite(sckPin, HIGH);
+        delayMicroseconds(1);
+        value = (value << 1) | digitalRead(dOutPin);
+        digitalWrite(sckPin, LOW);
+        delayMicroseconds(1);
     }
-    else
+    digitalWrite(sckPin, HIGH);
+    delayMicroseconds(1);
+    digitalWrite(sckPin, LOW);
+    delayMicroseconds(1);
+
+    // sign extend the 24 bit two's complement value
+    if (value & 0x800000UL)
+        value |= 0xFF000000UL;
+
+    Sample sample;
+    sample.ts = millis();
+    sample.raw = (int32_t)value; // long is 64 bit on the host
+    sample.value = 0;
+    if (!samples.push(sample))
+        droppedSamples++;
+}
+
+#ifdef SCALE_SAMPLING_TASK
+void Scale::samplingTask(void *param)
+{
+    Scale *self = (Scale *)param;
+    for (;;)
+    {
+        if (!self->scale.is_ready())
+        {
+            // at 80 SPS a conversion takes 12.5ms, one tick is short enough to not miss one
+            vTaskDelay(1);
+            continue;
+        }
+
+        Sample sample;
+        sample.raw = self->scale.read();
+        sample.ts = millis();
+
+        self->lock();
+        sample.value = self->filterSample(sample);
+        self->unlock();
+
+        if (!self->samples.push(sample))
+            self->droppedSamples++;
+    }
+}
+#endif
+
+void Scale::lock()
+{
+#ifdef SCALE_SAMPLING_TASK
+    if (filterMutex != nullptr)
+        xSemaphoreTake(filterMutex, portMAX_DELAY);
+#endif
+}
+
+void Scale::unlock()
+{
+#ifdef SCALE_SAMPLING_TASK
+    if (filterMutex != nullptr)
+        xSemaphoreGive(filterMutex);
+#endif
+}
+
+float Scale::filterSample(const Scale::Sample &sample)
+{
+    float value = filter.process((sample.raw - scale.get_offset()) / scale.get_scale());
+    stability.process(value, sample.ts);
+    return value;
+}
+
+bool Scale::popSample(Scale::Sample &sample)
+{
+    if (!samples.pop(sample))
+        return false;
+
+    updateStatistics(sample);
+    return true;
+}
+
+void Scale::updateStatistics(const Scale::Sample &sample)
+{
+    statistics.samples++;
+    statisticsSamples++;
+
+    if (lastSampleTs != 0)
     {
-        if (scale.wait_ready_timeout(2000))
-            init(calibration);
+        unsigned long interval = sample.ts - lastSampleTs;
+        // a gap of more than twice the usual interval means the HX711 finished conversions we never read.
+        if (averageIntervalMs != 0 && interval > 2 * averageIntervalMs)
+            statistics.missed += interval / averageIntervalMs - 1;
         else
-            Serial.println("Failed to initialize HX711.");
+            averageIntervalMs = averageIntervalMs == 0 ? interval : (averageIntervalMs * 7 + interval) / 8;
+    }
+    lastSampleTs = sample.ts;
+
+    unsigned long elapsed = sample.ts - statisticsTs;
+    if (elapsed >= STATISTICS_WINDOW_MS)
+    {
+        statistics.sampleRate = statisticsSamples * 1000.0f / elapsed;
+        statisticsSamples = 0;
+        statisticsTs = sample.ts;
+    }
+}
+
+void Scale::recoverStall()
+{
+    // the HX711 keeps DOUT low until the conversion is read, so a missed edge stalls the sampling for good.
+    if (!sampling || samplingMode != SamplingMode::Interrupt || !samples.isEmpty() || millis() - lastSampleTs < STATISTICS_WINDOW_MS)
+        return;
+
+    if (digitalRead(dOutPin) == LOW)
+    {
+        noInterrupts();
+        readSample();
+        interrupts();
+        statistics.missed++;
     }
 }
 
+void Scale::startSampling()
+{
+    if (samplingMode == SamplingMode::Polling || sampling)
+        return;
+
+#ifdef SCALE_SAMPLING_TASK
+    if (samplingMode == SamplingMode::Task)
+    {
+        filterMutex = xSemaphoreCreateMutex();
+        if (xTaskCreatePinnedToCore(samplingTask, "scale", SCALE_TASK_STACK_SIZE, this, SCALE_TASK_PRIORITY, &samplingTaskHandle, SCALE_TASK_CORE) != pdPASS)
+        {
+            Serial.println("Failed to start the sampling task.");
+            return;
+        }
+        sampling = true;
+        return;
+    }
+#else
+    if (samplingMode == SamplingMode::Task)
+    {
+        Serial.println("Task sampling requires SCALE_SAMPLING_TASK, falling back to interrupt sampling.");
+        samplingMode = SamplingMode::Interrupt;
+    }
+#endif
+
+    instance = this;
+    samples.clear();
+    attachInterrupt(digitalPinToInterrupt(dOutPin), onDataReady, FALLING);
+    sampling = true;
+
+    // a conversion that is already waiting won't produce another falling edge
+    recoverStall();
+}
+
+Scale::Statistics Scale::getStatistics()
+{
+    // statistics.dropped is the count measure() already logged, it must not be advanced here
+    Statistics copy = statistics;
+    copy.dropped = droppedSamples;
+    return copy;
+}
+
+void Scale::setFilter(const FilterChain::Config &config)
+{
+    lock();
+    filter.configure(config);
+    unlock();
+}
+
+void Scale::setStability(float threshold, unsigned long holdMs)
+{
+    lock();
+    stability.configure(threshold, holdMs);
+    unlock();
+}
+
+void Scale::init(long calibration)
+{
+    lock();
+    scale.set_scale(calibration);
+    unlock();
+    startSampling();
+    beginJob(JobType::TareJob, 10);
+}
+
 void Scale::init(long calibration, unsigned long intervallMs)
 {
     timeIntervallMs = intervallMs;
     init(calibration);
 }
 
-// blocking!
-// TODO: make this non-blocking if possible
-long Scale::calibrate(unsigned long knownWeight)
+Scale::JobState Scale::calibrate(unsigned long knownWeight)
 {
-    long calibration = 0;
-    if (scale.is_ready())
+    unsigned long now = millis();
+    JobState state = JobState::Running;
+
+    switch (calibrationStep)
     {
+    case CalibrationStep::CalibrationIdle:
         Serial.println("Tare... remove any weights from the scale.");
-        delay(5000);
-        calibrationStep01();
-        Serial.println("Tare done...");
-        delay(1000);
-        Serial.print("Place a known weight on the scale...");
-        delay(5000);
-        calibration = calibrationStep02(knownWeight);
-    }
-    else
-    {
-        Serial.println("HX711 not ready for calibration.");
+        calibrationStep = CalibrationStep::CalibrationRemoveWeights;
+        calibrationStepTs = now;
+        break;
+    case CalibrationStep::CalibrationRemoveWeights:
+        if (now - calibrationStepTs >= 5000)
+        {
+            beginCalibrationStep01();
+            calibrationStep = CalibrationStep::CalibrationTaring;
+        }
+        break;
+    case CalibrationStep::CalibrationTaring:
+        state = poll();
+        if (state == JobState::Done)
+        {
+            Serial.println("Tare done...");
+            calibrationStep = CalibrationStep::CalibrationTared;
+            calibrationStepTs = now;
+            state = JobState::Running;
+        }
+        break;
+    case CalibrationStep::CalibrationTared:
+        if (now - calibrationStepTs >= 1000)
+        {
+            Serial.print("Place a known weight on the scale...");
+            calibrationStep = CalibrationStep::CalibrationPlaceWeight;
+            calibrationStepTs = now;
+        }
+        break;
+    case CalibrationStep::CalibrationPlaceWeight:
+        if (now - calibrationStepTs >= 5000)
+        {
+            beginCalibrationStep02(knownWeight);
+            calibrationStep = CalibrationStep::CalibrationWeighing;
+        }
+        break;
+    case CalibrationStep::CalibrationWeighing:
+        state = poll();
+        break;
     }
 
-    return calibration;
+    if (state == JobState::Done || state == JobState::Failed)
+        calibrationStep = CalibrationStep::CalibrationIdle;
+
+    return state;
 }
-void Scale::calibrationStep01() {
-        scale.set_scale();
-        scale.tare(5);
+
+void Scale::beginCalibrationStep01()
+{
+    lock();
+    scale.set_scale();
+    unlock();
+    beginJob(JobType::CalibrationZeroJob, 5);
 }
-long Scale::calibrationStep02(unsigned long knownWeight) {
-        long reading = scale.get_units(10);
-        Serial.print("Reading (10): ");
-        Serial.println(reading);
-        long calibration = reading / knownWeight;
-        Serial.print("Calibration factor: ");
-        Serial.println(calibration);
 
-        return calibration;
+void Scale::beginCalibrationStep02(unsigned long knownWeight)
+{
+    job.knownWeight = knownWeight;
+    beginJob(JobType::CalibrationSpanJob, 10);
 }
 
-bool Scale::tare()
+void Scale::beginTare()
 {
-    if (scale.is_ready())
+    beginJob(JobType::TareJob, 10);
+}
+
+void Scale::beginJob(Scale::JobType type, uint8_t times)
+{
+    // samples buffered before the job started belong to the previous load
+    samples.clear();
+
+    job.type = type;
+    job.state = JobState::Running;
+    job.times = times;
+    job.remaining = times;
+    job.sum = 0;
+    job.ts = millis();
+}
+
+bool Scale::readRaw(long &raw)
+{
+    if (sampling)
     {
-        scale.tare();
+        recoverStall();
+        Sample sample;
+        if (!popSample(sample))
+            return false;
+        raw = sample.raw;
         return true;
     }
+
+    // one conversion per call, is_ready() makes sure read() doesn't wait
+    if (!scale.is_ready())
+        return false;
+    raw = scale.read();
+    return true;
+}
+
+Scale::JobState Scale::poll()
+{
+    if (job.state != JobState::Running)
+        return job.state;
+
+    long raw;
+    while (job.remaining > 0 && readRaw(raw))
+    {
+        job.sum += raw;
+        job.remaining--;
+        job.ts = millis();
+    }
+
+    if (job.remaining > 0)
+    {
+        if (millis() - job.ts >= JOB_TIMEOUT_MS)
+        {
+            job.state = JobState::Failed;
+            if (job.type == JobType::CalibrationSpanJob)
+                Serial.println("HX711 not ready for calibration.");
+            else
+                Serial.println("HX711 not ready for taring.");
+        }
+        return job.state;
+    }
+
+    double average = job.sum / job.times;
+    if (job.type == JobType::CalibrationSpanJob)
+    {
+        // the sampling task reads offset and scale while filtering
+        lock();
+        long reading = (average - scale.get_offset()) / scale.get_scale();
+        unlock();
+        Serial.print("Reading (10): ");
+        Serial.println(reading);
+        calibration = reading / (long)job.knownWeight;
+        Serial.print("Calibration factor: ");
+        Serial.println(calibration);
+    }
     else
     {
-        Serial.println("HX711 not ready for taring.");
-        return false;
+        lock();
+        scale.set_offset(average);
+        unlock();
     }
+
+    lock();
+    filter.reset();
+    stability.reset();
+    unlock();
+    // samples filtered with the old offset are stale
+    samples.clear();
+    job.state = JobState::Done;
+    return job.state;
+}
+
+long Scale::getCalibration()
+{
+    return calibration;
 }
 
 void Scale::measure(Scale::Measurement &measurement, uint8_t samplingSize = 5)
 {
     unsigned long currentRunMs = millis();
 
+    // a running tare (e.g. from init()) takes all samples until it is done
+    if (job.state == JobState::Running)
+    {
+        poll();
+        return;
+    }
+
+    if (samplingMode != SamplingMode::Polling)
+    {
+        recoverStall();
+        if (currentRunMs - measurement.ts < timeIntervallMs)
+            return;
+
+        // drain the ring buffer, every sample passes the filter but only the newest ones are averaged
+        float window[SAMPLE_BUFFER_SIZE];
+        uint8_t count = 0;
+        Sample sample;
+        while (count < SAMPLE_BUFFER_SIZE * 2 && popSample(sample))
+        {
+            // the sampling task already filtered the sample
+            float value = samplingMode == SamplingMode::Task ? sample.value : filterSample(sample);
+            window[count & (SAMPLE_BUFFER_SIZE - 1)] = value;
+            count++;
+        }
+
+        if (count == 0)
+        {
+            Serial.println("HX711 not ready for measuring.");
+            return;
+        }
+
+        uint8_t size = count < SAMPLE_BUFFER_SIZE ? count : SAMPLE_BUFFER_SIZE;
+        if (samplingSize > 0 && samplingSize < size)
+            size = samplingSize;
+        double sum = 0;
+        for (uint8_t i = 1; i <= size; i++)
+        {
+            sum += window[(count - i) & (SAMPLE_BUFFER_SIZE - 1)];
+        }
+
+        unsigned long dropped = droppedSamples;
+        if (dropped != statistics.dropped)
+        {
+            Serial.printf("HX711 ring buffer overflow, %lu samples dropped.", dropped - statistics.dropped);
+            Serial.println();
+            statistics.dropped = dropped;
+        }
+
+        measurement.ts = currentRunMs;
+        measurement.result = sum / size;
+        updateSettled(measurement);
+        return;
+    }
+
     if (currentRunMs - measurement.ts >= timeIntervallMs)
     {
         if (scale.is_ready())
         {
-            long reading = scale.get_units(samplingSize);
+            // every conversion passes the filter like in the buffered modes, the window of the stability detector
+            // counts samples and would stretch over samplingSize times as many conversions if it got averages
+            uint8_t times = samplingSize > 0 ? samplingSize : 1;
+            double sum = 0;
+            for (uint8_t i = 0; i < times; i++)
+            {
+                Sample sample;
+                sample.raw = scale.read();
+                sample.ts = millis();
+                sum += filterSample(sample);
+            }
 
             measurement.ts = currentRunMs;
-            measurement.result = reading;
+            measurement.result = sum / times;
+            updateSettled(measurement);
         }
         else
         {
@@ -107,6 +480,14 @@ void Scale::measure(Scale::Measurement &measurement, uint8_t samplingSize = 5)
     }
 }
 
+void Scale::updateSettled(Scale::Measurement &measurement)
+{
+    lock();
+    measurement.stable = stability.isStable();
+    measurement.settled = stability.hasSettled() ? lround(stability.getSettled()) : measurement.result;
+    unlock();
+}
+
 bool Scale::isReady() {
-    return scale.is_ready();
+    return scale.is_ready() || (sampling && !samples.isEmpty());
 }
\ No newline at end of file
@@ -6,12 +6,40 @@
  * This file contains the declaration of Scale class that provides methods to initialize, calibrate, tare and measure weight using HX711 load cell amplifier.
  * The class also contains a struct Measurement that holds the timestamp and weight measurement.
  * 
+ * In interrupt sampling mode the HX711 is read from the DOUT falling edge (data ready) into a ring buffer,
+ * so measure() only consumes samples that are already buffered and never blocks.
+ * Every sample passes through a configurable FilterChain before it is averaged and feeds a StabilityDetector.
+ * 
+ * Built with SCALE_SAMPLING_TASK (ESP32 only), acquisition and filtering can run in their own FreeRTOS task pinned to
+ * SCALE_TASK_CORE, which hands the filtered samples to the main loop through a wait-free SPSC queue.
+ * 
  */
 #ifndef SCALE_H
 #define SCALE_H
 
 #include <Arduino.h>
 #include "HX711.h"
+#include "filter.h"
+#include "spscqueue.h"
+
+#ifdef SCALE_SAMPLING_TASK
+#ifndef ESP32
+#error "SCALE_SAMPLING_TASK requires FreeRTOS on the ESP32"
+#endif
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#ifndef SCALE_TASK_CORE
+#define SCALE_TASK_CORE 0 // Core the sampling task is pinned to, the Arduino loop runs on core 1.
+#endif
+#ifndef SCALE_TASK_PRIORITY
+#define SCALE_TASK_PRIORITY 2 // Priority of the sampling task, above the Arduino loop.
+#endif
+#ifndef SCALE_TASK_STACK_SIZE
+#define SCALE_TASK_STACK_SIZE 4096 // Stack size of the sampling task in bytes.
+#endif
+#endif
 
 
 /**
@@ -19,10 +47,6 @@
  */
 class Scale
 {
-private:
-    boolean firstRun = true; // Flag to indicate if the scale has been initialized.
-    HX711 scale; // Instance of the HX711 library for communicating with the load cell amplifier.
-    unsigned long timeIntervallMs = 1000; // Time interval in milliseconds between measurements.
 public:
     /**
      * @brief Struct for storing a measurement result.
@@ -31,14 +55,207 @@ public:
     {
         unsigned long ts; // Timestamp of the measurement.
         long result; // Measured weight in units of the calibration factor.
+        bool stable; // Flag to indicate if the weight has settled.
+        long settled; // Last settled weight, equals result until the weight settled once.
+    };
+
+    /**
+     * @brief State of a non-blocking tare or calibration job.
+     */
+    enum JobState
+    {
+        Idle,    // no job was started
+        Running, // the job is still collecting samples
+        Done,    // the job finished
+        Failed   // the HX711 didn't deliver samples in time
+    };
+
+    /**
+     * @brief How samples are acquired from the HX711.
+     */
+    enum SamplingMode
+    {
+        Polling,  // measure() reads and filters samplingSize conversions, busy-waiting for every one.
+        Interrupt, // samples are read on the DOUT falling edge and buffered, measure() never blocks.
+        Task // samples are read and filtered by a pinned FreeRTOS task (SCALE_SAMPLING_TASK builds only).
+    };
+
+    /**
+     * @brief Struct for reporting the state of the interrupt or task driven sampling.
+     */
+    struct Statistics
+    {
+        unsigned long samples; // Number of samples consumed from the ring buffer.
+        unsigned long dropped; // Number of samples dropped because the ring buffer was full.
+        unsigned long missed; // Number of conversions the HX711 finished but were never read.
+        float sampleRate; // Measured sample rate in samples per second.
     };
 
+private:
+    /**
+     * @brief What a job does with the averaged raw samples.
+     */
+    enum JobType
+    {
+        TareJob,           // sets the offset
+        CalibrationZeroJob, // sets the offset with a scale of 1
+        CalibrationSpanJob  // computes the calibration factor from a known weight
+    };
+
+    /**
+     * @brief Steps of the stand-alone calibrate() procedure.
+     */
+    enum CalibrationStep
+    {
+        CalibrationIdle,
+        CalibrationRemoveWeights,
+        CalibrationTaring,
+        CalibrationTared,
+        CalibrationPlaceWeight,
+        CalibrationWeighing
+    };
+
+    /**
+     * @brief Struct for a job averaging raw samples over several loop iterations.
+     */
+    struct Job
+    {
+        JobType type; // What to do with the average.
+        JobState state; // Progress of the job.
+        uint8_t times; // Number of samples to average.
+        uint8_t remaining; // Number of samples still missing.
+        double sum; // Sum of the collected raw samples.
+        unsigned long ts; // Timestamp of the job start or the last collected sample.
+        unsigned long knownWeight; // Known weight for the calibration.
+    };
+
+    static const uint8_t SAMPLE_BUFFER_SIZE = 32; // Size of the sample ring buffer, must be a power of two.
+    static const unsigned long STATISTICS_WINDOW_MS = 1000; // Time window in milliseconds for measuring the sample rate.
+    static const unsigned long JOB_TIMEOUT_MS = 2000; // A job fails if the HX711 delivers no sample for this time.
+
+    /**
+     * @brief Struct for a single raw sample in the ring buffer.
+     */
+    struct Sample
+    {
+        unsigned long ts; // Timestamp of the sample.
+        long raw; // Raw 24 bit reading of the HX711, sign extended.
+        float value; // Filtered weight, only set by the sampling task.
+    };
+
+    static Scale *instance; // Instance serviced by the DOUT interrupt handler.
+
+    boolean firstRun = true; // Flag to indicate if the scale has been initialized.
+    HX711 scale; // Instance of the HX711 library for communicating with the load cell amplifier.
+    unsigned long timeIntervallMs = 1000; // Time interval in milliseconds between measurements.
+    uint8_t dOutPin; // The data output pin of the HX711 amplifier.
+    uint8_t sckPin; // The clock input pin of the HX711 amplifier.
+    SamplingMode samplingMode; // How samples are acquired from the HX711.
+    FilterChain filter; // Filter pipeline every sample passes through.
+    StabilityDetector stability; // Settle detector fed with the filtered samples.
+    Job job = {JobType::TareJob, JobState::Idle, 0, 0, 0, 0, 0}; // Current tare or calibration job.
+    long calibration = 0; // Result of the last calibration job.
+    CalibrationStep calibrationStep = CalibrationStep::CalibrationIdle; // Current step of calibrate().
+    unsigned long calibrationStepTs = 0; // Timestamp of the last step change of calibrate().
+    bool sampling = false; // Flag to indicate if the interrupt handler or the sampling task produce samples.
+
+    SpscQueue<Sample, SAMPLE_BUFFER_SIZE> samples; // Ring buffer from the interrupt handler or the sampling task to the loop.
+    volatile unsigned long droppedSamples = 0; // Samples dropped because the ring buffer was full.
+#ifdef SCALE_SAMPLING_TASK
+    TaskHandle_t samplingTaskHandle = nullptr; // Handle of the sampling task.
+    SemaphoreHandle_t filterMutex = nullptr; // Guards the filters and the HX711 calibration shared with the sampling task.
+
+    /**
+     * @brief Sampling task, reads and filters every conversion and queues it.
+     * @param param The Scale instance.
+     */
+    static void samplingTask(void *param);
+#endif
+
+    Statistics statistics = {0, 0, 0, 0.0f}; // Sampling statistics, updated while consuming samples.
+    unsigned long lastSampleTs = 0; // Timestamp of the last consumed sample.
+    unsigned long averageIntervalMs = 0; // Smoothed interval between two consumed samples.
+    unsigned long statisticsTs = 0; // Start of the current sample rate window.
+    unsigned long statisticsSamples = 0; // Samples consumed in the current sample rate window.
+
+    /**
+     * @brief Interrupt handler for the DOUT falling edge.
+     */
+    static void IRAM_ATTR onDataReady();
+
+    /**
+     * @brief Shifts a conversion out of the HX711 and stores it in the ring buffer. Called with interrupts disabled.
+     */
+    void IRAM_ATTR readSample();
+
+    /**
+     * @brief Takes the oldest sample from the ring buffer.
+     * @param sample The Sample struct to store the sample in.
+     * @return True if a sample was available, false otherwise.
+     */
+    bool popSample(Sample &sample);
+
+    /**
+     * @brief Converts a raw sample to the calibrated weight and passes it through the filters and the settle detector.
+     * @param sample The raw sample.
+     * @return The filtered weight.
+     */
+    float filterSample(const Sample &sample);
+
+    /**
+     * @brief Takes the lock shared with the sampling task, a no-op without SCALE_SAMPLING_TASK.
+     */
+    void lock();
+
+    /**
+     * @brief Releases the lock shared with the sampling task, a no-op without SCALE_SAMPLING_TASK.
+     */
+    void unlock();
+
+    /**
+     * @brief Updates the sampling statistics with a consumed sample.
+     * @param sample The consumed sample.
+     */
+    void updateStatistics(const Sample &sample);
+
+    /**
+     * @brief Copies the state of the settle detector into a measurement.
+     * @param measurement The Measurement struct to update.
+     */
+    void updateSettled(Measurement &measurement);
+
+    /**
+     * @brief Reads a pending conversion if the HX711 signals data ready, but the falling edge was missed.
+     */
+    void recoverStall();
+
+    /**
+     * @brief Attaches the DOUT interrupt or starts the sampling task, depending on the sampling mode.
+     */
+    void startSampling();
+
+    /**
+     * @brief Starts a job, samples buffered up to now are discarded.
+     * @param type What to do with the averaged samples.
+     * @param times The number of samples to average.
+     */
+    void beginJob(JobType type, uint8_t times);
+
+    /**
+     * @brief Takes a single raw sample without waiting for the HX711.
+     * @param raw The variable to store the sample in.
+     * @return True if a sample was available, false otherwise.
+     */
+    bool readRaw(long &raw);
+
+public:
     /**
      * @brief Constructor for the Scale class.
      * @param dOutPin The data output pin of the HX711 amplifier.
      * @param sckPin The clock input pin of the HX711 amplifier.
+     * @param mode How samples are acquired from the HX711.
      */
-    Scale(uint8_t dOutPin, uint8_t sckPin);
+    Scale(uint8_t dOutPin, uint8_t sckPin, SamplingMode mode = SamplingMode::Polling);
 
     /**
      * @brief Initializes the scale with a calibration factor.
@@ -54,37 +271,66 @@ public:
     void init(long calibration, unsigned long measureEachMs);
 
     /**
-     * @brief Performs a calibration procedure using a known weight.
+     * @brief Configures the filter pipeline applied to every sample.
+     * @param config The parameters of the median/Hampel, Kalman and EMA stages.
+     */
+    void setFilter(const FilterChain::Config &config);
+
+    /**
+     * @brief Configures the settle detection reported in the Measurement struct.
+     * @param threshold The maximum standard deviation in grams of a settled weight.
+     * @param holdMs The time in milliseconds the weight has to stay within the threshold.
+     */
+    void setStability(float threshold, unsigned long holdMs);
+
+    /**
+     * @brief Performs a calibration procedure using a known weight. Non-blocking, call it until it returns Done or Failed.
      * @param knownWeight The weight in units of the calibration factor of the known weight used for calibration.
-     * @return The calibration factor calculated from the known weight.
+     * @return The state of the procedure, the calibration factor is available through getCalibration() once it is Done.
      */
-    long calibrate(unsigned long knownWeight);
+    JobState calibrate(unsigned long knownWeight);
 
     /**
-     * @brief Performs the first step of the calibration procedure.
+     * @brief Starts the first step of the calibration procedure (taring with a scale of 1). Advance it with poll().
      */
-    void calibrationStep01();
+    void beginCalibrationStep01();
 
     /**
-     * @brief Performs the second step of the calibration procedure using a known weight.
+     * @brief Starts the second step of the calibration procedure using a known weight. Advance it with poll().
      * @param knownWeight The weight in units of the calibration factor of the known weight used for calibration.
-     * @return The calibration factor calculated from the known weight.
      */
-    long calibrationStep02(unsigned long knownWeight);
+    void beginCalibrationStep02(unsigned long knownWeight);
 
     /**
-     * @brief Sets the current load cell reading as the tare weight.
-     * @return True if the tare weight was successfully set, false otherwise.
+     * @brief Starts setting the current load cell reading as the tare weight. Advance it with poll().
      */
-    bool tare();
+    void beginTare();
+
+    /**
+     * @brief Advances the current tare or calibration job without blocking.
+     * @return The state of the current job.
+     */
+    JobState poll();
+
+    /**
+     * @brief Returns the calibration factor of the last finished calibration.
+     * @return The calibration factor calculated from the known weight.
+     */
+    long getCalibration();
 
     /**
      * @brief Measures the weight using the current calibration factor and stores the result in the provided Measurement struct.
      * @param measurement The Measurement struct to store the measurement result in.
-     * @param samplingSize The number of samples to take and average for the measurement.
+     * @param samplingSize The number of samples to take and average for the measurement. In interrupt mode, the newest buffered samples are averaged.
      */
     void measure(Measurement &measurement, uint8_t samplingSize);
 
+    /**
+     * @brief Returns the sampling statistics of the interrupt sampling mode.
+     * @return The Statistics struct with consumed, dropped and missed samples and the measured sample rate.
+     */
+    Statistics getStatistics();
+
     /**
      * @brief Checks if the scale is ready to take a measurement.
      * @return True if the scale is ready, false otherwise.
@@ -0,0 +1,91 @@
+/**
+ * @file spscqueue.h
+ * @brief Header file for a wait-free single-producer/single-consumer queue.
+ *
+ * The queue hands items from exactly one producer (an interrupt handler or a task) to exactly one consumer (the main loop).
+ * Both sides complete in a bounded number of steps, no locks are taken. It only depends on the C++ standard library.
+ *
+ */
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * @brief Fixed-size ring buffer queue for one producer and one consumer.
+ * @tparam T The item type, copied in and out of the queue.
+ * @tparam N The number of slots, must be a power of two. One slot is kept free, so N - 1 items fit.
+ */
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    /**
+     * @brief Adds an item. Must only be called by the producer.
+     * @param item The item to add.
+     * @return True if the item was added, false if the queue is full.
+     */
+    bool push(const T &item)
+    {
+        size_t current = head.load(std::memory_order_relaxed);
+        size_t next = (current + 1) & (N - 1);
+        if (next == tail.load(std::memory_order_acquire))
+            return false;
+
+        buffer[current] = item;
+        head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Takes the oldest item. Must only be called by the consumer.
+     * @param item The variable to store the item in.
+     * @return True if an item was taken, false if the queue is empty.
+     */
+    bool pop(T &item)
+    {
+        size_t current = tail.load(std::memory_order_relaxed);
+        if (current == head.load(std::memory_order_acquire))
+            return false;
+
+        item = buffer[current];
+        tail.store((current + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Drops all queued items. Must only be called by the consumer.
+     */
+    void clear()
+    {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /**
+     * @brief Checks if the queue is empty. Exact for the consumer, a snapshot for the producer.
+     * @return True if no item is queued, false otherwise.
+     */
+    bool isEmpty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Returns the number of queued items. A snapshot if called concurrently.
+     * @return The number of queued items.
+     */
+    size_t size() const
+    {
+        return (head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire)) & (N - 1);
+    }
+
+private:
+    T buffer[N];                  // Item slots.
+    std::atomic<size_t> head{0}; // Next slot written by the producer.
+    std::atomic<size_t> tail{0}; // Next slot read by the consumer.
+};
+
+#endif
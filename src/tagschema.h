@@ -0,0 +1,224 @@
+/**
+ * @file tagschema.h
+ * @brief Compile-time schema of the TagData fields on the tag.
+ *
+ * Every field is declared once with its position, width and codec. RFID encodes, decodes and merges tags by walking
+ * these tables, and the static_asserts below reject fields that overlap, touch block 0 or a sector trailer, or don't
+ * fit their codec. Adding a field only takes a new table entry.
+ *
+ * The checks are written as recursive single-return constexpr functions, as the toolchain builds with C++11.
+ */
+#ifndef TAGSCHEMA_H
+#define TAGSCHEMA_H
+
+#include <stddef.h>
+
+#include "rfid.h"
+
+/**
+ * @brief A field of the legacy v1 layout, stored in whole blocks.
+ */
+struct BlockField
+{
+    byte block;        // first block of the field
+    byte blocks;       // number of adjacent blocks
+    FieldCodec codec;  // how the field is stored
+    size_t member;     // offset of the member in TagData
+    size_t memberSize; // size of the member in TagData
+};
+
+/**
+ * @brief A fixed size field of the v2 record, stored at a byte offset.
+ */
+struct RecordField
+{
+    byte offset;       // offset in the record
+    byte width;        // number of bytes
+    FieldCodec codec;  // how the field is stored
+    size_t member;     // offset of the member in TagData
+    size_t memberSize; // size of the member in TagData
+};
+
+/**
+ * @brief A length prefixed text field of the v2 record, appended in table order after the fixed fields.
+ */
+struct TextField
+{
+    size_t member;     // offset of the member in TagData
+    size_t memberSize; // size of the member in TagData
+};
+
+#define TAG_MEMBER(name) offsetof(TagData, name), sizeof(((TagData *)0)->name)
+
+/**
+ * @brief Legacy v1 layout, each field in its own blocks.
+ */
+static constexpr BlockField LEGACY_FIELDS[] = {
+    {1, 1, UuidCodec, TAG_MEMBER(spoolId)},
+    {2, 1, ULongCodec, TAG_MEMBER(spoolWeight)},
+    {4, 1, TextCodec, TAG_MEMBER(manufacturer)},
+    {5, 1, TextCodec, TAG_MEMBER(material)},
+    {6, 1, TextCodec, TAG_MEMBER(color)},
+    {8, 3, TextCodec, TAG_MEMBER(spoolName)},
+    {12, 1, ULongCodec, TAG_MEMBER(timestamp)}};
+
+/**
+ * @brief Offset of the first field after the v2 header fields (magic, version, length, crc, flags).
+ */
+#define TAG_RECORD_FIELDS_START 9
+
+/**
+ * @brief Fixed fields of the v2 record, see rfid.h for the complete layout.
+ */
+static constexpr RecordField RECORD_FIELDS[] = {
+    {TAG_RECORD_FIELDS_START, 4, ULongCodec, TAG_MEMBER(spoolWeight)},
+    {13, 3, ColorCodec, TAG_MEMBER(color)},
+    {TAG_HEADER_SIZE, 16, UuidCodec, TAG_MEMBER(spoolId)},
+    {TAG_HEADER_SIZE + 16, 4, ULongCodec, TAG_MEMBER(timestamp)}};
+
+/**
+ * @brief Text fields of the v2 record, in the order they follow the fixed fields.
+ */
+static constexpr TextField RECORD_TEXT_FIELDS[] = {
+    {TAG_MEMBER(material)},
+    {TAG_MEMBER(manufacturer)},
+    {TAG_MEMBER(spoolName)}};
+
+#undef TAG_MEMBER
+
+#define LEGACY_FIELD_COUNT (sizeof(LEGACY_FIELDS) / sizeof(LEGACY_FIELDS[0]))
+#define RECORD_FIELD_COUNT (sizeof(RECORD_FIELDS) / sizeof(RECORD_FIELDS[0]))
+#define RECORD_TEXT_FIELD_COUNT (sizeof(RECORD_TEXT_FIELDS) / sizeof(RECORD_TEXT_FIELDS[0]))
+
+namespace TagSchema
+{
+    /**
+     * @brief Checks if a block is a sector trailer.
+     */
+    constexpr bool isTrailer(unsigned block)
+    {
+        return block % BLOCKS_PER_SECTOR == BLOCKS_PER_SECTOR - 1;
+    }
+
+    /**
+     * @brief Checks if any of count blocks starting at block is block 0 or a sector trailer.
+     */
+    constexpr bool touchesReserved(unsigned block, unsigned count)
+    {
+        return count == 0 ? false : (block == 0 || isTrailer(block) || touchesReserved(block + 1, count - 1));
+    }
+
+    /**
+     * @brief Mask of the blocks of a field.
+     */
+    constexpr uint32_t blockMask(const BlockField &field)
+    {
+        return ((1UL << field.blocks) - 1) << field.block;
+    }
+
+    /**
+     * @brief Mask of the blocks of all fields, 0 if two fields overlap.
+     */
+    constexpr uint32_t blockMask(const BlockField *fields, size_t count, uint32_t used = 0)
+    {
+        return count == 0 ? used : (used & blockMask(*fields)) != 0 ? 0 : blockMask(fields + 1, count - 1, used | blockMask(*fields));
+    }
+
+    /**
+     * @brief Number of sectors up to the last used block of a mask.
+     */
+    constexpr byte sectors(uint32_t mask, unsigned block = 0, byte result = 0)
+    {
+        return block == TAG_SECTORS * BLOCKS_PER_SECTOR ? result : sectors(mask, block + 1, (mask & (1UL << block)) ? block / BLOCKS_PER_SECTOR + 1 : result);
+    }
+
+    /**
+     * @brief Checks if a v2 field has the width and the TagData member its codec needs.
+     */
+    constexpr bool fitsCodec(FieldCodec codec, unsigned width, size_t memberSize)
+    {
+        return codec == UuidCodec ? width == 16 && memberSize == 16 : codec == ULongCodec ? width == 4 && memberSize == sizeof(unsigned long) : codec == ColorCodec ? width == 3 && memberSize == COLOR_STRING_SIZE : false;
+    }
+
+    /**
+     * @brief Checks if a v1 field has the blocks and the TagData member its codec needs. Text may span several blocks.
+     */
+    constexpr bool fitsBlocks(FieldCodec codec, unsigned blocks, size_t memberSize)
+    {
+        return codec == TextCodec ? blocks > 0 && memberSize > 1 : blocks == 1 && fitsCodec(codec, codec == UuidCodec ? 16 : 4, memberSize);
+    }
+
+    /**
+     * @brief Checks that all v1 fields stay clear of block 0 and the sector trailers and fit their codec.
+     */
+    constexpr bool validBlockFields(const BlockField *fields, size_t count)
+    {
+        return count == 0 || (fields->block + fields->blocks <= TAG_SECTORS * BLOCKS_PER_SECTOR &&
+                              !touchesReserved(fields->block, fields->blocks) &&
+                              fitsBlocks(fields->codec, fields->blocks, fields->memberSize) &&
+                              validBlockFields(fields + 1, count - 1));
+    }
+
+    /**
+     * @brief Mask of the bytes of a v2 field within the fixed part of the record.
+     */
+    constexpr uint64_t byteMask(const RecordField &field)
+    {
+        return ((1ULL << field.width) - 1) << field.offset;
+    }
+
+    /**
+     * @brief Checks that the fixed v2 fields don't overlap each other or the header fields and fit their codec.
+     */
+    constexpr bool validRecordFields(const RecordField *fields, size_t count, uint64_t used = (1ULL << TAG_RECORD_FIELDS_START) - 1)
+    {
+        return count == 0 || (fields->offset + fields->width <= 64 &&
+                              (used & byteMask(*fields)) == 0 &&
+                              fitsCodec(fields->codec, fields->width, fields->memberSize) &&
+                              validRecordFields(fields + 1, count - 1, used | byteMask(*fields)));
+    }
+
+    /**
+     * @brief End of the fixed part of the v2 record, the text fields start there.
+     */
+    constexpr byte recordFieldsEnd(const RecordField *fields, size_t count, byte end = TAG_RECORD_FIELDS_START)
+    {
+        return count == 0 ? end : recordFieldsEnd(fields + 1, count - 1, fields->offset + fields->width > end ? fields->offset + fields->width : end);
+    }
+
+    /**
+     * @brief Sum of the maximum lengths of the v2 text fields including their length prefix.
+     */
+    constexpr size_t textFieldsSize(const TextField *fields, size_t count)
+    {
+        return count == 0 ? 0 : fields->memberSize + textFieldsSize(fields + 1, count - 1);
+    }
+
+    /**
+     * @brief Block id of the n-th data block of a v2 record, skipping block 0 and the sector trailers.
+     */
+    constexpr byte dataBlock(byte index)
+    {
+        return index < BLOCKS_PER_SECTOR - 2 ? index + 1 : (1 + (index - (BLOCKS_PER_SECTOR - 2)) / (BLOCKS_PER_SECTOR - 1)) * BLOCKS_PER_SECTOR + (index - (BLOCKS_PER_SECTOR - 2)) % (BLOCKS_PER_SECTOR - 1);
+    }
+}
+
+/**
+ * @brief Mask and number of sectors of the blocks used by the v1 layout.
+ */
+static constexpr uint32_t LEGACY_BLOCKS = TagSchema::blockMask(LEGACY_FIELDS, LEGACY_FIELD_COUNT);
+static constexpr byte LEGACY_SECTORS = TagSchema::sectors(LEGACY_BLOCKS);
+
+/**
+ * @brief Offset of the first v2 text field.
+ */
+static constexpr byte RECORD_TEXT_START = TagSchema::recordFieldsEnd(RECORD_FIELDS, RECORD_FIELD_COUNT);
+
+static_assert(LEGACY_BLOCKS != 0, "v1 tag fields overlap");
+static_assert(TagSchema::validBlockFields(LEGACY_FIELDS, LEGACY_FIELD_COUNT), "v1 tag field uses a reserved block or doesn't fit its codec");
+static_assert(LEGACY_SECTORS <= TAG_SECTORS, "v1 tag fields exceed the tag sectors");
+static_assert(TagSchema::validRecordFields(RECORD_FIELDS, RECORD_FIELD_COUNT), "v2 tag fields overlap or don't fit their codec");
+static_assert(RECORD_TEXT_START + TagSchema::textFieldsSize(RECORD_TEXT_FIELDS, RECORD_TEXT_FIELD_COUNT) <= TAG_RECORD_SIZE, "v2 text fields exceed the tag record");
+static_assert(!TagSchema::isTrailer(TagSchema::dataBlock(TAG_DATA_BLOCKS - 1)) && TagSchema::dataBlock(TAG_DATA_BLOCKS - 1) < TAG_SECTORS * BLOCKS_PER_SECTOR, "v2 data blocks exceed the tag sectors");
+
+#endif
@@ -0,0 +1,326 @@
+/**
+ * @file test_command.cpp
+ * @brief Host tests of the CommandDecoder and the CommandQueue.
+ */
+#include <unity.h>
+#include <command.h>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+// Fuzz cases and throughput runs, two million and one million take a few seconds on a desktop. Override them with
+// build_flags, e.g. -D COMMAND_FUZZ_CASES=20000000 for a longer fuzz run before a release.
+#ifndef COMMAND_FUZZ_CASES
+#define COMMAND_FUZZ_CASES 2000000
+#endif
+#ifndef COMMAND_DISPATCH_RUNS
+#define COMMAND_DISPATCH_RUNS 1000000
+#endif
+
+namespace
+{
+    int calls = 0;            // Number of handler calls.
+    char lastAction[16];      // Action of the last handled command.
+    char lastId[COMMAND_ID_SIZE]; // Correlation id of the last handled command.
+    long lastValue = 0;       // "value" of the last handled command.
+    bool lastHasExtra = false; // Whether the last handled command kept the "extra" key.
+
+    void record(const char *action, JsonObject command)
+    {
+        calls++;
+        strlcpy(lastAction, action, sizeof(lastAction));
+        const char *id = command["id"];
+        strlcpy(lastId, id != nullptr ? id : "", sizeof(lastId));
+        lastValue = command["value"];
+        lastHasExtra = command.containsKey("extra");
+    }
+
+    void onTare(JsonObject command)
+    {
+        record("tare", command);
+    }
+
+    void onCalibrate(JsonObject command)
+    {
+        record("calibrate", command);
+    }
+
+    /**
+     * @brief Deterministic xorshift32 generator, so a failing fuzz case can be repeated.
+     */
+    uint32_t fuzzState = 0x2545F491;
+
+    uint32_t fuzzRandom()
+    {
+        fuzzState ^= fuzzState << 13;
+        fuzzState ^= fuzzState >> 17;
+        fuzzState ^= fuzzState << 5;
+        return fuzzState;
+    }
+
+    /**
+     * @brief Mutates a seed command: flips, inserts, deletes or repeats bytes, or cuts it off.
+     */
+    std::vector<byte> mutate(const char *seed)
+    {
+        static const char tokens[] = "{}[]\":,\\ 0123456789-.eEtrufalsn";
+        std::vector<byte> payload(seed, seed + strlen(seed));
+        uint32_t mutations = 1 + fuzzRandom() % 8;
+        for (uint32_t i = 0; i < mutations && !payload.empty(); i++)
+        {
+            size_t at = fuzzRandom() % payload.size();
+            switch (fuzzRandom() % 5)
+            {
+            case 0:
+                payload[at] ^= 1 << (fuzzRandom() % 8);
+                break;
+            case 1:
+                payload.insert(payload.begin() + at, tokens[fuzzRandom() % (sizeof(tokens) - 1)]);
+                break;
+            case 2:
+                payload.erase(payload.begin() + at);
+                break;
+            case 3:
+                // repeats a slice, which grows the payload up to and beyond the size limit
+                payload.insert(payload.begin() + at, payload.begin() + at, payload.begin() + at + (payload.size() - at) / 2);
+                break;
+            default:
+                payload.resize(at);
+                break;
+            }
+        }
+        return payload;
+    }
+
+    CommandDecoder::Result dispatch(CommandDecoder &decoder, const char *json)
+    {
+        // the decoder parses in place, so every call gets its own copy like PubSubClient's buffer
+        static char payload[COMMAND_MAX_SIZE + 64];
+        size_t length = strlen(json);
+        memcpy(payload, json, length);
+        return decoder.dispatch((byte *)payload, length);
+    }
+}
+
+void setUp()
+{
+    calls = 0;
+    lastAction[0] = '\0';
+    lastId[0] = '\0';
+    lastValue = 0;
+    lastHasExtra = false;
+}
+
+void tearDown()
+{
+}
+
+void test_dispatches_to_the_action_handler()
+{
+    CommandDecoder decoder("action");
+    decoder.on("tare", onTare);
+    decoder.on("calibrate", onCalibrate);
+    decoder.keep("id");
+    decoder.keep("value");
+
+    TEST_ASSERT_EQUAL(CommandDecoder::Dispatched, dispatch(decoder, "{\"action\":\"calibrate\",\"id\":\"abc\",\"value\":100}"));
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL_STRING("calibrate", lastAction);
+    TEST_ASSERT_EQUAL_STRING("abc", lastId);
+    TEST_ASSERT_EQUAL(100, lastValue);
+
+    TEST_ASSERT_EQUAL(CommandDecoder::Dispatched, dispatch(decoder, "  {\"action\":\"tare\"}"));
+    TEST_ASSERT_EQUAL_STRING("tare", lastAction);
+}
+
+void test_unknown_action()
+{
+    CommandDecoder decoder("action");
+    decoder.on("tare", onTare);
+    TEST_ASSERT_EQUAL(CommandDecoder::Unknown, dispatch(decoder, "{\"action\":\"reboot\"}"));
+    TEST_ASSERT_EQUAL(CommandDecoder::Unknown, dispatch(decoder, "{\"value\":1}"));
+    // a name that shares the slot of a registered action still needs the strcmp to match
+    TEST_ASSERT_EQUAL(CommandDecoder::Unknown, dispatch(decoder, "{\"action\":\"tar\"}"));
+    TEST_ASSERT_EQUAL(0, calls);
+}
+
+void test_rejects_malformed_and_oversize_payloads()
+{
+    CommandDecoder decoder("action");
+    decoder.on("tare", onTare);
+    TEST_ASSERT_EQUAL(CommandDecoder::Rejected, dispatch(decoder, ""));
+    TEST_ASSERT_EQUAL(CommandDecoder::Rejected, dispatch(decoder, "   "));
+    TEST_ASSERT_EQUAL(CommandDecoder::Rejected, dispatch(decoder, "[\"tare\"]"));
+    TEST_ASSERT_EQUAL(CommandDecoder::Rejected, dispatch(decoder, "{\"action\":\"tare\""));
+    TEST_ASSERT_EQUAL(CommandDecoder::Rejected, dispatch(decoder, "{\"action\":\"tare\",\"a\":{\"b\":{\"c\":{\"d\":{}}}}}"));
+
+    // whitespace pads a valid command to the limit and one byte beyond it
+    char padded[COMMAND_MAX_SIZE + 2];
+    const char *command = "{\"action\":\"tare\"}";
+    size_t length = strlen(command);
+    memset(padded, ' ', sizeof(padded));
+    memcpy(padded + COMMAND_MAX_SIZE - length, command, length);
+    padded[COMMAND_MAX_SIZE] = '\0';
+    TEST_ASSERT_EQUAL(CommandDecoder::Dispatched, dispatch(decoder, padded));
+    memcpy(padded + COMMAND_MAX_SIZE + 1 - length, command, length);
+    padded[COMMAND_MAX_SIZE + 1] = '\0';
+    TEST_ASSERT_EQUAL(CommandDecoder::Rejected, dispatch(decoder, padded));
+    TEST_ASSERT_EQUAL(1, calls);
+}
+
+void test_filter_drops_unkept_keys()
+{
+    CommandDecoder decoder("action");
+    decoder.on("tare", onTare);
+    decoder.keep("id");
+    dispatch(decoder, "{\"action\":\"tare\",\"id\":\"1\",\"extra\":{\"x\":[1,2,3]}}");
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_FALSE(lastHasExtra);
+
+    decoder.keep("extra");
+    dispatch(decoder, "{\"action\":\"tare\",\"id\":\"1\",\"extra\":{\"x\":[1,2,3]}}");
+    TEST_ASSERT_TRUE(lastHasExtra);
+}
+
+void test_reregistering_replaces_the_handler()
+{
+    CommandDecoder decoder("action");
+    decoder.on("tare", onCalibrate);
+    decoder.on("tare", onTare);
+    dispatch(decoder, "{\"action\":\"tare\"}");
+    TEST_ASSERT_EQUAL_STRING("tare", lastAction);
+}
+
+void test_action_table_capacity()
+{
+    static const char *names[COMMAND_MAX_ACTIONS + 1] = {"tare", "calibrate", "configure", "write_tag", "test", "reset", "status", "journal", "ota"};
+    CommandDecoder decoder("action");
+    for (uint8_t i = 0; i < COMMAND_MAX_ACTIONS; i++)
+        TEST_ASSERT_TRUE(decoder.on(names[i], onTare));
+    TEST_ASSERT_FALSE(decoder.on(names[COMMAND_MAX_ACTIONS], onTare));
+
+    // every registered action is still found through the perfect hash
+    char json[64];
+    for (uint8_t i = 0; i < COMMAND_MAX_ACTIONS; i++)
+    {
+        snprintf(json, sizeof(json), "{\"action\":\"%s\"}", names[i]);
+        TEST_ASSERT_EQUAL(CommandDecoder::Dispatched, dispatch(decoder, json));
+    }
+    TEST_ASSERT_EQUAL(CommandDecoder::Unknown, dispatch(decoder, "{\"action\":\"ota\"}"));
+}
+
+void test_fuzzed_payloads()
+{
+    static const char *seeds[] = {
+        "{\"action\":\"tare\",\"id\":\"3f2504e0-4f89-41d3-9a0c-0305e82c3301\"}",
+        "{\"action\":\"calibrate\",\"value\":1000,\"extra\":{\"x\":[1,2.5,-3e2,true,null]}}",
+        "{\"action\":\"tare\",\"id\":\"a\\\"b\\u0041\",\"value\":[[[[1]]]]}",
+    };
+    const uint32_t cases = COMMAND_FUZZ_CASES;
+    const size_t guard = 16;
+    CommandDecoder decoder("action");
+    decoder.on("tare", onTare);
+    decoder.on("calibrate", onCalibrate);
+    decoder.keep("id");
+    decoder.keep("value");
+    decoder.keep("extra");
+
+    uint32_t results[3] = {0, 0, 0};
+    for (uint32_t i = 0; i < cases; i++)
+    {
+        std::vector<byte> payload = mutate(seeds[i % (sizeof(seeds) / sizeof(seeds[0]))]);
+        size_t length = payload.size();
+        // the bytes after the payload belong to someone else and must stay untouched
+        payload.insert(payload.end(), guard, 0xA5);
+        int before = calls;
+        CommandDecoder::Result result = decoder.dispatch(payload.data(), length);
+
+        char message[48];
+        snprintf(message, sizeof(message), "fuzz case %lu", (unsigned long)i);
+        for (size_t j = 0; j < guard; j++)
+            TEST_ASSERT_EQUAL_HEX8_MESSAGE(0xA5, payload[length + j], message);
+        TEST_ASSERT_EQUAL_MESSAGE(result == CommandDecoder::Dispatched ? before + 1 : before, calls, message);
+        if (result == CommandDecoder::Dispatched)
+            TEST_ASSERT_TRUE_MESSAGE(strcmp(lastAction, "tare") == 0 || strcmp(lastAction, "calibrate") == 0, message);
+        if (length > COMMAND_MAX_SIZE)
+            TEST_ASSERT_EQUAL_MESSAGE(CommandDecoder::Rejected, result, message);
+        results[result]++;
+    }
+
+    // the mutations reach every outcome
+    TEST_ASSERT_GREATER_THAN(0, results[CommandDecoder::Dispatched]);
+    TEST_ASSERT_GREATER_THAN(0, results[CommandDecoder::Unknown]);
+    TEST_ASSERT_GREATER_THAN(0, results[CommandDecoder::Rejected]);
+
+    char message[96];
+    snprintf(message, sizeof(message), "fuzz cases: %lu dispatched, %lu unknown, %lu rejected",
+             (unsigned long)results[CommandDecoder::Dispatched], (unsigned long)results[CommandDecoder::Unknown],
+             (unsigned long)results[CommandDecoder::Rejected]);
+    TEST_MESSAGE(message);
+}
+
+void test_dispatch_throughput()
+{
+    const char *command = "{\"action\":\"calibrate\",\"id\":\"3f2504e0-4f89-41d3-9a0c-0305e82c3301\",\"value\":1000,"
+                          "\"scale\":{\"calibration\":987,\"update_interval\":500},\"display\":{\"timeout\":60000}}";
+    const uint32_t runs = COMMAND_DISPATCH_RUNS;
+    CommandDecoder decoder("action");
+    decoder.on("tare", onTare);
+    decoder.on("calibrate", onCalibrate);
+    decoder.keep("id");
+    decoder.keep("value");
+
+    auto started = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < runs; i++)
+        dispatch(decoder, command);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / runs;
+
+    TEST_ASSERT_EQUAL(runs, calls);
+    TEST_ASSERT_EQUAL(1000, lastValue);
+    char message[96];
+    snprintf(message, sizeof(message), "ns per %lu byte command copied, parsed and dispatched: %.1f",
+             (unsigned long)strlen(command), ns);
+    TEST_MESSAGE(message);
+}
+
+void test_queue_fifo_and_back()
+{
+    CommandQueue<int, 3> queue;
+    int item;
+    TEST_ASSERT_NULL(queue.back());
+    TEST_ASSERT_TRUE(queue.push(1));
+    TEST_ASSERT_TRUE(queue.push(2));
+    TEST_ASSERT_TRUE(queue.push(3));
+    TEST_ASSERT_FALSE(queue.push(4));
+    TEST_ASSERT_EQUAL(3, *queue.back());
+
+    // the newest item may be changed in place
+    *queue.back() = 30;
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(1, item);
+    TEST_ASSERT_TRUE(queue.push(4));
+    TEST_ASSERT_EQUAL(4, *queue.back());
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(2, item);
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(30, item);
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(4, item);
+    TEST_ASSERT_FALSE(queue.pop(item));
+    TEST_ASSERT_EQUAL(0, queue.size());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dispatches_to_the_action_handler);
+    RUN_TEST(test_unknown_action);
+    RUN_TEST(test_rejects_malformed_and_oversize_payloads);
+    RUN_TEST(test_filter_drops_unkept_keys);
+    RUN_TEST(test_reregistering_replaces_the_handler);
+    RUN_TEST(test_action_table_capacity);
+    RUN_TEST(test_fuzzed_payloads);
+    RUN_TEST(test_dispatch_throughput);
+    RUN_TEST(test_queue_fifo_and_back);
+    return UNITY_END();
+}
@@ -0,0 +1,99 @@
+/**
+ * @file test_commandflood.cpp
+ * @brief Host test of the command queue under a flood of commands: the firmware answers every command it merges or
+ * drops with the correlation id of the command, published after the MQTT callback returned.
+ */
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <constants.h>
+#include <sim.h>
+#include <map>
+#include <stdio.h>
+#include <string>
+
+void setup();
+
+namespace
+{
+    const char *COMMAND_TOPIC = "command/scale-01";
+    const char *RESPONSE_TOPIC = "response/scale-01";
+
+    void sendCommand(const char *action, const char *id, const char *extra = "")
+    {
+        char payload[256];
+        snprintf(payload, sizeof(payload), "{\"action\":\"%s\",\"id\":\"%s\"%s}", action, id, extra);
+        Sim::Broker::inject(COMMAND_TOPIC, payload);
+    }
+
+    /**
+     * @brief Returns the results of the command responses by correlation id, responses with a result that isn't a
+     *        string are left out.
+     */
+    std::map<std::string, std::string> responses()
+    {
+        std::map<std::string, std::string> results;
+        for (const Sim::Broker::Message &message : Sim::Broker::published())
+        {
+            if (message.topic != RESPONSE_TOPIC)
+                continue;
+            StaticJsonDocument<256> doc;
+            TEST_ASSERT_FALSE(deserializeJson(doc, message.payload.c_str()));
+            const char *id = doc["id"];
+            const char *result = doc["result"];
+            if (id != nullptr && result != nullptr)
+                results[id] = result;
+        }
+        return results;
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_flood_is_answered_with_correlation_ids()
+{
+    setup();
+    // WiFi, the broker and the tare
+    Sim::runLoop(5000);
+
+    // the calibration keeps the flow busy for seconds, everything after it waits in the queue
+    sendCommand(ACTION_CALIBRATE, "cal-0");
+    Sim::runLoop(100);
+
+    // the first configure command is merged into the second one
+    sendCommand(ACTION_CONFIGURE, "cfg-1", ",\"display\":{\"flush_interval\":50}");
+    sendCommand(ACTION_CONFIGURE, "cfg-2", ",\"display\":{\"flush_interval\":40}");
+    // the merged command and 7 calibrations fill the queue, 3 more calibrations are dropped
+    char id[16];
+    for (unsigned int i = 1; i <= COMMAND_QUEUE_SIZE + 2; i++)
+    {
+        snprintf(id, sizeof(id), "cal-%u", i);
+        sendCommand(ACTION_CALIBRATE, id);
+    }
+    sendCommand(ACTION_WRITETAG, "tag-1");
+    sendCommand(ACTION_WRITETAG, "tag-2", ",\"tag\":{\"spool_id\":\"not-a-uuid\"}");
+    Sim::runLoop(100);
+
+    std::map<std::string, std::string> results = responses();
+    TEST_ASSERT_EQUAL(6, results.size());
+    TEST_ASSERT_EQUAL_STRING(RESULT_COALESCED, results["cfg-1"].c_str());
+    for (unsigned int i = COMMAND_QUEUE_SIZE; i <= COMMAND_QUEUE_SIZE + 2; i++)
+    {
+        snprintf(id, sizeof(id), "cal-%u", i);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(RESULT_QUEUE_FULL, results[id].c_str(), id);
+    }
+    TEST_ASSERT_EQUAL_STRING(RESULT_TAG_MISSING, results["tag-1"].c_str());
+    TEST_ASSERT_EQUAL_STRING(RESULT_INVALID_SPOOL_ID, results["tag-2"].c_str());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_flood_is_answered_with_correlation_ids);
+    return UNITY_END();
+}
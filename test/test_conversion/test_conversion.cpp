@@ -0,0 +1,277 @@
+/**
+ * @file test_conversion.cpp
+ * @brief Host tests of the Conversion helpers.
+ */
+#include <unity.h>
+#include <conversion.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_hex_round_trip()
+{
+    const byte bytes[] = {0x00, 0x01, 0x7F, 0x80, 0xAB, 0xFF};
+    char hex[2 * sizeof(bytes) + 1] = {0};
+    Conversion::bytesToHex(bytes, sizeof(bytes), hex);
+    TEST_ASSERT_EQUAL_STRING("00017f80abff", hex);
+
+    byte decoded[sizeof(bytes)];
+    TEST_ASSERT_TRUE(Conversion::hexToBytes(hex, strlen(hex), decoded));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(bytes, decoded, sizeof(bytes));
+}
+
+void test_hex_accepts_upper_case()
+{
+    byte decoded[2];
+    TEST_ASSERT_TRUE(Conversion::hexToBytes("aBcD", 4, decoded));
+    TEST_ASSERT_EQUAL_HEX8(0xAB, decoded[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xCD, decoded[1]);
+}
+
+void test_hex_rejects_odd_length()
+{
+    byte decoded[2] = {0xEE, 0xEE};
+    TEST_ASSERT_FALSE(Conversion::hexToBytes("abc", 3, decoded));
+    TEST_ASSERT_FALSE(Conversion::hexToBytes("a", 1, decoded));
+    // the output stays untouched
+    TEST_ASSERT_EQUAL_HEX8(0xEE, decoded[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xEE, decoded[1]);
+
+    // an empty span is valid and writes nothing
+    TEST_ASSERT_TRUE(Conversion::hexToBytes("", 0, decoded));
+    TEST_ASSERT_EQUAL_HEX8(0xEE, decoded[0]);
+}
+
+void test_hex_rejects_invalid_digits()
+{
+    const char *invalid[] = {"0g", "g0", "0x", " 1", "1 ", "-1", "+1", "\xff" "0", "0\xc3"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        byte decoded[1] = {0xEE};
+        TEST_ASSERT_FALSE_MESSAGE(Conversion::hexToBytes(invalid[i], 2, decoded), invalid[i]);
+        TEST_ASSERT_EQUAL_HEX8(0xEE, decoded[0]);
+    }
+
+    // a null character within the span is invalid, too
+    byte decoded[2] = {0xEE, 0xEE};
+    TEST_ASSERT_FALSE(Conversion::hexToBytes("ab\0d", 4, decoded));
+    // validated before anything is written, the valid first byte isn't stored either
+    TEST_ASSERT_EQUAL_HEX8(0xEE, decoded[0]);
+}
+
+void test_uuid_round_trip()
+{
+    const char *uuid = "0123abcd-4567-89ef-0123-456789abcdef";
+    byte block[16];
+    TEST_ASSERT_TRUE(Conversion::parseUuid(uuid, block));
+    TEST_ASSERT_EQUAL_HEX8(0x01, block[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xEF, block[15]);
+
+    char formatted[UUID_STRING_SIZE];
+    Conversion::byteToUuid(block, formatted);
+    TEST_ASSERT_EQUAL_STRING(uuid, formatted);
+}
+
+void test_uuid_without_hyphens()
+{
+    byte withHyphens[16], without[16];
+    TEST_ASSERT_TRUE(Conversion::parseUuid("0123abcd-4567-89ef-0123-456789abcdef", withHyphens));
+    TEST_ASSERT_TRUE(Conversion::parseUuid("0123abcd456789ef0123456789abcdef", without));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(withHyphens, without, 16);
+}
+
+void test_uuid_rejects_malformed()
+{
+    const char *invalid[] = {
+        "",
+        "0123abcd-4567-89ef-0123-456789abcde",   // a digit short
+        "0123abcd-4567-89ef-0123-456789abcdef0", // a digit too many
+        "0123abcd04567-89ef-0123-456789abcdef",  // hyphen replaced
+        "0123abc-d4567-89ef-0123-456789abcdef",  // hyphen moved
+        "0123abcd-4567-89ef-0123-456789abcdeg",  // invalid digit
+        "0123abcd456789ef0123456789abcde",       // odd number of digits
+        "0123abcd456789ef0123456789abcdefab"};   // 17 bytes
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        byte block[16];
+        memset(block, 0xEE, sizeof(block));
+        TEST_ASSERT_FALSE_MESSAGE(Conversion::parseUuid(invalid[i], block), invalid[i]);
+        TEST_ASSERT_EACH_EQUAL_HEX8(0xEE, block, sizeof(block));
+    }
+}
+
+void test_color_round_trip()
+{
+    byte rgb[3];
+    TEST_ASSERT_TRUE(Conversion::colorToBytes("#1a2B3c", rgb));
+    char color[COLOR_STRING_SIZE];
+    Conversion::bytesToColor(rgb, color);
+    TEST_ASSERT_EQUAL_STRING("#1a2b3c", color);
+
+    // the leading '#' is optional
+    TEST_ASSERT_TRUE(Conversion::colorToBytes("ffffff", rgb));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, rgb[2]);
+}
+
+void test_color_rejects_malformed()
+{
+    byte rgb[3] = {0xEE, 0xEE, 0xEE};
+    TEST_ASSERT_FALSE(Conversion::colorToBytes("#12345", rgb));
+    TEST_ASSERT_FALSE(Conversion::colorToBytes("#1234567", rgb));
+    TEST_ASSERT_FALSE(Conversion::colorToBytes("#12345g", rgb));
+    TEST_ASSERT_FALSE(Conversion::colorToBytes("##12345", rgb));
+    TEST_ASSERT_EACH_EQUAL_HEX8(0xEE, rgb, sizeof(rgb));
+}
+
+void test_pack_ulong()
+{
+    byte bytes[6] = {0xEE, 0, 0, 0, 0, 0xEE};
+    Conversion::packULong(0x12345678, bytes + 1);
+    TEST_ASSERT_EQUAL_HEX8(0xEE, bytes[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x12, bytes[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x78, bytes[4]);
+    TEST_ASSERT_EQUAL_HEX8(0xEE, bytes[5]);
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, Conversion::unpackULong(bytes + 1));
+}
+
+void test_crc32_check_value()
+{
+    // the standard check value of CRC-32/ISO-HDLC
+    const char *check = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, Conversion::crc32((const byte *)check, 9));
+
+    // continuing over two parts gives the same checksum
+    uint32_t crc = Conversion::crc32((const byte *)check, 4);
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, Conversion::crc32((const byte *)check + 4, 5, crc));
+}
+
+void test_bytes_to_char_array_truncates()
+{
+    const byte bytes[8] = {'P', 'E', 'T', 'G', 0, 'x', 'x', 'x'};
+    char output[8];
+    Conversion::bytesToCharArray(bytes, sizeof(bytes), output, sizeof(output));
+    TEST_ASSERT_EQUAL_STRING("PETG", output);
+
+    char small[3];
+    Conversion::bytesToCharArray(bytes, sizeof(bytes), small, sizeof(small));
+    TEST_ASSERT_EQUAL_STRING("PE", small);
+}
+
+namespace
+{
+    const uint32_t BENCHMARK_UUIDS = 2000000;
+
+    /**
+     * @brief The String based decoder the table driven one replaced: strips the hyphens, then strtol per pair.
+     */
+    void legacyUuidToByte(String uuid, byte *block)
+    {
+        uuid.replace("-", "");
+        if (uuid.length() != 32)
+            return;
+        for (int i = 0; i < 16; i++)
+        {
+            String hexPair = uuid.substring(i * 2, (i * 2) + 2);
+            block[i] = (byte)strtol(hexPair.c_str(), NULL, 16);
+        }
+    }
+
+    /**
+     * @brief The sprintf based encoder the table driven one replaced.
+     */
+    void legacyByteToUuid(const byte *block, char *uuid)
+    {
+        uuid[0] = '\0';
+        for (int i = 0; i < 16; i++)
+        {
+            if (i == 4 || i == 6 || i == 8 || i == 10)
+                strcat(uuid, "-");
+            sprintf(uuid + strlen(uuid), "%02x", block[i]);
+        }
+    }
+
+    /**
+     * @brief Formats the n-th UUID of the benchmark, every byte changes from one to the next.
+     */
+    void benchmarkUuid(uint32_t n, byte *block)
+    {
+        for (int i = 0; i < 16; i += 4)
+            Conversion::packULong(n * 2654435761UL + i * 40503UL, block + i);
+    }
+
+    /**
+     * @brief Formats and parses the n-th UUID with the legacy codec, returns a checksum of the parsed bytes.
+     */
+    uint32_t legacyRoundTrip(uint32_t n)
+    {
+        byte block[16], decoded[16];
+        char uuid[UUID_STRING_SIZE];
+        benchmarkUuid(n, block);
+        legacyByteToUuid(block, uuid);
+        legacyUuidToByte(uuid, decoded);
+        return Conversion::unpackULong(decoded) ^ Conversion::unpackULong(decoded + 4) ^ Conversion::unpackULong(decoded + 8) ^ Conversion::unpackULong(decoded + 12);
+    }
+
+    /**
+     * @brief Formats and parses the n-th UUID with the table driven codec, returns a checksum of the parsed bytes.
+     */
+    uint32_t tableRoundTrip(uint32_t n)
+    {
+        byte block[16], decoded[16];
+        char uuid[UUID_STRING_SIZE];
+        benchmarkUuid(n, block);
+        Conversion::byteToUuid(block, uuid);
+        Conversion::parseUuid(uuid, decoded);
+        return Conversion::unpackULong(decoded) ^ Conversion::unpackULong(decoded + 4) ^ Conversion::unpackULong(decoded + 8) ^ Conversion::unpackULong(decoded + 12);
+    }
+
+    double nsPerUuid(uint32_t (*roundTrip)(uint32_t), uint32_t &check)
+    {
+        auto started = std::chrono::steady_clock::now();
+        for (uint32_t n = 0; n < BENCHMARK_UUIDS; n++)
+            check ^= roundTrip(n);
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / BENCHMARK_UUIDS;
+    }
+}
+
+void test_uuid_codec_benchmark()
+{
+    // the checksums prove that both codecs parsed the same bytes
+    uint32_t legacyCheck = 0, tableCheck = 0;
+    double legacy = nsPerUuid(legacyRoundTrip, legacyCheck);
+    double table = nsPerUuid(tableRoundTrip, tableCheck);
+
+    TEST_ASSERT_EQUAL_HEX32(legacyCheck, tableCheck);
+    TEST_ASSERT_TRUE(table < legacy);
+
+    char message[96];
+    snprintf(message, sizeof(message), "ns per UUID formatted and parsed: strtol/sprintf %.1f, table %.1f", legacy, table);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hex_round_trip);
+    RUN_TEST(test_hex_accepts_upper_case);
+    RUN_TEST(test_hex_rejects_odd_length);
+    RUN_TEST(test_hex_rejects_invalid_digits);
+    RUN_TEST(test_uuid_round_trip);
+    RUN_TEST(test_uuid_without_hyphens);
+    RUN_TEST(test_uuid_rejects_malformed);
+    RUN_TEST(test_color_round_trip);
+    RUN_TEST(test_color_rejects_malformed);
+    RUN_TEST(test_pack_ulong);
+    RUN_TEST(test_crc32_check_value);
+    RUN_TEST(test_bytes_to_char_array_truncates);
+    RUN_TEST(test_uuid_codec_benchmark);
+    return UNITY_END();
+}
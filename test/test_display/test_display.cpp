@@ -0,0 +1,173 @@
+/**
+ * @file test_display.cpp
+ * @brief Host tests of the partial display updates: the bytes flushFrame() and sendSpan() put on the I2C bus for a
+ * screen change, counted by the simulated panel, and the panel content they leave.
+ */
+#include <unity.h>
+#include <display.h>
+#include <glyphs.h>
+#include <sim.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    const size_t FRAME_SIZE = 128 * 64 / 8;
+
+    /**
+     * @brief Bytes of one update, on the bus and as counted by the display.
+     */
+    struct Traffic
+    {
+        unsigned long bus;   // Bytes the panel received, including the address bytes.
+        unsigned long bytes; // Bytes the display counted, without the address bytes.
+        unsigned long spans; // Column spans sent.
+    };
+
+    /**
+     * @brief Shows a weight on the measurement screen and flushes it to the panel.
+     * @return The bytes of the flush.
+     */
+    Traffic showValue(Display &display, long value)
+    {
+        Display::Data data = {"Weight", value, "g"};
+        unsigned long bus = Sim::Panel::bytes();
+        Display::Statistics before = display.getStatistics();
+        display.showMeasurement(data);
+        display.loop();
+        Display::Statistics after = display.getStatistics();
+        TEST_ASSERT_EQUAL(before.flushes + 1, after.flushes);
+        Traffic traffic = {Sim::Panel::bytes() - bus, after.bytes - before.bytes, after.spans - before.spans};
+        return traffic;
+    }
+
+    Display *newDisplay()
+    {
+        Display *display = new Display(128, 64, -1, 3600000);
+        TEST_ASSERT_TRUE(display->init());
+        display->setFlushInterval(0);
+        return display;
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_unchanged_screen_sends_nothing()
+{
+    Display *display = newDisplay();
+    showValue(*display, 1000);
+    Traffic traffic = showValue(*display, 1000);
+    TEST_ASSERT_EQUAL(0, traffic.bus);
+    TEST_ASSERT_EQUAL(0, traffic.bytes);
+    TEST_ASSERT_EQUAL(0, traffic.spans);
+    delete display;
+}
+
+void test_new_screen_is_split_into_chunks()
+{
+    Display *display = newDisplay();
+    Traffic traffic = showValue(*display, 1000);
+    // the title, the value and the unit, but less than the whole framebuffer
+    TEST_ASSERT_GREATER_THAN(0, traffic.spans);
+    TEST_ASSERT_LESS_THAN(FRAME_SIZE, traffic.bytes);
+    // a span is a command transmission of 7 bytes and data transmissions of a control byte and at most
+    // DISPLAY_I2C_CHUNK columns, each transmission adds an address byte on the bus
+    unsigned long chunks = traffic.bus - traffic.bytes - traffic.spans;
+    unsigned long columns = traffic.bytes - 7 * traffic.spans - chunks;
+    TEST_ASSERT_GREATER_OR_EQUAL(traffic.spans, chunks);
+    TEST_ASSERT_LESS_OR_EQUAL(chunks * DISPLAY_I2C_CHUNK, columns);
+    TEST_ASSERT_GREATER_THAN((chunks - traffic.spans) * DISPLAY_I2C_CHUNK, columns);
+
+    char message[96];
+    snprintf(message, sizeof(message), "new measurement screen: %lu bytes on the bus in %lu spans", traffic.bus, traffic.spans);
+    TEST_MESSAGE(message);
+    delete display;
+}
+
+void test_digit_change_sends_only_the_digit()
+{
+    Display *display = newDisplay();
+    showValue(*display, 1000);
+    // one digit changes, its glyph columns of the value pages are sent as one span per page
+    Traffic traffic = showValue(*display, 1001);
+    TEST_ASSERT_EQUAL(GLYPH_PAGES, traffic.spans);
+    TEST_ASSERT_LESS_OR_EQUAL(GLYPH_PAGES * (7 + 1 + GLYPH_WIDTH + 2), traffic.bus);
+
+    char message[96];
+    snprintf(message, sizeof(message), "digit change: %lu bytes on the bus in %lu spans", traffic.bus, traffic.spans);
+    TEST_MESSAGE(message);
+    delete display;
+}
+
+void test_partial_updates_match_a_full_redraw()
+{
+    Display *display = newDisplay();
+    const long values[] = {1000, 1001, 999, -5, 88888, 1234};
+    for (long value : values)
+        showValue(*display, value);
+    uint8_t partial[FRAME_SIZE];
+    memcpy(partial, Sim::Panel::ram(), FRAME_SIZE);
+    delete display;
+
+    // a new display clears the panel completely and draws the last value on it
+    display = newDisplay();
+    showValue(*display, 1234);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(Sim::Panel::ram(), partial, FRAME_SIZE);
+    delete display;
+}
+
+void test_value_draw_benchmark()
+{
+    // a value redraw with the atlas, including the copy of the frame for the flusher
+    const long runs = 20000;
+    Display *display = newDisplay();
+    Display::Data data = {"Weight", 0, "g"};
+    display->showMeasurement(data);
+    auto started = std::chrono::steady_clock::now();
+    for (long i = 0; i < runs; i++)
+    {
+        data.result = -12345 + i;
+        display->showMeasurement(data);
+    }
+    double atlas = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / runs;
+    delete display;
+
+    // the same redraw with the GFX text of size 2 the readout used before the atlas
+    Adafruit_SSD1306 gfx(128, 64, &Wire, -1);
+    TEST_ASSERT_TRUE(gfx.begin(SSD1306_SWITCHCAPVCC, DISPLAY_I2C_ADDRESS));
+    static uint8_t frame[FRAME_SIZE];
+    started = std::chrono::steady_clock::now();
+    for (long i = 0; i < runs; i++)
+    {
+        gfx.fillRect(DISPLAY_VALUE_X, DISPLAY_VALUE_PAGE * 8, DISPLAY_VALUE_WIDTH, GLYPH_PAGES * 8, BLACK);
+        gfx.setTextSize(2);
+        gfx.setTextColor(WHITE);
+        gfx.setCursor(DISPLAY_VALUE_X, DISPLAY_VALUE_PAGE * 8);
+        gfx.print(-12345 + i);
+        memcpy(frame, gfx.getBuffer(), FRAME_SIZE);
+    }
+    double text = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / runs;
+
+    TEST_ASSERT_TRUE(atlas < text);
+    char message[96];
+    snprintf(message, sizeof(message), "ns per value redraw: glyph atlas %.1f, gfx text %.1f", atlas, text);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_unchanged_screen_sends_nothing);
+    RUN_TEST(test_new_screen_is_split_into_chunks);
+    RUN_TEST(test_digit_change_sends_only_the_digit);
+    RUN_TEST(test_partial_updates_match_a_full_redraw);
+    RUN_TEST(test_value_draw_benchmark);
+    return UNITY_END();
+}
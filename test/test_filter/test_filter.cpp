@@ -0,0 +1,259 @@
+/**
+ * @file test_filter.cpp
+ * @brief Host tests of the load cell filters and the stability detector.
+ */
+#include <unity.h>
+#include <filter.h>
+#include "traces.h"
+
+#include <chrono>
+
+namespace
+{
+    /**
+     * @brief Result of replaying a trace through a filter chain and a stability detector.
+     */
+    struct Replay
+    {
+        long settleMs = -1;     // Time from the start sample until the detector settled on the new load, -1 if never.
+        bool staysStable = true; // Whether the detector stayed stable once it was.
+        float settled = 0;      // Settled value at the end of the trace.
+        float maxError = 0;     // Largest deviation of the filtered output from the reference after the start sample.
+    };
+
+    Replay replay(const FilterChain::Config &config, const float *trace, size_t length, size_t start, float reference)
+    {
+        FilterChain chain;
+        chain.configure(config);
+        StabilityDetector detector;
+        detector.configure(2, 500);
+
+        Replay result;
+        bool left = false; // the detector left the stable state of the previous load
+        for (size_t i = 0; i < length; i++)
+        {
+            unsigned long ts = i * TRACE_INTERVAL_MS;
+            float output = chain.process(trace[i]);
+            detector.process(output, ts);
+            if (i < start)
+                continue;
+            if (!detector.isStable())
+            {
+                left = true;
+                if (result.settleMs >= 0)
+                    result.staysStable = false;
+            }
+            else if (left && result.settleMs < 0)
+            {
+                result.settleMs = ts - start * TRACE_INTERVAL_MS;
+            }
+            if (result.settleMs >= 0 && fabsf(output - reference) > result.maxError)
+                result.maxError = fabsf(output - reference);
+        }
+        result.settled = detector.getSettled();
+        return result;
+    }
+
+    /**
+     * @brief Returns the mean cost of one process() call of a filter in nanoseconds, replaying a trace many times.
+     */
+    template <typename Filter>
+    double costPerSample(Filter &filter, const float *trace, size_t length)
+    {
+        static const int RUNS = 2000;
+        volatile float sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < RUNS; run++)
+        {
+            for (size_t i = 0; i < length; i++)
+                sink = filter.process(trace[i]);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        (void)sink;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / (RUNS * length);
+    }
+
+    const size_t SPOOL_ON_LENGTH = sizeof(TRACE_SPOOL_ON) / sizeof(TRACE_SPOOL_ON[0]);
+    const size_t VIBRATION_LENGTH = sizeof(TRACE_VIBRATION) / sizeof(TRACE_VIBRATION[0]);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_median_rejects_spike()
+{
+    MedianFilter median;
+    median.configure(5, 0);
+    float output = 0;
+    const float samples[] = {100, 101, 900, 99, 100};
+    for (float sample : samples)
+        output = median.process(sample);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 100, output);
+}
+
+void test_hampel_keeps_inliers()
+{
+    MedianFilter hampel;
+    hampel.configure(5, 3);
+    const float samples[] = {100, 102, 98, 101};
+    for (float sample : samples)
+        hampel.process(sample);
+    // within 3 MADs the sample passes unchanged, a spike is replaced by the median of 102, 98, 101, 99, 500
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 99, hampel.process(99));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 101, hampel.process(500));
+}
+
+void test_disabled_stages_pass_through()
+{
+    FilterChain chain;
+    chain.configure({0, 0, 0, 0, 1});
+    TEST_ASSERT_EQUAL_FLOAT(123.5, chain.process(123.5));
+    TEST_ASSERT_EQUAL_FLOAT(-7, chain.process(-7));
+}
+
+void test_ema_step_response()
+{
+    EmaFilter ema;
+    ema.configure(0.5);
+    TEST_ASSERT_EQUAL_FLOAT(0, ema.process(0));
+    TEST_ASSERT_EQUAL_FLOAT(50, ema.process(100));
+    TEST_ASSERT_EQUAL_FLOAT(75, ema.process(100));
+}
+
+void test_kalman_converges()
+{
+    KalmanFilter kalman;
+    kalman.configure(0.01, 4);
+    float output = kalman.process(0);
+    for (int i = 0; i < 200; i++)
+        output = kalman.process(1000);
+    TEST_ASSERT_FLOAT_WITHIN(1, 1000, output);
+}
+
+void test_reset_forgets_state()
+{
+    EmaFilter ema;
+    ema.configure(0.1);
+    ema.process(1000);
+    ema.reset();
+    // the first sample after a reset seeds the average
+    TEST_ASSERT_EQUAL_FLOAT(5, ema.process(5));
+}
+
+void test_stability_needs_full_window_and_hold()
+{
+    StabilityDetector detector;
+    detector.configure(2, 500);
+    unsigned long ts = 0;
+    for (uint8_t i = 0; i < StabilityDetector::WINDOW - 1; i++, ts += 100)
+        detector.process(250, ts);
+    TEST_ASSERT_FALSE(detector.isStable());
+
+    // the window is full, the hold time starts now
+    detector.process(250, ts);
+    TEST_ASSERT_FALSE(detector.isStable());
+    for (int i = 0; i < 5; i++)
+        detector.process(250, ts += 100);
+    TEST_ASSERT_TRUE(detector.isStable());
+    TEST_ASSERT_TRUE(detector.hasSettled());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 250, detector.getSettled());
+}
+
+void test_stability_lost_on_step()
+{
+    StabilityDetector detector;
+    detector.configure(2, 0);
+    unsigned long ts = 0;
+    for (uint8_t i = 0; i < StabilityDetector::WINDOW; i++)
+        detector.process(250, ts += 100);
+    TEST_ASSERT_TRUE(detector.isStable());
+
+    detector.process(750, ts += 100);
+    TEST_ASSERT_FALSE(detector.isStable());
+    // the settled value stays until the signal settles again
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 250, detector.getSettled());
+}
+
+void test_trace_spool_on_with_default_chain()
+{
+    // the configuration template: median of 5 with Hampel 3, Kalman off, EMA 0.3
+    Replay result = replay({5, 3, 0.3, 0, 4}, TRACE_SPOOL_ON, SPOOL_ON_LENGTH, TRACE_SPOOL_ON_STEP, 1250);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, result.settleMs);
+    TEST_ASSERT_LESS_OR_EQUAL(3500, result.settleMs); // 3000 ms, bounce and window included
+    TEST_ASSERT_TRUE(result.staysStable);
+    TEST_ASSERT_FLOAT_WITHIN(1, 1250, result.settled);
+    // the vibration spikes don't reach the output
+    TEST_ASSERT_LESS_OR_EQUAL(3, result.maxError);
+}
+
+void test_trace_spool_on_with_kalman()
+{
+    Replay result = replay({5, 3, 0, 0.05, 4}, TRACE_SPOOL_ON, SPOOL_ON_LENGTH, TRACE_SPOOL_ON_STEP, 1250);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, result.settleMs);
+    TEST_ASSERT_LESS_OR_EQUAL(6500, result.settleMs); // 5800 ms, a small process noise trades latency for smoothness
+    TEST_ASSERT_TRUE(result.staysStable);
+    // latched while the estimate still creeps towards the load, within the 2 g tolerance of the detector
+    TEST_ASSERT_FLOAT_WITHIN(2, 1250, result.settled);
+}
+
+void test_trace_spool_on_unfiltered_spikes_break_stability()
+{
+    // without the median stage every spike resets the detector, the reason the chain exists
+    Replay result = replay({0, 0, 0, 0, 4}, TRACE_SPOOL_ON, SPOOL_ON_LENGTH, TRACE_SPOOL_ON_STEP, 1250);
+    TEST_ASSERT_FALSE(result.staysStable);
+    TEST_ASSERT_GREATER_THAN(90, result.maxError);
+}
+
+void test_trace_vibration_is_rejected()
+{
+    Replay result = replay({5, 3, 0.3, 0, 4}, TRACE_VIBRATION, VIBRATION_LENGTH, 0, 834);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, result.settleMs);
+    TEST_ASSERT_TRUE(result.staysStable);
+    TEST_ASSERT_FLOAT_WITHIN(1, 834, result.settled);
+    TEST_ASSERT_LESS_OR_EQUAL(3, result.maxError);
+}
+
+void test_stage_cost_per_sample()
+{
+    MedianFilter median;
+    median.configure(5, 0);
+    MedianFilter hampel;
+    hampel.configure(5, 3);
+    KalmanFilter kalman;
+    kalman.configure(0.05, 4);
+    EmaFilter ema;
+    ema.configure(0.3);
+    FilterChain chain;
+    chain.configure({5, 3, 0.3, 0.05, 4});
+
+    char message[160];
+    snprintf(message, sizeof(message), "ns per sample: median %.1f, hampel %.1f, kalman %.1f, ema %.1f, chain %.1f",
+             costPerSample(median, TRACE_SPOOL_ON, SPOOL_ON_LENGTH), costPerSample(hampel, TRACE_SPOOL_ON, SPOOL_ON_LENGTH),
+             costPerSample(kalman, TRACE_SPOOL_ON, SPOOL_ON_LENGTH), costPerSample(ema, TRACE_SPOOL_ON, SPOOL_ON_LENGTH),
+             costPerSample(chain, TRACE_SPOOL_ON, SPOOL_ON_LENGTH));
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_median_rejects_spike);
+    RUN_TEST(test_hampel_keeps_inliers);
+    RUN_TEST(test_disabled_stages_pass_through);
+    RUN_TEST(test_ema_step_response);
+    RUN_TEST(test_kalman_converges);
+    RUN_TEST(test_reset_forgets_state);
+    RUN_TEST(test_stability_needs_full_window_and_hold);
+    RUN_TEST(test_stability_lost_on_step);
+    RUN_TEST(test_trace_spool_on_with_default_chain);
+    RUN_TEST(test_trace_spool_on_with_kalman);
+    RUN_TEST(test_trace_spool_on_unfiltered_spikes_break_stability);
+    RUN_TEST(test_trace_vibration_is_rejected);
+    RUN_TEST(test_stage_cost_per_sample);
+    return UNITY_END();
+}
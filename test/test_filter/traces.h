@@ -0,0 +1,41 @@
+/**
+ * @file traces.h
+ * @brief Load cell traces replayed through the filters, in grams at 10 samples per second.
+ *
+ * The traces follow the shape of HX711 captures of a spool holder: about 1 g of gaussian noise, the bounce of a
+ * spool that is put down and single-sample spikes when the printer moves.
+ */
+#ifndef TRACES_H
+#define TRACES_H
+
+/**
+ * @brief Time between two samples of a trace in milliseconds.
+ */
+#define TRACE_INTERVAL_MS 100
+
+/**
+ * @brief Sample of TRACE_SPOOL_ON at which the spool touches the load cell.
+ */
+#define TRACE_SPOOL_ON_STEP 20
+
+// 0 g, a 1250 g spool is put down at sample 20 and bounces, two vibration spikes at samples 42 and 71
+static const float TRACE_SPOOL_ON[] = {
+    -0.2, 0.4, -0.2, -0.3, -0.7, -0.2, 0.9, 0.3, 0.8, 0.2, 0.3, 0.1, -1.3, 0.7, 0.4, 0.4, -1.4, -1.4, -0.7, -0.4,
+    310.5, 869.9, 1420.8, 1334.0, 1228.5, 1271.6, 1243.0, 1258.6, 1247.8, 1253.8, 1249.5, 1249.4, 1249.7, 1249.9,
+    1250.5, 1250.2, 1249.6, 1249.2, 1249.6, 1251.0, 1249.4, 1250.2, 1345.3, 1248.8, 1250.0, 1251.0, 1248.4, 1249.7,
+    1249.9, 1249.3, 1250.4, 1250.0, 1248.8, 1250.7, 1250.5, 1250.8, 1251.2, 1250.3, 1250.1, 1249.0, 1250.5, 1249.5,
+    1249.6, 1249.0, 1249.2, 1249.6, 1251.0, 1248.4, 1248.8, 1250.2, 1251.2, 1345.5, 1248.5, 1248.0, 1250.3, 1249.4,
+    1249.1, 1250.8, 1250.9, 1250.1, 1250.2, 1250.3, 1251.3, 1250.5, 1250.4, 1250.4, 1248.7, 1251.0, 1250.8, 1250.4,
+    1248.4, 1249.5, 1250.7, 1248.6, 1249.9, 1250.8, 1249.0, 1251.3, 1250.4, 1249.9};
+
+// 834 g with a 40-70 g vibration spike every 9th sample
+static const float TRACE_VIBRATION[] = {
+    834.2, 834.4, 834.1, 834.7, 789.2, 833.8, 833.2, 833.8, 833.9, 834.3, 834.9, 832.9, 833.4, 900.2, 834.2, 832.8,
+    834.2, 833.4, 833.8, 834.2, 833.9, 833.8, 791.1, 834.2, 833.8, 833.8, 833.3, 833.7, 834.8, 833.7, 834.4, 878.6,
+    834.0, 834.6, 833.8, 834.2, 835.1, 832.5, 833.3, 834.1, 896.4, 834.1, 833.1, 834.1, 833.6, 834.0, 834.5, 833.8,
+    833.5, 902.1, 834.6, 833.3, 834.0, 834.6, 834.5, 834.9, 833.0, 833.8, 769.6, 834.4, 834.4, 833.1, 834.1, 834.7,
+    833.9, 834.1, 834.5, 879.9, 833.6, 833.7, 834.3, 833.1, 833.0, 835.3, 834.2, 834.1, 892.2, 834.1, 834.9, 833.3,
+    833.1, 834.1, 834.1, 833.8, 833.3, 778.5, 834.5, 835.0, 833.5, 834.9, 834.6, 833.9, 832.8, 834.8, 793.1, 833.6,
+    833.4, 833.6, 833.5, 833.3};
+
+#endif
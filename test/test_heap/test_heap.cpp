@@ -0,0 +1,118 @@
+/**
+ * @file test_heap.cpp
+ * @brief Host test that reading a tag, its callback and publishing the status don't touch the heap.
+ *
+ * The global operator new and delete are replaced with counting ones and the unchanged setup() and loop() of the
+ * firmware run against the simulated devices. The fakes format on the stack like the Arduino core and keep no
+ * messages while counting, so every counted allocation comes from the firmware.
+ */
+#include <unity.h>
+#include <rfid.h>
+#include <sim.h>
+#include <new>
+#include <stdlib.h>
+
+void setup();
+
+extern RFID rfid;
+extern TagData rTag;
+
+namespace
+{
+    bool counting = false;
+    unsigned long allocations = 0;
+
+    void *allocate(size_t size)
+    {
+        if (counting)
+            allocations++;
+        void *block = malloc(size > 0 ? size : 1);
+        if (block == nullptr)
+            throw std::bad_alloc();
+        return block;
+    }
+}
+
+void *operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+    return allocate(size);
+}
+
+void operator delete(void *block) noexcept
+{
+    free(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+    free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    free(block);
+}
+
+void operator delete[](void *block, size_t) noexcept
+{
+    free(block);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_tag_read_and_status_publish_do_not_allocate()
+{
+    setup();
+    // WiFi, the broker and the tare
+    Sim::runLoop(5000);
+
+    const std::vector<uint8_t> firstUid = {0x04, 0xA1, 0xB2, 0x01};
+    const std::vector<uint8_t> secondUid = {0x04, 0xA1, 0xB2, 0x02};
+    TagData firstSpool = Sim::Tag::spool("3f2504e0-4f89-41d3-9a0c-0305e82c3301");
+    TagData secondSpool = Sim::Tag::spool("6fa459ea-ee8a-3ca4-894e-db77e160355e");
+    std::vector<uint8_t> first = Sim::Tag::write(firstUid, rfid, firstSpool);
+    std::vector<uint8_t> second = Sim::Tag::write(secondUid, rfid, secondSpool);
+    TEST_ASSERT_FALSE(first.empty());
+    TEST_ASSERT_FALSE(second.empty());
+    byte secondId[16];
+    Conversion::parseUuid("6fa459ea-ee8a-3ca4-894e-db77e160355e", secondId);
+
+    // the first spool passes the same path once, the fakes grow their buffers lazily
+    Sim::LoadCell::setWeight(1250);
+    Sim::Tag::place(firstUid, first.data());
+    Sim::runLoop(5000);
+    Sim::Tag::remove();
+    Sim::LoadCell::setWeight(0);
+    Sim::runLoop(5000);
+
+    Sim::Broker::keep(false);
+    unsigned long published = Sim::Broker::count();
+    Sim::LoadCell::setWeight(1250);
+    Sim::Tag::place(secondUid, second.data());
+    counting = true;
+    Sim::runLoop(5000);
+    counting = false;
+    Sim::Broker::keep(true);
+
+    TEST_ASSERT_EQUAL_MEMORY(secondId, rTag.spoolId, sizeof(secondId));
+    TEST_ASSERT_GREATER_THAN(published, Sim::Broker::count());
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_tag_read_and_status_publish_do_not_allocate);
+    return UNITY_END();
+}
@@ -0,0 +1,79 @@
+/**
+ * @file test_history.cpp
+ * @brief Host tests of the weight history ring.
+ */
+#include <unity.h>
+#include <history.h>
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_averages_one_interval_into_a_point()
+{
+    History history(1000);
+    TEST_ASSERT_FALSE(history.add(100, 0));
+    TEST_ASSERT_FALSE(history.add(200, 500));
+    TEST_ASSERT_EQUAL(0, history.count());
+
+    // the sample that completes the interval belongs to the point
+    TEST_ASSERT_TRUE(history.add(300, 1000));
+    TEST_ASSERT_EQUAL(1, history.count());
+    TEST_ASSERT_EQUAL(0, history.newest());
+    TEST_ASSERT_EQUAL(200, history.point(0));
+}
+
+void test_has_marks_written_slots()
+{
+    History history(0);
+    for (long i = 0; i < 3; i++)
+        TEST_ASSERT_TRUE(history.add(i, i));
+    TEST_ASSERT_TRUE(history.has(2));
+    TEST_ASSERT_FALSE(history.has(3));
+    TEST_ASSERT_FALSE(history.has(HISTORY_SIZE - 1));
+}
+
+void test_wraps_after_history_size_points()
+{
+    History history(0);
+    for (long i = 0; i < HISTORY_SIZE + 5; i++)
+        history.add(i, i);
+    TEST_ASSERT_EQUAL(HISTORY_SIZE, history.count());
+    TEST_ASSERT_EQUAL(4, history.newest());
+    TEST_ASSERT_EQUAL(HISTORY_SIZE + 4, history.point(4));
+    TEST_ASSERT_EQUAL(5, history.point(5));
+    TEST_ASSERT_TRUE(history.has(HISTORY_SIZE - 1));
+}
+
+void test_interval_change_applies_to_next_point()
+{
+    History history(1000);
+    history.add(10, 0);
+    history.setInterval(100);
+    TEST_ASSERT_TRUE(history.add(30, 100));
+    TEST_ASSERT_EQUAL(20, history.point(history.newest()));
+}
+
+void test_averages_large_values_without_overflow()
+{
+    History history(10);
+    for (unsigned long ts = 0; ts < 10; ts++)
+        history.add(2000000000L, ts);
+    TEST_ASSERT_TRUE(history.add(2000000000L, 10));
+    TEST_ASSERT_EQUAL(2000000000L, history.point(0));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_averages_one_interval_into_a_point);
+    RUN_TEST(test_has_marks_written_slots);
+    RUN_TEST(test_wraps_after_history_size_points);
+    RUN_TEST(test_interval_change_applies_to_next_point);
+    RUN_TEST(test_averages_large_values_without_overflow);
+    return UNITY_END();
+}
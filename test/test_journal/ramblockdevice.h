@@ -0,0 +1,99 @@
+/**
+ * @file ramblockdevice.h
+ * @brief BlockDevice in RAM that follows the NOR flash rules and can cut the power in the middle of a write.
+ */
+#ifndef RAMBLOCKDEVICE_H
+#define RAMBLOCKDEVICE_H
+
+#include <blockdevice.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * @brief Class for a simulated NOR flash region.
+ */
+class RamBlockDevice : public BlockDevice
+{
+private:
+    std::vector<uint8_t> memory; // Content of the flash.
+    size_t sector;               // Size of a sector in bytes.
+    long budget = -1;            // Bytes that can still be programmed before the power loss, -1 for no limit.
+
+public:
+    unsigned long reads = 0; // Calls of read().
+
+    /**
+     * @brief Constructor for the RamBlockDevice class, the flash starts erased.
+     * @param sectors Number of sectors.
+     * @param sectorSize Size of a sector in bytes.
+     */
+    RamBlockDevice(size_t sectors, size_t sectorSize) : memory(sectors * sectorSize, 0xFF), sector(sectorSize) {}
+
+    /**
+     * @brief Cuts the power after some more programmed bytes, erases fail from then on as well.
+     * @param bytes Bytes programmed before the power loss, -1 restores the power.
+     */
+    void powerLossAfter(long bytes)
+    {
+        budget = bytes;
+    }
+
+    /**
+     * @brief Returns the content of the flash for corrupting it.
+     */
+    uint8_t *data()
+    {
+        return memory.data();
+    }
+
+    bool begin() override
+    {
+        return true;
+    }
+
+    size_t size() override
+    {
+        return memory.size();
+    }
+
+    size_t sectorSize() override
+    {
+        return sector;
+    }
+
+    bool read(size_t offset, void *buffer, size_t length) override
+    {
+        if (offset + length > memory.size())
+            return false;
+        reads++;
+        memcpy(buffer, memory.data() + offset, length);
+        return true;
+    }
+
+    bool program(size_t offset, const void *buffer, size_t length) override
+    {
+        if (offset + length > memory.size())
+            return false;
+        const uint8_t *bytes = (const uint8_t *)buffer;
+        for (size_t i = 0; i < length; i++)
+        {
+            if (budget == 0)
+                return false;
+            if (budget > 0)
+                budget--;
+            // programming only clears bits
+            memory[offset + i] &= bytes[i];
+        }
+        return true;
+    }
+
+    bool erase(size_t offset) override
+    {
+        if (offset % sector != 0 || offset >= memory.size() || budget == 0)
+            return false;
+        memset(memory.data() + offset, 0xFF, sector);
+        return true;
+    }
+};
+
+#endif
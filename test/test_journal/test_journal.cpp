@@ -0,0 +1,256 @@
+/**
+ * @file test_journal.cpp
+ * @brief Host tests of the journal on a RAM flash: ordering, recovery after a reset, torn writes and the boot scan.
+ */
+#include <unity.h>
+#include <journal.h>
+#include "ramblockdevice.h"
+
+namespace
+{
+    // 4 sectors of 4 slots, small enough to wrap the ring in a few appends
+    const size_t SMALL_SECTORS = 4;
+    const size_t SMALL_SECTOR_SIZE = 4 * JOURNAL_SLOT_SIZE;
+
+    bool append(Journal &journal, uint32_t value)
+    {
+        return journal.append(&value, sizeof(value));
+    }
+
+    /**
+     * @brief Peeks the oldest pending record and checks its payload against its sequence number.
+     * @return The sequence number, 0 if no record is pending.
+     */
+    uint32_t peekSeq(Journal &journal)
+    {
+        byte payload[Journal::MAX_PAYLOAD];
+        uint8_t length;
+        uint32_t seq;
+        if (!journal.peek(payload, length, seq))
+            return 0;
+        uint32_t value;
+        TEST_ASSERT_EQUAL(sizeof(value), length);
+        memcpy(&value, payload, sizeof(value));
+        TEST_ASSERT_EQUAL_UINT32(seq * 10, value);
+        return seq;
+    }
+
+    /**
+     * @brief Appends records whose payload is ten times their sequence number.
+     */
+    void appendRecords(Journal &journal, uint32_t firstSeq, uint32_t count)
+    {
+        for (uint32_t seq = firstSeq; seq < firstSeq + count; seq++)
+            TEST_ASSERT_TRUE(append(journal, seq * 10));
+    }
+
+    void consumeRecords(Journal &journal, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            TEST_ASSERT_TRUE(journal.consume());
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_records_are_consumed_in_order()
+{
+    RamBlockDevice device(SMALL_SECTORS, SMALL_SECTOR_SIZE);
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL(0, peekSeq(journal));
+
+    appendRecords(journal, 1, 3);
+    TEST_ASSERT_EQUAL(3, journal.pending());
+    for (uint32_t seq = 1; seq <= 3; seq++)
+    {
+        TEST_ASSERT_EQUAL(seq, peekSeq(journal));
+        TEST_ASSERT_TRUE(journal.consume());
+    }
+    TEST_ASSERT_EQUAL(0, journal.pending());
+    TEST_ASSERT_FALSE(journal.consume());
+}
+
+void test_payload_too_large_is_rejected()
+{
+    RamBlockDevice device(SMALL_SECTORS, SMALL_SECTOR_SIZE);
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    byte payload[Journal::MAX_PAYLOAD + 1] = {0};
+    TEST_ASSERT_FALSE(journal.append(payload, sizeof(payload)));
+    TEST_ASSERT_TRUE(journal.append(payload, Journal::MAX_PAYLOAD));
+}
+
+void test_reopen_keeps_pending_records()
+{
+    RamBlockDevice device(SMALL_SECTORS, SMALL_SECTOR_SIZE);
+    {
+        Journal journal(&device);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 1, 6);
+        consumeRecords(journal, 2);
+    }
+
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL(4, journal.pending());
+    TEST_ASSERT_EQUAL(3, peekSeq(journal));
+    // sequence numbers continue after the newest record
+    appendRecords(journal, 7, 1);
+    consumeRecords(journal, 4);
+    TEST_ASSERT_EQUAL(7, peekSeq(journal));
+}
+
+void test_reopen_with_everything_consumed()
+{
+    RamBlockDevice device(SMALL_SECTORS, SMALL_SECTOR_SIZE);
+    {
+        Journal journal(&device);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 1, 5);
+        consumeRecords(journal, 5);
+    }
+
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL(0, journal.pending());
+    appendRecords(journal, 6, 1);
+    TEST_ASSERT_EQUAL(6, peekSeq(journal));
+}
+
+void test_torn_append_is_ignored()
+{
+    RamBlockDevice device(SMALL_SECTORS, SMALL_SECTOR_SIZE);
+    {
+        Journal journal(&device);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 1, 2);
+        // the power goes while the header is programmed, the magic is never written
+        device.powerLossAfter(6);
+        TEST_ASSERT_FALSE(append(journal, 30));
+        device.powerLossAfter(-1);
+    }
+
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL(2, journal.pending());
+    // the torn slot is skipped, its sequence number is used again
+    appendRecords(journal, 3, 1);
+    for (uint32_t seq = 1; seq <= 3; seq++)
+    {
+        TEST_ASSERT_EQUAL(seq, peekSeq(journal));
+        TEST_ASSERT_TRUE(journal.consume());
+    }
+    TEST_ASSERT_EQUAL(0, peekSeq(journal));
+}
+
+void test_crc_mismatch_is_skipped()
+{
+    RamBlockDevice device(SMALL_SECTORS, SMALL_SECTOR_SIZE);
+    {
+        Journal journal(&device);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 1, 3);
+    }
+    // a bit of the second payload flips
+    device.data()[JOURNAL_SLOT_SIZE + JOURNAL_HEADER_SIZE] ^= 0x04;
+
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL(1, peekSeq(journal));
+    TEST_ASSERT_TRUE(journal.consume());
+    TEST_ASSERT_EQUAL(3, peekSeq(journal));
+    TEST_ASSERT_TRUE(journal.consume());
+    TEST_ASSERT_EQUAL(0, peekSeq(journal));
+}
+
+void test_full_ring_drops_oldest_sector()
+{
+    RamBlockDevice device(SMALL_SECTORS, SMALL_SECTOR_SIZE);
+    {
+        Journal journal(&device);
+        TEST_ASSERT_TRUE(journal.begin());
+        // 16 slots: records 17 to 20 replace 1 to 4 in the first sector
+        appendRecords(journal, 1, 20);
+        TEST_ASSERT_EQUAL(16, journal.pending());
+        TEST_ASSERT_EQUAL(4, journal.getStatistics().dropped);
+        TEST_ASSERT_EQUAL(5, peekSeq(journal));
+    }
+
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL(16, journal.pending());
+    TEST_ASSERT_EQUAL(5, peekSeq(journal));
+    consumeRecords(journal, 6);
+
+    Journal reopened(&device);
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_EQUAL(10, reopened.pending());
+    TEST_ASSERT_EQUAL(11, peekSeq(reopened));
+    appendRecords(reopened, 21, 1);
+    consumeRecords(reopened, 10);
+    TEST_ASSERT_EQUAL(21, peekSeq(reopened));
+}
+
+void test_power_loss_after_erase()
+{
+    RamBlockDevice device(SMALL_SECTORS, SMALL_SECTOR_SIZE);
+    {
+        Journal journal(&device);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 1, 16);
+        consumeRecords(journal, 10);
+    }
+    // the next append erased the first sector, then the power went
+    TEST_ASSERT_TRUE(device.erase(0));
+
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL(6, journal.pending());
+    TEST_ASSERT_EQUAL(11, peekSeq(journal));
+    appendRecords(journal, 17, 1);
+    consumeRecords(journal, 6);
+    TEST_ASSERT_EQUAL(17, peekSeq(journal));
+}
+
+void test_boot_scan_reads_few_slots()
+{
+    // 64 sectors of 4 KB like a part of the ESP32 data partition, 4096 slots
+    RamBlockDevice device(64, 4096);
+    const size_t slots = device.size() / JOURNAL_SLOT_SIZE;
+    {
+        Journal journal(&device);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 1, 3000);
+        consumeRecords(journal, 1000);
+    }
+
+    device.reads = 0;
+    Journal journal(&device);
+    TEST_ASSERT_TRUE(journal.begin());
+    // a record per sector, the head sector, the binary search and the tail sector
+    TEST_ASSERT_LESS_THAN(slots / 16, device.reads);
+    TEST_ASSERT_EQUAL(2000, journal.pending());
+    TEST_ASSERT_EQUAL(1001, peekSeq(journal));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_are_consumed_in_order);
+    RUN_TEST(test_payload_too_large_is_rejected);
+    RUN_TEST(test_reopen_keeps_pending_records);
+    RUN_TEST(test_reopen_with_everything_consumed);
+    RUN_TEST(test_torn_append_is_ignored);
+    RUN_TEST(test_crc_mismatch_is_skipped);
+    RUN_TEST(test_full_ring_drops_oldest_sector);
+    RUN_TEST(test_power_loss_after_erase);
+    RUN_TEST(test_boot_scan_reads_few_slots);
+    return UNITY_END();
+}
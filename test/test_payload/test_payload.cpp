@@ -0,0 +1,151 @@
+/**
+ * @file test_payload.cpp
+ * @brief Host benchmark of the JSON and MessagePack payload formats: the size of the status messages the unchanged
+ * firmware publishes and the time to encode one.
+ */
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <rfid.h>
+#include <sim.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+void setup();
+
+extern RFID rfid;
+
+namespace
+{
+    const char *STATUS_TOPIC = "status/scale-01";
+    const char *MSGPACK_STATUS_TOPIC = "status/scale-01/msgpack";
+    const char *COMMAND_TOPIC = "command/scale-01";
+    const unsigned long BENCHMARK_RUNS = 100000;
+
+    /**
+     * @brief Returns the last message published on a topic, an empty one if there is none.
+     */
+    Sim::Broker::Message lastOn(const char *topic)
+    {
+        const std::vector<Sim::Broker::Message> &published = Sim::Broker::published();
+        for (size_t i = published.size(); i > 0; i--)
+        {
+            if (published[i - 1].topic == topic)
+                return published[i - 1];
+        }
+        return Sim::Broker::Message();
+    }
+
+    /**
+     * @brief Fills a document like the status message of a spool in the settled mode.
+     */
+    void statusDocument(JsonDocument &doc)
+    {
+        doc["device_id"] = "scale-01";
+        doc["spool_id"] = "9f1c8a52-3b7e-4d21-a6f0-5c2e8b9d4a17";
+        doc["value"] = 834;
+        doc["stable"] = true;
+        doc["ts"] = 1760000000UL;
+    }
+
+    /**
+     * @brief Encodes a document repeatedly into a buffer.
+     * @param length Length of the payload.
+     * @return Host nanoseconds per encode.
+     */
+    double nsPerEncode(size_t (*encode)(const JsonDocument &, char *, size_t), const JsonDocument &doc, size_t &length)
+    {
+        char buffer[256];
+        auto started = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < BENCHMARK_RUNS; i++)
+            length = encode(doc, buffer, sizeof(buffer));
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / BENCHMARK_RUNS;
+    }
+
+    size_t encodeJson(const JsonDocument &doc, char *buffer, size_t size)
+    {
+        return serializeJson(doc, buffer, size);
+    }
+
+    size_t encodeMsgPack(const JsonDocument &doc, char *buffer, size_t size)
+    {
+        return serializeMsgPack(doc, buffer, size);
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_published_status_sizes()
+{
+    setup();
+    // WiFi, the broker and the tare
+    Sim::runLoop(5000);
+
+    const std::vector<uint8_t> uid = {0x04, 0xA1, 0xB2, 0x17};
+    TagData spool = Sim::Tag::spool("9f1c8a52-3b7e-4d21-a6f0-5c2e8b9d4a17");
+    std::vector<uint8_t> memory = Sim::Tag::write(uid, rfid, spool);
+    TEST_ASSERT_FALSE(memory.empty());
+    Sim::LoadCell::setWeight(834);
+    Sim::Tag::place(uid, memory.data());
+    Sim::runLoop(10000);
+    Sim::Broker::Message json = lastOn(STATUS_TOPIC);
+
+    Sim::Broker::inject(COMMAND_TOPIC, "{\"action\":\"configure\",\"payload\":{\"format\":\"msgpack\"}}");
+    Sim::runLoop(10000);
+    Sim::Broker::Message msgpack = lastOn(MSGPACK_STATUS_TOPIC);
+
+    // the same spool and weight in both formats
+    TEST_ASSERT_FALSE(json.payload.empty());
+    TEST_ASSERT_FALSE(msgpack.payload.empty());
+    TEST_ASSERT_NOT_NULL(strstr(json.payload.c_str(), "\"spool_id\":\"9f1c8a52-3b7e-4d21-a6f0-5c2e8b9d4a17\""));
+    TEST_ASSERT_TRUE(msgpack.payload.find("9f1c8a52-3b7e-4d21-a6f0-5c2e8b9d4a17") != std::string::npos);
+    TEST_ASSERT_EQUAL_HEX8(0x80, (uint8_t)msgpack.payload[0] & 0xF0); // fixmap
+    TEST_ASSERT_LESS_THAN(json.payload.size(), msgpack.payload.size());
+
+    char message[96];
+    snprintf(message, sizeof(message), "published status bytes: json %lu, msgpack %lu",
+             (unsigned long)json.payload.size(), (unsigned long)msgpack.payload.size());
+    TEST_MESSAGE(message);
+}
+
+void test_heartbeat_is_streamed()
+{
+    // the first heartbeat is due a minute after the start, in the format configured above
+    Sim::runLoop(40000);
+    Sim::Broker::Message heartbeat = lastOn("heartbeat/scale-01/msgpack");
+    TEST_ASSERT_FALSE(heartbeat.payload.empty());
+    TEST_ASSERT_TRUE(heartbeat.payload.find("display_bytes") != std::string::npos);
+}
+
+void test_encode_benchmark()
+{
+    StaticJsonDocument<256> doc;
+    statusDocument(doc);
+    size_t jsonLength = 0, msgpackLength = 0;
+    double json = nsPerEncode(encodeJson, doc, jsonLength);
+    double msgpack = nsPerEncode(encodeMsgPack, doc, msgpackLength);
+
+    TEST_ASSERT_EQUAL(measureJson(doc), jsonLength);
+    TEST_ASSERT_EQUAL(measureMsgPack(doc), msgpackLength);
+    TEST_ASSERT_LESS_THAN(jsonLength, msgpackLength);
+
+    char message[128];
+    snprintf(message, sizeof(message), "status encode: json %lu bytes %.1f ns, msgpack %lu bytes %.1f ns",
+             (unsigned long)jsonLength, json, (unsigned long)msgpackLength, msgpack);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_published_status_sizes);
+    RUN_TEST(test_heartbeat_is_streamed);
+    RUN_TEST(test_encode_benchmark);
+    return UNITY_END();
+}
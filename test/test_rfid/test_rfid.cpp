@@ -0,0 +1,231 @@
+/**
+ * @file test_rfid.cpp
+ * @brief Host tests of the v1 and v2 tag layouts, read and written through the simulated MFRC522.
+ */
+#include <unity.h>
+#include <rfid.h>
+#include <sim.h>
+#include <string.h>
+
+namespace
+{
+    const char *SPOOL_ID = "3f2504e0-4f89-41d3-9a0c-0305e82c3301";
+
+    RFID reader(5, 4); // the simulated MFRC522 doesn't use its pins
+    TagData received;
+    unsigned reads = 0;
+    uint8_t nextUid = 1;
+
+    void onTag(TagData &data)
+    {
+        received = data;
+        reads++;
+    }
+
+    /**
+     * @brief Places a tag under a UID not seen before, so the cache of the reader never answers.
+     */
+    void placeTag(const uint8_t *memory)
+    {
+        Sim::Tag::place({0x04, 0xA1, 0xB2, nextUid++}, memory);
+    }
+
+    /**
+     * @brief Returns the memory of a blank tag with default keys.
+     */
+    std::vector<uint8_t> blankMemory()
+    {
+        placeTag(nullptr);
+        std::vector<uint8_t> memory = Sim::Tag::memory();
+        Sim::Tag::remove();
+        return memory;
+    }
+
+    uint8_t *block(std::vector<uint8_t> &memory, size_t id)
+    {
+        return memory.data() + id * Sim::Tag::BLOCK_SIZE;
+    }
+
+    /**
+     * @brief Polls until the reader reported a tag or gave up on it.
+     * @return True if the callback was called.
+     */
+    bool readTag()
+    {
+        unsigned before = reads;
+        for (int i = 0; i < 3 && reads == before; i++)
+            reader.loop();
+        return reads != before;
+    }
+
+    void assertTagEqual(const TagData &expected, const TagData &actual)
+    {
+        TEST_ASSERT_EQUAL_MEMORY(expected.spoolId, actual.spoolId, sizeof(expected.spoolId));
+        TEST_ASSERT_EQUAL(expected.spoolWeight, actual.spoolWeight);
+        TEST_ASSERT_EQUAL_STRING(expected.material, actual.material);
+        TEST_ASSERT_EQUAL_STRING(expected.color, actual.color);
+        TEST_ASSERT_EQUAL_STRING(expected.manufacturer, actual.manufacturer);
+        TEST_ASSERT_EQUAL_STRING(expected.spoolName, actual.spoolName);
+        TEST_ASSERT_EQUAL(expected.timestamp, actual.timestamp);
+    }
+
+    /**
+     * @brief Writes a tag to a blank tag and returns the tag memory.
+     */
+    std::vector<uint8_t> writeTag(TagData &data)
+    {
+        std::vector<uint8_t> memory = Sim::Tag::write({0x04, 0xA1, 0xB2, nextUid++}, reader, data);
+        TEST_ASSERT_FALSE(memory.empty());
+        return memory;
+    }
+}
+
+void setUp()
+{
+    reader.init(onTag);
+    // poll on every loop() call
+    reader.setPolling(0, 0, 0);
+    memset(&received, 0, sizeof(received));
+}
+
+void tearDown()
+{
+    Sim::Tag::remove();
+}
+
+void test_v1_tag_is_decoded()
+{
+    // fixed 16 byte blocks: spool id, weight, manufacturer, material, color, name over three blocks, timestamp
+    std::vector<uint8_t> memory = blankMemory();
+    TagData expected = Sim::Tag::spool(SPOOL_ID);
+    memcpy(block(memory, 1), expected.spoolId, 16);
+    Conversion::packULong(expected.spoolWeight, block(memory, 2));
+    strcpy((char *)block(memory, 4), expected.manufacturer);
+    strcpy((char *)block(memory, 5), expected.material);
+    strcpy((char *)block(memory, 6), expected.color);
+    strcpy((char *)block(memory, 8), expected.spoolName);
+    Conversion::packULong(expected.timestamp, block(memory, 12));
+
+    placeTag(memory.data());
+    TEST_ASSERT_TRUE(readTag());
+    assertTagEqual(expected, received);
+}
+
+void test_v1_name_spans_three_blocks()
+{
+    std::vector<uint8_t> memory = blankMemory();
+    const char *name = "A name that is longer than a single block of 16";
+    TEST_ASSERT_EQUAL(TAG_NAME_LENGTH - 1, strlen(name));
+    memcpy(block(memory, 1), "0123456789abcdef", 16);
+    // blocks 8, 9 and 10 are adjacent on the tag
+    memcpy(block(memory, 8), name, strlen(name));
+
+    placeTag(memory.data());
+    TEST_ASSERT_TRUE(readTag());
+    TEST_ASSERT_EQUAL_STRING(name, received.spoolName);
+}
+
+void test_v2_round_trip()
+{
+    TagData expected = Sim::Tag::spool(SPOOL_ID);
+    std::vector<uint8_t> memory = writeTag(expected);
+
+    uint8_t *header = block(memory, 1);
+    TEST_ASSERT_EQUAL_HEX8(TAG_MAGIC0, header[0]);
+    TEST_ASSERT_EQUAL_HEX8(TAG_MAGIC1, header[1]);
+    TEST_ASSERT_EQUAL(TAG_VERSION, header[2]);
+    // this spool fits into sectors 0 and 1, sector 2 stays blank
+    TEST_ASSERT_LESS_OR_EQUAL(5 * TAG_BLOCK_SIZE, header[3]);
+    std::vector<uint8_t> blank = blankMemory();
+    TEST_ASSERT_EQUAL_MEMORY(block(blank, 8), block(memory, 8), 3 * TAG_BLOCK_SIZE);
+
+    placeTag(memory.data());
+    TEST_ASSERT_TRUE(readTag());
+    assertTagEqual(expected, received);
+}
+
+void test_v2_without_color()
+{
+    TagData expected = Sim::Tag::spool(SPOOL_ID);
+    expected.color[0] = '\0';
+    std::vector<uint8_t> memory = writeTag(expected);
+    TEST_ASSERT_EQUAL(0, block(memory, 1)[8] & TAG_FLAG_COLOR);
+
+    placeTag(memory.data());
+    TEST_ASSERT_TRUE(readTag());
+    assertTagEqual(expected, received);
+}
+
+void test_v2_max_length_text_fields()
+{
+    TagData expected = Sim::Tag::spool(SPOOL_ID);
+    memset(expected.material, 'M', TAG_MATERIAL_LENGTH);
+    expected.material[TAG_MATERIAL_LENGTH] = '\0';
+    memset(expected.manufacturer, 'F', TAG_MANUFACTURER_LENGTH);
+    expected.manufacturer[TAG_MANUFACTURER_LENGTH] = '\0';
+    memset(expected.spoolName, 'N', TAG_NAME_LENGTH);
+    expected.spoolName[TAG_NAME_LENGTH] = '\0';
+
+    std::vector<uint8_t> memory = writeTag(expected);
+    TEST_ASSERT_LESS_OR_EQUAL(TAG_RECORD_SIZE, block(memory, 1)[3]);
+
+    placeTag(memory.data());
+    TEST_ASSERT_TRUE(readTag());
+    assertTagEqual(expected, received);
+}
+
+void test_v2_crc_mismatch_is_rejected()
+{
+    TagData data = Sim::Tag::spool(SPOOL_ID);
+    std::vector<uint8_t> memory = writeTag(data);
+
+    // the material follows the fixed fields in block 4, the first data block of sector 1
+    block(memory, 4)[5] ^= 0x01;
+    placeTag(memory.data());
+    TEST_ASSERT_FALSE(readTag());
+}
+
+void test_v2_length_out_of_range_is_rejected()
+{
+    TagData data = Sim::Tag::spool(SPOOL_ID);
+    std::vector<uint8_t> memory = writeTag(data);
+
+    block(memory, 1)[3] = TAG_RECORD_SIZE + 1;
+    placeTag(memory.data());
+    TEST_ASSERT_FALSE(readTag());
+}
+
+void test_v2_rewrite_keeps_fields_not_given()
+{
+    TagData first = Sim::Tag::spool(SPOOL_ID);
+    std::vector<uint8_t> memory = writeTag(first);
+    placeTag(memory.data());
+
+    TagData update;
+    memset(&update, 0, sizeof(update));
+    memcpy(update.spoolId, first.spoolId, sizeof(update.spoolId));
+    update.spoolWeight = 750;
+    TEST_ASSERT_TRUE(reader.write(update));
+    memory = Sim::Tag::memory();
+    Sim::Tag::remove();
+
+    placeTag(memory.data());
+    TEST_ASSERT_TRUE(readTag());
+    TagData expected = first;
+    expected.spoolWeight = 750;
+    assertTagEqual(expected, received);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_v1_tag_is_decoded);
+    RUN_TEST(test_v1_name_spans_three_blocks);
+    RUN_TEST(test_v2_round_trip);
+    RUN_TEST(test_v2_without_color);
+    RUN_TEST(test_v2_max_length_text_fields);
+    RUN_TEST(test_v2_crc_mismatch_is_rejected);
+    RUN_TEST(test_v2_length_out_of_range_is_rejected);
+    RUN_TEST(test_v2_rewrite_keeps_fields_not_given);
+    return UNITY_END();
+}
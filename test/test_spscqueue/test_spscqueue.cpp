@@ -0,0 +1,144 @@
+/**
+ * @file test_spscqueue.cpp
+ * @brief Host tests of the SpscQueue ring buffer.
+ */
+#include <unity.h>
+#include <spscqueue.h>
+#include <stdio.h>
+#include <thread>
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_empty_queue()
+{
+    SpscQueue<int, 4> queue;
+    int item = -1;
+    TEST_ASSERT_TRUE(queue.isEmpty());
+    TEST_ASSERT_EQUAL(0, queue.size());
+    TEST_ASSERT_FALSE(queue.pop(item));
+    TEST_ASSERT_EQUAL(-1, item);
+}
+
+void test_keeps_one_slot_free()
+{
+    SpscQueue<int, 4> queue;
+    TEST_ASSERT_TRUE(queue.push(1));
+    TEST_ASSERT_TRUE(queue.push(2));
+    TEST_ASSERT_TRUE(queue.push(3));
+    TEST_ASSERT_FALSE(queue.push(4));
+    TEST_ASSERT_EQUAL(3, queue.size());
+}
+
+void test_fifo_order_across_wrap()
+{
+    SpscQueue<int, 4> queue;
+    int item;
+    for (int i = 0; i < 100; i++)
+    {
+        TEST_ASSERT_TRUE(queue.push(i));
+        TEST_ASSERT_TRUE(queue.push(i + 1000));
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL(i, item);
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL(i + 1000, item);
+    }
+    TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+void test_clear_drops_items()
+{
+    SpscQueue<int, 8> queue;
+    int item;
+    for (int i = 0; i < 5; i++)
+        queue.push(i);
+    queue.clear();
+    TEST_ASSERT_TRUE(queue.isEmpty());
+    TEST_ASSERT_FALSE(queue.pop(item));
+
+    // the slots are reused after clearing
+    TEST_ASSERT_TRUE(queue.push(42));
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(42, item);
+}
+
+namespace
+{
+    /**
+     * @brief Item of the stress test, the check field detects an item copied while it was written.
+     */
+    struct Item
+    {
+        unsigned long seq;
+        unsigned long check;
+    };
+
+    const unsigned long STRESS_ITEMS = 2000000;
+
+    // a small queue keeps the producer running into a full queue and the consumer into an empty one
+    SpscQueue<Item, 16> stressQueue;
+    unsigned long rejected = 0;
+
+    void produce()
+    {
+        for (unsigned long seq = 0; seq < STRESS_ITEMS;)
+        {
+            Item item = {seq, ~seq};
+            if (stressQueue.push(item))
+                seq++;
+            else
+            {
+                rejected++;
+                // on a single core host the other side only runs when this one gives up the CPU
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+void test_threads_hand_over_every_item_in_order()
+{
+    std::thread producer(produce);
+
+    unsigned long expected = 0;
+    unsigned long torn = 0;
+    unsigned long misordered = 0;
+    Item item;
+    while (expected < STRESS_ITEMS)
+    {
+        if (!stressQueue.pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.check != ~item.seq)
+            torn++;
+        if (item.seq != expected)
+            misordered++;
+        expected = item.seq + 1;
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, misordered);
+    TEST_ASSERT_TRUE(stressQueue.isEmpty());
+    char message[64];
+    snprintf(message, sizeof(message), "%lu items, %lu pushes on a full queue", STRESS_ITEMS, rejected);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_queue);
+    RUN_TEST(test_keeps_one_slot_free);
+    RUN_TEST(test_fifo_order_across_wrap);
+    RUN_TEST(test_clear_drops_items);
+    RUN_TEST(test_threads_hand_over_every_item_in_order);
+    return UNITY_END();
+}
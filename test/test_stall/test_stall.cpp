@@ -0,0 +1,78 @@
+/**
+ * @file test_stall.cpp
+ * @brief Host test of the loop stall: the unchanged firmware runs the spool scenario of the simulator, including a
+ * broker outage, and no pass of loop() may wait longer than the bound.
+ */
+#include <unity.h>
+#include <sim.h>
+#include <sstream>
+
+void setup();
+
+namespace
+{
+    // the timeline of sim/scenarios/spool.txt without the display dumps
+    const char *SPOOL_SCENARIO =
+        "0       noise 0.5\n"
+        "3000    weight 1250\n"
+        "3500    tag 04a1b2c3\n"
+        "20000   weight 1248\n"
+        "30000   weight 1246\n"
+        "40000   offline\n"
+        "50000   weight 1243\n"
+        "55000   online\n"
+        "58000   untag\n"
+        "58000   weight 0\n";
+
+    const unsigned long RUN_MS = 60000;
+    const unsigned long ONLINE_MS = 55000;
+    // reading the tag is the longest pass, about 46 ms for its 4 authentications; a reconnect that blocks on the
+    // broker would take its whole timeout of a second
+    const uint32_t MAX_STALL_US = 60000;
+    const double MAX_MEAN_STALL_US = 50;
+
+    /**
+     * @brief Returns whether the firmware published a status after a virtual time.
+     */
+    bool publishedAfter(unsigned long ms)
+    {
+        for (const Sim::Broker::Message &message : Sim::Broker::published())
+        {
+            if (message.time > ms * 1000ULL && message.topic == "status/scale-01")
+                return true;
+        }
+        return false;
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_spool_scenario_stall_is_bounded()
+{
+    Sim::Scenario scenario;
+    std::istringstream input(SPOOL_SCENARIO);
+    TEST_ASSERT_TRUE(scenario.parse(input, "spool"));
+
+    setup();
+    Sim::Stall stall = Sim::runLoop(RUN_MS, 100, &scenario);
+    printf("loop stall: max %.3f ms at %.1f ms, mean %.3f ms, %lu passes\n", stall.max / 1000.0, stall.maxAt / 1000.0,
+           stall.mean() / 1000.0, stall.passes);
+
+    TEST_ASSERT_TRUE(stall.complete);
+    TEST_ASSERT_TRUE(publishedAfter(ONLINE_MS));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_STALL_US, (uint32_t)stall.max);
+    TEST_ASSERT_TRUE(stall.mean() <= MAX_MEAN_STALL_US);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_spool_scenario_stall_is_bounded);
+    return UNITY_END();
+}
@@ -0,0 +1,380 @@
+#!/usr/bin/env python3
+"""Generates src/glyphs.h, the glyph atlas of the weight readout.
+
+The glyphs are drawn below as ASCII art, '#' is a lit pixel. Each glyph is
+converted into the native SSD1306 page format: one byte per column and page
+of 8 pixel rows, the least significant bit is the top row. The pages of a
+glyph are stored one after another, so a page of a glyph is copied into the
+framebuffer as one run of bytes.
+
+Usage: python3 tools/glyphs.py > src/glyphs.h
+"""
+
+WIDTH = 12
+HEIGHT = 24
+SPACING = 2
+
+GLYPHS = {
+    '0': '''
+....####....
+..########..
+.##########.
+.###....###.
+###......###
+###......###
+###......###
+###......###
+###......###
+###......###
+###......###
+###......###
+###......###
+###......###
+###......###
+###......###
+.###....###.
+.##########.
+..########..
+....####....
+............
+............
+............
+............
+''',
+    '1': '''
+.....###....
+....####....
+...#####....
+..######....
+.#######....
+.###.###....
+.....###....
+.....###....
+.....###....
+.....###....
+.....###....
+.....###....
+.....###....
+.....###....
+.....###....
+.....###....
+.....###....
+.###########
+.###########
+.###########
+............
+............
+............
+............
+''',
+    '2': '''
+....####....
+..########..
+.##########.
+.###....###.
+###......###
+###......###
+###......###
+.........###
+........###.
+.......####.
+......####..
+.....####...
+.....###....
+....####....
+...####.....
+..####......
+.####.......
+############
+############
+############
+............
+............
+............
+............
+''',
+    '3': '''
+....####....
+..########..
+.##########.
+.###....####
+.##......###
+.........###
+.........###
+........####
+.....######.
+.....#####..
+.....######.
+........###.
+.........###
+.........###
+.##......###
+###......###
+.###....###.
+.##########.
+..########..
+....####....
+............
+............
+............
+............
+''',
+    '4': '''
+.......###..
+.......###..
+......####..
+......####..
+.....#####..
+....######..
+....######..
+...#######..
+...###.###..
+..###..###..
+.####..###..
+.###...###..
+############
+############
+.......###..
+.......###..
+.......###..
+.......###..
+.......###..
+.......###..
+............
+............
+............
+............
+''',
+    '5': '''
+############
+############
+############
+###.........
+###.........
+###.........
+###.........
+########....
+##########..
+###########.
+........###.
+.........###
+.........###
+.........###
+.........###
+.##......###
+.###....###.
+.##########.
+..########..
+....####....
+............
+............
+............
+............
+''',
+    '6': '''
+....####....
+..########..
+.##########.
+.###....###.
+###......##.
+###.........
+###.........
+###.........
+###.####....
+##########..
+###########.
+####....###.
+###......###
+###......###
+###......###
+###......###
+.###....###.
+.##########.
+..########..
+....####....
+............
+............
+............
+............
+''',
+    '7': '''
+############
+############
+############
+........###.
+........###.
+........###.
+.......###..
+.......###..
+......####..
+......###...
+......###...
+.....####...
+.....###....
+.....###....
+....###.....
+....###.....
+....###.....
+...###......
+...###......
+...###......
+............
+............
+............
+............
+''',
+    '8': '''
+....####....
+..########..
+.##########.
+.###....###.
+.###....###.
+.##......##.
+.###....###.
+.####..####.
+..########..
+..########..
+.##########.
+####....####
+###......###
+###......###
+###......###
+###......###
+.###....###.
+.##########.
+..########..
+....####....
+............
+............
+............
+............
+''',
+    '9': '''
+....####....
+..########..
+.##########.
+.###....###.
+###......###
+###......###
+###......###
+###......###
+.###....####
+.###########
+..##########
+....####.###
+.........###
+.........###
+.........###
+.##......###
+.###....###.
+.##########.
+..########..
+....####....
+............
+............
+............
+............
+''',
+    '-': '''
+............
+............
+............
+............
+............
+............
+............
+............
+............
+.##########.
+.##########.
+.##########.
+............
+............
+............
+............
+............
+............
+............
+............
+............
+............
+............
+............
+''',
+    'g': '''
+............
+............
+............
+............
+............
+....####.###
+..##########
+.###########
+.###....####
+###......###
+###......###
+###......###
+###......###
+.###....####
+.###########
+..##########
+....####.###
+.........###
+###......###
+###......###
+###......###
+.####..####.
+.##########.
+..########..
+''',
+}
+
+
+def pages(rows):
+    """Returns the glyph as page-major column bytes."""
+    data = []
+    for page in range(HEIGHT // 8):
+        for x in range(WIDTH):
+            byte = 0
+            for bit in range(8):
+                if rows[page * 8 + bit][x] == '#':
+                    byte |= 1 << bit
+            data.append(byte)
+    return data
+
+
+def main():
+    chars = ''.join(GLYPHS)
+    print('/**')
+    print(' * @file glyphs.h')
+    print(' * @brief Glyph atlas of the weight readout in SSD1306 page format, generated by tools/glyphs.py, do not edit.')
+    print(' */')
+    print('#ifndef GLYPHS_H')
+    print('#define GLYPHS_H')
+    print()
+    print('#include <Arduino.h>')
+    print()
+    print('#define GLYPH_WIDTH %d // Columns of a glyph.' % WIDTH)
+    print('#define GLYPH_PAGES %d // Pages (8 pixel rows) of a glyph.' % (HEIGHT // 8))
+    print('#define GLYPH_SPACING %d // Blank columns between two glyphs.' % SPACING)
+    print()
+    print('static const char GLYPH_CHARS[] = "%s"; // Characters in the atlas, in atlas order.' % chars)
+    print()
+    print('static const uint8_t GLYPH_ATLAS[%d][GLYPH_PAGES * GLYPH_WIDTH] = {' % len(GLYPHS))
+    for char, art in GLYPHS.items():
+        rows = art.strip().split('\n')
+        assert len(rows) == HEIGHT and all(len(row) == WIDTH for row in rows), char
+        data = pages(rows)
+        print('    // %s' % char)
+        print('    {')
+        for page in range(HEIGHT // 8):
+            line = data[page * WIDTH:(page + 1) * WIDTH]
+            print('        ' + ', '.join('0x%02x' % b for b in line) + ',')
+        print('    },')
+    print('};')
+    print()
+    print('#endif')
+
+
+if __name__ == '__main__':
+    main()